@@ -0,0 +1,240 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Microbenchmark of the interpreter, instruction by instruction. Every
+// documented opcode (each operation and addressing mode combination) is timed
+// on its own, by running a block of copies of it over and over on a flat 64KiB
+// memory; control transfers, which cannot be laid out in a straight block,
+// are run one at a time from the same place instead. Each opcode is sampled a
+// number of times, and the time per instruction is reported with its mean,
+// standard deviation and minimum, as JSON:
+//
+//     bench [-s SAMPLES] [-o OUTPUT] [-b BASELINE] [-t TOLERANCE]
+//
+// When given the JSON output of a previous run as a baseline, the minimum
+// times are compared and the program fails if any opcode got slower by more
+// than the tolerance (a percentage, 10 by default), so that it can gate
+// upgrades of the library.
+
+#include <math.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "debug.h"
+#include "decoder.h"
+#include "processor.h"
+#include "addressing.h"
+#include "definitions.h"
+
+#define CODE_START     0x1000
+#define BLOCK          256     // copies of an instruction in a block
+#define ROUNDS         256     // blocks run per sample
+#define SAMPLES        15      // default number of samples per opcode
+#define MIN_REGRESSION 0.25    // ns; smaller differences are just noise
+
+// Operands used by the copies of an instruction. The zero page is filled with
+// the high byte of the absolute operand, so that every pointer in it points
+// near it as well, out of the way of the code and the stack
+#define OPERAND_ZEROPAGE 0x80
+#define OPERAND_ABSOLUTE 0x4040
+
+static uint8_t memory[0x10000];
+
+static uint8_t bench_read(void *userdata, uint16_t addr) {
+    (void) userdata;
+    return memory[addr];
+}
+
+static void bench_write(void *userdata, uint16_t addr, uint8_t data) {
+    (void) userdata;
+    memory[addr] = data;
+}
+
+// Timing of an opcode, in nanoseconds per instruction
+typedef struct {
+    double sum, squares; // of the samples, to get the mean and deviation
+    double min;
+    bool single;         // run one at a time, rather than in blocks
+} Timing;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Whether an operation transfers control, and so must be run one at a time
+static bool transfers_control(Operation op) {
+    return op == JMP || op == JSR || op == RTS || op == RTI || op == BRK;
+}
+
+// Lay out a block of copies of an instruction, returning its size in bytes
+static size_t lay_out(uint8_t opcode, Instruction inst, size_t copies) {
+    size_t at = CODE_START;
+    for(size_t i = 0; i < copies; ++i) {
+        memory[at++] = opcode;
+        switch(get_inc(inst.mode)) {
+            case 1:
+                // Branches just go on to the next copy either way
+                memory[at++] = inst.mode == MODE_RELATIVE ? 0x00
+                    : inst.mode == MODE_IMMEDIATE ? 0x01 : OPERAND_ZEROPAGE;
+                break;
+            case 2:
+                memory[at++] = OPERAND_ABSOLUTE & 0xFF;
+                memory[at++] = OPERAND_ABSOLUTE >> 8;
+                break;
+        }
+    }
+    return at - CODE_START;
+}
+
+// Put the processor back at the start of the code, with a sane state
+static void rewind_processor(Processor *proc) {
+    proc->pc = CODE_START;
+    proc->sp = 0xFD;
+    proc->status = 0x20; // decimal mode and interrupt disable are clear
+}
+
+// Take a sample of the time taken by an opcode
+static void sample(Processor *proc, uint8_t opcode, Timing *t) {
+    Instruction inst = decode(opcode);
+    t->single = transfers_control(inst.op);
+    memset(memory, OPERAND_ABSOLUTE >> 8, 0x100);
+    lay_out(opcode, inst, t->single ? 1 : BLOCK);
+
+    double start = now();
+    if(t->single) {
+        for(uint32_t i = 0; i < ROUNDS * BLOCK; ++i) {
+            rewind_processor(proc);
+            processor_run(proc, 1);
+        }
+    } else {
+        for(uint32_t i = 0; i < ROUNDS; ++i) {
+            rewind_processor(proc);
+            processor_run(proc, BLOCK);
+        }
+    }
+    double ns = (now() - start) / (ROUNDS * BLOCK);
+    t->sum += ns;
+    t->squares += ns * ns;
+    if(ns < t->min) t->min = ns;
+}
+
+// Minimum time of each opcode in a baseline file, negative if absent. The
+// file is expected to be the output of this program, one opcode per line
+static bool load_baseline(const char *path, double baseline[256]) {
+    FILE *in = fopen(path, "r");
+    if(in == NULL) return false;
+    for(int i = 0; i < 256; ++i) baseline[i] = -1;
+    char line[512];
+    while(fgets(line, sizeof(line), in) != NULL) {
+        const char *opcode = strstr(line, "\"opcode\":");
+        const char *min = strstr(line, "\"min\":");
+        if(opcode == NULL || min == NULL) continue;
+        unsigned long op = strtoul(opcode + 9, NULL, 0);
+        if(op < 256) baseline[op] = strtod(min + 6, NULL);
+    }
+    fclose(in);
+    return true;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-s SAMPLES] [-o OUTPUT] [-b BASELINE]"
+            " [-t TOLERANCE]\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    unsigned samples = SAMPLES;
+    const char *output = NULL, *baseline_path = NULL;
+    double tolerance = 10;
+    for(int i = 1; i < argc; ++i) {
+        if(i + 1 >= argc) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        if(strcmp(argv[i], "-s") == 0) samples = strtoul(argv[++i], NULL, 0);
+        else if(strcmp(argv[i], "-o") == 0) output = argv[++i];
+        else if(strcmp(argv[i], "-b") == 0) baseline_path = argv[++i];
+        else if(strcmp(argv[i], "-t") == 0) tolerance = strtod(argv[++i], NULL);
+        else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if(samples == 0) samples = 1;
+
+    double baseline[256];
+    if(baseline_path != NULL && !load_baseline(baseline_path, baseline)) {
+        fprintf(stderr, "could not read baseline %s\n", baseline_path);
+        return EXIT_FAILURE;
+    }
+    FILE *out = output != NULL ? fopen(output, "w") : stdout;
+    if(out == NULL) {
+        fprintf(stderr, "could not write to %s\n", output);
+        return EXIT_FAILURE;
+    }
+
+    // Samples of all opcodes are interleaved, so that the host slowing down
+    // for a while does not skew the results of only some of them
+    Processor proc;
+    processor_init(&proc, bench_read, bench_write, NULL);
+    static Timing timing[256];
+    for(int opcode = 0; opcode < 256; ++opcode) timing[opcode].min = INFINITY;
+    for(unsigned s = 0; s < samples; ++s)
+        for(int opcode = 0; opcode < 256; ++opcode)
+            if(decode(opcode).op != ERR) sample(&proc, opcode, &timing[opcode]);
+
+    fprintf(out, "{\n  \"unit\": \"ns/instruction\",\n  \"samples\": %u,\n"
+            "  \"results\": [\n", samples);
+    bool first = true;
+    int regressions = 0;
+    for(int opcode = 0; opcode < 256; ++opcode) {
+        Instruction inst = decode(opcode);
+        if(inst.op == ERR) continue;
+        const Timing *t = &timing[opcode];
+        double mean = t->sum / samples;
+        double variance = t->squares / samples - mean * mean;
+        double stddev = variance > 0 ? sqrt(variance) : 0;
+        fprintf(out, "%s    {\"opcode\": %d, \"operation\": \"%s\", \"mode\":"
+                " \"%s\", \"method\": \"%s\", \"mean\": %.3f, \"stddev\":"
+                " %.3f, \"min\": %.3f}", first ? "" : ",\n", opcode,
+                operation_name(inst.op), mode_name(inst.mode),
+                t->single ? "single" : "block", mean, stddev, t->min);
+        first = false;
+        if(baseline_path == NULL || baseline[opcode] < 0) continue;
+        double limit = baseline[opcode] * (1 + tolerance / 100);
+        if(t->min > limit && t->min - baseline[opcode] > MIN_REGRESSION) {
+            fprintf(stderr, "regression: %s %s (%02X) takes %.3f ns, up from"
+                    " %.3f ns\n", operation_name(inst.op),
+                    mode_name(inst.mode), opcode, t->min, baseline[opcode]);
+            ++regressions;
+        }
+    }
+    fprintf(out, "\n  ]\n}\n");
+    if(out != stdout) fclose(out);
+    if(regressions > 0) {
+        fprintf(stderr, "%d regressions over %.1f%%\n", regressions,
+                tolerance);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
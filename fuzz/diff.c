@@ -0,0 +1,375 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Differential fuzzing harness. Every input is turned into an initial machine
+// state (registers plus a full 64KiB memory image with a program in it), which
+// is then run on the reference interpreter, processor_step, and on each of the
+// alternative execution paths listed below, side by side. After every single
+// instruction the registers and the memory writes of each path must match the
+// reference exactly. When they do not, the input is minimized and written to
+// a file that reproduces the divergence when passed back to this program.
+//
+// It can be built for libFuzzer (define LIBRE_6502_LIBFUZZER and link with
+// -fsanitize=fuzzer), or as a standalone driver which reads inputs from files
+// or stdin (AFL compatible) and can also generate random inputs by itself.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "space.h"
+#include "fusion.h"
+#include "coverage.h"
+#include "heatmap.h"
+#include "recorder.h"
+#include "processor.h"
+
+// Layout of an input: the header holds the initial registers and a seed for
+// the pseudo-random bytes that fill the memory image, and the rest is the
+// program, loaded at PROGRAM_START. Keeping the seed apart from the program
+// lets the minimizer shrink the program without reshuffling the memory
+#define HEADER_SIZE    8
+#define PROGRAM_START  0x0200
+#define PROGRAM_MAX    0x0800
+#define MAX_STEPS      1024
+#define MAX_WRITES     16
+
+// Memory of a machine under test, with a log of the writes done by the last
+// instruction, which is what gets compared between paths
+typedef struct {
+    uint8_t mem[0x10000];
+    uint16_t addr[MAX_WRITES];
+    uint8_t data[MAX_WRITES];
+    size_t writes;
+} Bus;
+
+static uint8_t bus_read(void *userdata, uint16_t addr) {
+    Bus *bus = userdata;
+    return bus->mem[addr];
+}
+
+static void bus_write(void *userdata, uint16_t addr, uint8_t data) {
+    Bus *bus = userdata;
+    if(bus->writes < MAX_WRITES) {
+        bus->addr[bus->writes] = addr;
+        bus->data[bus->writes] = data;
+    }
+    ++bus->writes;
+    bus->mem[addr] = data;
+}
+
+// An alternative way of executing code, which must behave exactly like the
+// reference interpreter. The setup function is optional; it is run after the
+// processor has been initialized and its registers set from the input. Paths
+// that can only be observed between batches of instructions run stride of them
+// on each step, and are compared against as many steps of the reference
+typedef struct {
+    const char *name;
+    void (*setup)(Processor *proc);
+    void (*step)(Processor *proc);
+    size_t stride;
+} Path;
+
+// Trace hook that does nothing, just to go through the instrumented core
+static void trace_nothing(void *userdata, const Processor *proc) {
+    (void) userdata;
+    (void) proc;
+}
+
+static void setup_trace(Processor *proc) {
+    processor_set_features(proc, proc->features | FEATURE_TRACE);
+    proc->trace = trace_nothing;
+}
+
+static void setup_no_cycles(Processor *proc) {
+    processor_set_features(proc, proc->features & ~FEATURE_CYCLES);
+}
+
+static void run_one(Processor *proc) {
+    processor_run(proc, 1);
+}
+
+#define FUSED_STRIDE 16
+
+static void setup_fused(Processor *proc) {
+    processor_set_fusion(proc, FUSION_ALL);
+}
+
+static void run_fused(Processor *proc) {
+    processor_run(proc, FUSED_STRIDE);
+}
+
+#define RESIDENT_STRIDE 16
+
+// The resident run loop only runs on address spaces. This one reads straight
+// from the memory of the bus, but leaves its pages unmapped for writing, so
+// that writes still go through the bus and get logged
+static AddressSpace resident_space;
+
+static void setup_resident(Processor *proc) {
+    Bus *bus = proc->u;
+    space_init(&resident_space, bus_read, bus_write, bus);
+    for(int i = 0; i < SPACE_PAGES; ++i)
+        resident_space.rmap[i] = bus->mem + i * SPACE_PAGE_SIZE;
+    proc->read = space_read;
+    proc->write = space_write;
+    proc->u = &resident_space;
+    processor_set_features(proc, proc->features);
+}
+
+static void run_resident(Processor *proc) {
+    processor_run(proc, RESIDENT_STRIDE);
+}
+
+// Recording the last instructions must not change what they do
+static Recorder recorder;
+
+static void setup_recorded(Processor *proc) {
+    if(recorder.ring == NULL && !recorder_init(&recorder, 64)) abort();
+    recorder_attach(&recorder, proc);
+}
+
+// Neither must counting the edges taken
+static Coverage coverage;
+
+static void setup_covered(Processor *proc) {
+    if(coverage.map == NULL && !coverage_init(&coverage, NULL, COVERAGE_SIZE))
+        abort();
+    coverage_attach(&coverage, proc);
+}
+
+// Nor counting the accesses to memory, which sits between the core and the bus
+static Heatmap heatmap;
+
+static void setup_heatmap(Processor *proc) {
+    if(heatmap.counts == NULL && !heatmap_init(&heatmap, 0)) abort();
+    heatmap_attach(&heatmap, proc);
+}
+
+// Execution paths under test. New ones (specialized cores, caches, batch run
+// loops and so on) should be added here as they are introduced
+static const Path paths[] = {
+    { "step",      NULL,            processor_step, 1 },
+    { "run",       NULL,            run_one,        1 },
+    { "trace",     setup_trace,     processor_step, 1 },
+    { "no-cycles", setup_no_cycles, processor_step, 1 },
+    { "fused",     setup_fused,     run_fused,      FUSED_STRIDE },
+    { "resident",  setup_resident,  run_resident,   RESIDENT_STRIDE },
+    { "recorded",  setup_recorded,  run_resident,   RESIDENT_STRIDE },
+    { "covered",   setup_covered,   run_resident,   RESIDENT_STRIDE },
+    { "heatmap",   setup_heatmap,   run_resident,   RESIDENT_STRIDE },
+};
+
+#define PATH_COUNT (sizeof(paths) / sizeof(paths[0]))
+
+// Small, fast and deterministic PRNG (xorshift64*)
+static uint64_t next_random(uint64_t *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+// Build the initial memory image for an input
+static void build_image(Bus *bus, const uint8_t *data, size_t size) {
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    for(size_t i = 5; i < HEADER_SIZE && i < size; ++i)
+        seed = (seed ^ data[i]) * 0x100000001B3ULL;
+    for(size_t i = 0; i < sizeof(bus->mem); i += 8) {
+        uint64_t r = next_random(&seed);
+        memcpy(&bus->mem[i], &r, 8);
+    }
+    size_t length = size > HEADER_SIZE ? size - HEADER_SIZE : 0;
+    if(length > PROGRAM_MAX) length = PROGRAM_MAX;
+    if(length > 0) memcpy(&bus->mem[PROGRAM_START], data + HEADER_SIZE, length);
+    // All vectors point into the program, so that a BRK runs more of it
+    uint16_t vectors[] = { NMI_VECTOR, RESET_VECTOR, IRQ_VECTOR };
+    for(size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); ++i) {
+        bus->mem[vectors[i]] = PROGRAM_START & 0xFF;
+        bus->mem[vectors[i] + 1] = PROGRAM_START >> 8;
+    }
+    bus->writes = 0;
+}
+
+// Initialize a processor for an input, after its memory has been built
+static void start(Processor *proc, Bus *bus, const uint8_t *data,
+        size_t size, const Path *path) {
+    processor_init(proc, bus_read, bus_write, bus);
+    uint8_t header[HEADER_SIZE] = {0};
+    memcpy(header, data, size < HEADER_SIZE ? size : HEADER_SIZE);
+    proc->acc = header[0];
+    proc->x = header[1];
+    proc->y = header[2];
+    proc->sp = header[3];
+    proc->status = header[4];
+    if(path != NULL && path->setup != NULL) path->setup(proc);
+}
+
+// Compare the state of a path against the reference after an instruction,
+// printing what is different. Returns true when they match
+static bool same(const Processor *ref, const Bus *ref_bus,
+        const Processor *proc, const Bus *bus, bool verbose) {
+    bool ok = ref->pc == proc->pc && ref->acc == proc->acc
+        && ref->x == proc->x && ref->y == proc->y && ref->sp == proc->sp
+        && ref->status == proc->status && ref_bus->writes == bus->writes;
+    if(ref->features & proc->features & FEATURE_CYCLES)
+        ok = ok && ref->cycles == proc->cycles;
+    size_t logged = bus->writes < MAX_WRITES ? bus->writes : MAX_WRITES;
+    for(size_t i = 0; ok && i < logged; ++i)
+        ok = ref_bus->addr[i] == bus->addr[i] && ref_bus->data[i] == bus->data[i];
+    if(ok || !verbose) return ok;
+    fprintf(stderr, "  reference: pc=%04X a=%02X x=%02X y=%02X sp=%02X p=%02X"
+            " cycles=%llu writes=%zu\n", ref->pc, ref->acc, ref->x, ref->y,
+            ref->sp, ref->status, (unsigned long long) ref->cycles,
+            ref_bus->writes);
+    fprintf(stderr, "  path:      pc=%04X a=%02X x=%02X y=%02X sp=%02X p=%02X"
+            " cycles=%llu writes=%zu\n", proc->pc, proc->acc, proc->x, proc->y,
+            proc->sp, proc->status, (unsigned long long) proc->cycles,
+            bus->writes);
+    return false;
+}
+
+// Machines used to run an input; they are large, so they are kept around
+static Bus ref_bus, path_bus;
+
+// Run an input on a single path alongside the reference. Returns the number
+// of the instruction at which they diverge, or 0 if they never do
+static size_t run_path(const Path *path, const uint8_t *data, size_t size,
+        bool verbose) {
+    Processor ref, proc;
+    build_image(&ref_bus, data, size);
+    memcpy(&path_bus, &ref_bus, sizeof(Bus));
+    start(&ref, &ref_bus, data, size, NULL);
+    start(&proc, &path_bus, data, size, path);
+    for(size_t i = path->stride; i <= MAX_STEPS; i += path->stride) {
+        ref_bus.writes = path_bus.writes = 0;
+        uint16_t pc = ref.pc;
+        for(size_t j = 0; j < path->stride; ++j) processor_step(&ref);
+        path->step(&proc);
+        if(!same(&ref, &ref_bus, &proc, &path_bus, verbose)) {
+            if(verbose) fprintf(stderr, "  path '%s' diverged at instruction"
+                    " %zu (pc=%04X, opcode=%02X)\n", path->name, i, pc,
+                    ref_bus.mem[pc]);
+            return i;
+        }
+    }
+    if(memcmp(ref_bus.mem, path_bus.mem, sizeof(ref_bus.mem)) != 0) {
+        if(verbose) fprintf(stderr, "  path '%s' has different memory at the"
+                " end\n", path->name);
+        return MAX_STEPS + 1;
+    }
+    return 0;
+}
+
+// Shrink a diverging input: drop trailing bytes and zero out every byte that
+// is not needed to reproduce the divergence. Returns the new size
+static size_t minimize(const Path *path, uint8_t *data, size_t size) {
+    while(size > HEADER_SIZE && run_path(path, data, size - 1, false)) --size;
+    for(size_t i = 0; i < size; ++i) {
+        uint8_t byte = data[i];
+        if(byte == 0) continue;
+        data[i] = 0;
+        if(!run_path(path, data, size, false)) data[i] = byte;
+    }
+    return size;
+}
+
+// Minimize a diverging input and save it to the current directory
+static void save_divergence(const Path *path, const uint8_t *data,
+        size_t size) {
+    uint8_t *copy = malloc(size);
+    if(copy == NULL) return;
+    memcpy(copy, data, size);
+    size = minimize(path, copy, size);
+    uint32_t hash = 2166136261u;
+    for(size_t i = 0; i < size; ++i) hash = (hash ^ copy[i]) * 16777619u;
+    char name[64];
+    snprintf(name, sizeof(name), "divergence-%s-%08X.bin", path->name, hash);
+    FILE *out = fopen(name, "wb");
+    if(out != NULL) {
+        fwrite(copy, 1, size, out);
+        fclose(out);
+        fprintf(stderr, "  minimized input (%zu bytes) written to %s\n",
+                size, name);
+    }
+    free(copy);
+}
+
+// Run an input on every path. Returns true if all of them agree
+static bool check(const uint8_t *data, size_t size) {
+    bool ok = true;
+    for(size_t p = 0; p < PATH_COUNT; ++p) {
+        if(run_path(&paths[p], data, size, false) == 0) continue;
+        fprintf(stderr, "divergence on path '%s'\n", paths[p].name);
+        run_path(&paths[p], data, size, true);
+        save_divergence(&paths[p], data, size);
+        ok = false;
+    }
+    return ok;
+}
+
+#ifdef LIBRE_6502_LIBFUZZER
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    if(!check(data, size)) abort();
+    return 0;
+}
+
+#else
+
+// Run the input contained in a file (or stdin, given a NULL path)
+static bool check_file(const char *name) {
+    static uint8_t data[HEADER_SIZE + PROGRAM_MAX];
+    FILE *in = name != NULL ? fopen(name, "rb") : stdin;
+    if(in == NULL) {
+        perror(name);
+        return false;
+    }
+    size_t size = fread(data, 1, sizeof(data), in);
+    if(in != stdin) fclose(in);
+    return check(data, size);
+}
+
+// Run a number of randomly generated inputs
+static bool check_random(unsigned long count, uint64_t seed) {
+    static uint8_t data[HEADER_SIZE + 256];
+    if(seed == 0) seed = 1;
+    for(unsigned long n = 0; n < count; ++n) {
+        for(size_t i = 0; i < sizeof(data); ++i)
+            data[i] = next_random(&seed) >> 56;
+        if(!check(data, sizeof(data))) return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    if(argc >= 2 && strcmp(argv[1], "-r") == 0) {
+        // fuzz_diff -r COUNT [SEED]
+        unsigned long count = argc >= 3 ? strtoul(argv[2], NULL, 0) : 1000;
+        uint64_t seed = argc >= 4 ? strtoull(argv[3], NULL, 0) : 1;
+        return check_random(count, seed) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    bool ok = argc >= 2 || check_file(NULL);
+    for(int i = 1; i < argc; ++i) ok = check_file(argv[i]) && ok;
+    if(!ok) abort(); // make the failure visible to AFL
+    return EXIT_SUCCESS;
+}
+
+#endif // LIBRE_6502_LIBFUZZER
@@ -0,0 +1,59 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRE_6502_ARENA_H
+#define LIBRE_6502_ARENA_H
+
+// Arena allocator for running very large numbers of processors. Each instance
+// gets a processor and a block of RAM, laid out next to each other in cache
+// line aligned slots. Slots are packed into large, page aligned slabs, so that
+// the host allocator is called a handful of times no matter how many instances
+// there are, and so that the instances are spread over as few memory pages
+// (and TLB entries) as possible. Everything is created and destroyed in bulk.
+
+#include <stddef.h>
+#include <stdint.h>
+#include "processor.h"
+
+// Size of a cache line; slots are aligned to this
+#define ARENA_ALIGN 64
+
+// Opaque arena structure
+typedef struct Arena Arena;
+
+// Create an arena with the given number of instances, each of them with the
+// given amount of RAM (which is zeroed). Returns NULL on allocation failure
+Arena *arena_create(size_t count, size_t ram_size);
+
+// Destroy an arena, freeing all of its instances at once
+void arena_destroy(Arena *arena);
+
+// Get the number of instances in an arena
+size_t arena_count(const Arena *arena);
+
+// Get the processor of an instance
+Processor *arena_processor(const Arena *arena, size_t index);
+
+// Get the RAM of an instance
+uint8_t *arena_memory(const Arena *arena, size_t index);
+
+// Initialize the processors of all instances, connecting them to the given
+// address space functions. The userdata of each processor is its own RAM
+void arena_init(Arena *arena, AddrReader read, AddrWriter write);
+
+#endif // LIBRE_6502_ARENA_H
@@ -0,0 +1,81 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRE_6502_COVERAGE_H
+#define LIBRE_6502_COVERAGE_H
+
+// Edge coverage, for coverage-guided fuzzing of guest code. Whenever the flow
+// of control moves (branches, taken or not, jumps, subroutine calls and
+// returns, interrupts and returns from them), the edge from the previous
+// location to the new one is counted in a bitmap of 8-bit hit counters, laid
+// out as AFL does it: locations are hashes of the PC, and an edge is counted
+// at (location ^ previous) & mask, the previous location being shifted right
+// by one so that the direction of edges matters. The bitmap can thus be the
+// very one the fuzzer reads, such as the shared memory of AFL or the extra
+// counters of libFuzzer. Other instructions do not look at it at all; when
+// no coverage is attached, the cost is a test per change of flow.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "processor.h"
+
+#define COVERAGE_SIZE 65536 // size of the bitmap of AFL, by default
+
+// Location of a PC: a Fibonacci hash, so that nearby PCs land far apart
+#define COVERAGE_LOCATION(pc) ((uint32_t) ((uint16_t) (pc) * 2654435761u) >> 16)
+
+struct Coverage {
+    uint8_t *map;   // hit counters, one per edge (hash)
+    uint32_t mask;  // size of the bitmap minus one
+    uint32_t prev;  // previous location, shifted right by one
+    bool owned;     // the bitmap was allocated by coverage_init
+    bool shared;    // the bitmap is the shared memory of AFL
+};
+
+// Initialize edge coverage over a bitmap of the given size, which must be a
+// power of two. Given a NULL bitmap, one is allocated. Returns false if the
+// size is not a power of two, or on allocation failure
+bool coverage_init(Coverage *cov, uint8_t *map, size_t size);
+
+// Initialize edge coverage over the shared memory of AFL, when running under
+// it (as told by the __AFL_SHM_ID variable). Returns false otherwise
+bool coverage_init_afl(Coverage *cov);
+
+// Release the bitmap, if it was allocated by coverage_init (or detach from
+// the shared memory of AFL)
+void coverage_free(Coverage *cov);
+
+// Attach coverage to a processor, which counts the edges it takes from then
+// on, or detach it with a NULL coverage
+void coverage_attach(Coverage *cov, Processor *proc);
+
+// Clear the bitmap and forget the previous location, between runs
+void coverage_reset(Coverage *cov);
+
+// Get the number of edges that were hit (counters that are not zero)
+size_t coverage_count(const Coverage *cov);
+
+// Count the edge to the given PC, from the previous location
+static inline void coverage_edge(Coverage *cov, uint16_t pc) {
+    uint32_t location = COVERAGE_LOCATION(pc);
+    ++cov->map[(location ^ cov->prev) & cov->mask];
+    cov->prev = location >> 1;
+}
+
+#endif // LIBRE_6502_COVERAGE_H
@@ -0,0 +1,36 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRE_6502_CYCLES_H
+#define LIBRE_6502_CYCLES_H
+
+// Timing of the instructions of the 6502
+
+#include <stdint.h>
+
+// Base number of cycles taken by each instruction, indexed by opcode. Extra
+// cycles due to page crossing and taken branches are added separately.
+// Invalid opcodes are treated as if they were 2 cycle NOPs
+extern const uint8_t cycle_table[256];
+
+// Most cycles taken by a single instruction, extra cycles included, so that
+// running (time left) / CYCLES_MAX instructions never goes past a time by
+// more than one of them
+#define CYCLES_MAX 7
+
+#endif // LIBRE_6502_CYCLES_H
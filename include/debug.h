@@ -24,6 +24,13 @@
 #include <stdio.h>
 #include <stdint.h>
 #include "processor.h"
+#include "definitions.h"
+
+// Get the mnemonic of an operation, in lowercase
+const char *operation_name(Operation op);
+
+// Get the name of an addressing mode, such as "zeropage,x"
+const char *mode_name(Mode mode);
 
 // Read code from the given addressing space (provided via the userdata and
 // read parameters) at the given address and with the given length,
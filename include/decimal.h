@@ -0,0 +1,48 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRE_6502_DECIMAL_H
+#define LIBRE_6502_DECIMAL_H
+
+// Lookup tables for decimal mode (BCD) arithmetic. They are generated at build
+// time by tools/gen_decimal.c and hold the outcome of ADC and SBC for every
+// possible combination of accumulator, operand and carry, including operands
+// that are not valid BCD. The result, carry and overflow are those of the
+// NMOS 6502; zero and negative are taken from the decimal result instead of
+// the intermediate values the NMOS 6502 takes them from.
+
+#include <stdint.h>
+
+// Number of entries in each table: carry (1 bit), accumulator (8 bits) and
+// operand (8 bits)
+#define DECIMAL_TABLE_SIZE 0x20000
+
+// Compute the index of an entry in a decimal table
+#define DECIMAL_INDEX(acc, data, carry) \
+    ((uint32_t) (carry) << 16 | (uint32_t) (acc) << 8 | (data))
+
+// Status register bits that are determined by a table entry; these are
+// carry, zero, overflow and negative
+#define DECIMAL_FLAGS 0xC3
+
+// Each entry holds the result in its low byte and the status register bits
+// (within DECIMAL_FLAGS) in its high byte
+extern const uint16_t decimal_add_table[DECIMAL_TABLE_SIZE];
+extern const uint16_t decimal_sub_table[DECIMAL_TABLE_SIZE];
+
+#endif // LIBRE_6502_DECIMAL_H
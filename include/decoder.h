@@ -21,6 +21,7 @@
 
 // Decoding logic for the 6502 processor
 
+#include <stddef.h>
 #include <stdint.h>
 #include "definitions.h"
 
@@ -28,4 +29,27 @@
 // pair that can be more easily processed by the CPU
 Instruction decode(uint8_t opcode);
 
+// Decoded form of every opcode, and the length of the instruction it starts,
+// operand included. These are the tables used by the core and the bulk
+// decoders alike; they are only valid once decode_tables_init was called
+extern Instruction decode_table[256];
+extern uint8_t decode_length[256];
+
+// Fill the tables of decoded opcodes. Only the first call does anything, and
+// calls can be made from any thread
+void decode_tables_init(void);
+
+// Decode every byte of a buffer of machine code as an opcode, in bulk, which
+// is much faster than calling decode on each of them. The decoded form of
+// code[i] is written to out[i] and the length of the instruction it starts,
+// operand included, to lengths[i]; either may be NULL if not needed
+void decode_buffer(const uint8_t *code, size_t n, Instruction *out,
+        uint8_t *lengths);
+
+// Find where the instructions of a buffer of machine code start, decoding it
+// as a linear sweep from its first byte. starts[i] is set to 1 if one starts
+// at code[i] and to 0 otherwise (the last one may run past the end). Returns
+// the number of instructions found
+size_t decode_sweep(const uint8_t *code, size_t n, uint8_t *starts);
+
 #endif // LIBRE_6502_DECODER_H
@@ -0,0 +1,101 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRE_6502_FUSION_H
+#define LIBRE_6502_FUSION_H
+
+// Superinstruction fusion. Some pairs of instructions show up next to each
+// other all the time in 6502 code: compare and branch, decrement and branch,
+// load and store, and so on. After the run loop of a processor executes the
+// first instruction of an enabled pair, it goes straight into a handler that
+// is specialized for the second one, skipping the per-instruction overhead of
+// the loop and the generic decoding and addressing logic. Chains of enabled
+// pairs are followed, so that e.g. LDA abs,X; STA abs,X; INX; BNE runs in a
+// single go. Fusion never changes the results: registers, flags, bus accesses
+// and cycle counts are exactly the same as those of unfused execution.
+//
+// Which pairs are worth fusing depends on the program, so they are picked
+// from a profile of the instruction pairs that it actually runs.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "processor.h"
+
+// Instruction pairs supported by fusion
+typedef enum {
+    FUSE_CMP_IMM_BNE, // cmp #imm; bne
+    FUSE_CMP_IMM_BEQ, // cmp #imm; beq
+    FUSE_CMP_ZPG_BNE, // cmp zpg; bne
+    FUSE_CPX_IMM_BNE, // cpx #imm; bne
+    FUSE_CPY_IMM_BNE, // cpy #imm; bne
+    FUSE_DEX_BNE,     // dex; bne
+    FUSE_DEY_BNE,     // dey; bne
+    FUSE_INX_BNE,     // inx; bne
+    FUSE_INY_BNE,     // iny; bne
+    FUSE_DEX_BPL,     // dex; bpl
+    FUSE_DEY_BPL,     // dey; bpl
+    FUSE_CLC_ADC,     // clc; adc #imm
+    FUSE_SEC_SBC,     // sec; sbc #imm
+    FUSE_LDA_STA_ZPG, // lda zpg; sta zpg
+    FUSE_LDA_STA_ABS, // lda abs; sta abs
+    FUSE_LDA_STA_ABX, // lda abs,x; sta abs,x
+    FUSE_LDA_STA_IDY, // lda (zpg),y; sta (zpg),y
+    FUSE_STA_ABX_INX, // sta abs,x; inx
+    FUSE_STA_IDY_INY, // sta (zpg),y; iny
+    FUSE_LDA_IMM_ZPG, // lda #imm; sta zpg
+    FUSE_LDA_IMM_ABS, // lda #imm; sta abs
+    FUSION_PAIRS,     // number of supported pairs
+} Fusion_pair;
+
+// Bit of a pair in a set of pairs, as taken by processor_set_fusion
+#define FUSION_BIT(pair) (UINT32_C(1) << (pair))
+
+// Set of all supported pairs
+#define FUSION_ALL (FUSION_BIT(FUSION_PAIRS) - 1)
+
+// Opcodes making up each supported pair
+extern const struct FusionOpcodes {
+    uint8_t first, second;
+} fusion_opcodes[FUSION_PAIRS];
+
+// Sets of pairs that start with and that end in each opcode. A pair of
+// opcodes is supported if it is in the intersection of the two sets
+extern const uint32_t fusion_first[256];
+extern const uint32_t fusion_second[256];
+
+// Number of times each pair of opcodes ran one after the other
+typedef struct {
+    uint32_t count[256][256]; // indexed by first and then second opcode
+    uint64_t total;           // total number of pairs seen
+    bool started;             // whether the previous opcode is known
+    uint8_t last;             // previous opcode
+} FusionProfile;
+
+// Initialize (or clear) a profile
+void fusion_profile_init(FusionProfile *profile);
+
+// Run the given number of instructions, one step at a time, recording the
+// pairs of opcodes that got executed. Returns how many were run
+uint32_t fusion_profile(FusionProfile *profile, Processor *proc,
+        uint32_t count);
+
+// Pick the supported pairs that make up at least the given share (between 0
+// and 1) of all the pairs in a profile
+uint32_t fusion_select(const FusionProfile *profile, double share);
+
+#endif // LIBRE_6502_FUSION_H
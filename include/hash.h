@@ -0,0 +1,46 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRE_6502_HASH_H
+#define LIBRE_6502_HASH_H
+
+// Incremental hashing of the whole state of a machine (registers, cycle count
+// and memory) into a 64-bit digest, to cheaply check that two runs are still
+// in lockstep. Each page of memory is hashed on its own, and the page hashes
+// are combined in a way that allows replacing any one of them; on each query,
+// only the pages that were dirtied since the previous one are hashed again.
+
+#include <stdint.h>
+#include "space.h"
+#include "processor.h"
+
+// Running hash of a machine. There should be a single one per address space,
+// because it takes over the dirty bitmap of the space
+typedef struct {
+    uint64_t page[SPACE_PAGES]; // hash of each page, as of the last query
+    uint64_t memory;            // combination of all page hashes
+} StateHash;
+
+// Initialize a running hash. The first query will hash every page
+void state_hash_init(StateHash *hash, AddressSpace *space);
+
+// Get the digest of the current state of a machine, rehashing dirty pages
+uint64_t state_hash(StateHash *hash, AddressSpace *space,
+        const Processor *proc);
+
+#endif // LIBRE_6502_HASH_H
@@ -0,0 +1,116 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRE_6502_HEATMAP_H
+#define LIBRE_6502_HEATMAP_H
+
+// Memory access heatmaps: how many times each address (or each block of
+// addresses, down to whole pages) is fetched from as code, read from and
+// written to by a processor, split by the addressing mode of the instruction
+// that did it. They show where guests actually touch memory, and so which
+// regions are worth mapping directly, and where the callbacks of devices are
+// called the most.
+//
+// A heatmap sits on the bus of the processor: attaching it puts it between
+// the core and the read and write functions (and their userdata), and turns
+// on FEATURE_TRACE, whose cores go through the bus for every access. Reads are
+// told apart by the trace hook, which is called before each instruction: the
+// first read after it is the opcode, and the operand bytes follow. A trace
+// hook already set keeps being called, on the bus of its own, so that what it
+// reads is not counted. As the bus is no longer that of an address space, the
+// processor leaves the resident run loop and native block copies alone while
+// the heatmap is attached, so that it sees everything; nothing else changes,
+// and detaching it costs nothing afterwards. Accesses made by interrupts are
+// counted along with those of the instruction run before them.
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "processor.h"
+#include "definitions.h"
+
+#define HEATMAP_MODES (MODE_INDIRECT_Y + 1)
+
+// Kinds of accesses
+typedef enum : uint8_t {
+    HEATMAP_FETCH = 0, // opcodes and operands
+    HEATMAP_READ,      // data, pointers and the stack
+    HEATMAP_WRITE,
+    HEATMAP_ACCESSES,
+} Heatmap_access;
+
+typedef struct {
+    uint64_t (*counts)[HEATMAP_ACCESSES][HEATMAP_MODES]; // per block
+    uint8_t shift;      // a block is 1 << shift addresses long
+
+    // Instruction being run, as far as the bus can tell
+    Mode mode;
+    uint8_t operands;   // operand bytes still to be fetched
+    uint16_t operand;   // address of the next one
+    bool opcode;        // the next read is an opcode
+
+    // Processor the heatmap is attached to, and what it replaced
+    Processor *proc;
+    AddrReader read;
+    AddrWriter write;
+    void *u;
+    Tracer trace;
+    uint8_t features;
+} Heatmap;
+
+// Initialize a heatmap with blocks of 1 << shift addresses: 0 counts every
+// address on its own and 8 counts whole pages. Returns false if the shift is
+// larger than that, or on allocation failure
+bool heatmap_init(Heatmap *map, uint8_t shift);
+
+// Free the counters of a heatmap
+void heatmap_free(Heatmap *map);
+
+// Attach a heatmap to a processor, which must not have another one attached.
+// Returns false if FEATURE_TRACE was left out of the build
+bool heatmap_attach(Heatmap *map, Processor *proc);
+
+// Detach a heatmap from its processor, giving it back its bus, trace hook
+// and features
+void heatmap_detach(Heatmap *map);
+
+// Clear the counters of a heatmap
+void heatmap_reset(Heatmap *map);
+
+// Get the number of accesses of a kind to the block of an address, done in
+// the given addressing mode
+uint64_t heatmap_get(const Heatmap *map, uint16_t addr, Heatmap_access access,
+        Mode mode);
+
+// Get the number of accesses of a kind to the block of an address, in all
+// addressing modes
+uint64_t heatmap_total(const Heatmap *map, uint16_t addr,
+        Heatmap_access access);
+
+// Write the counters that are not zero as CSV, with the columns address (of
+// the block), access (fetch, read or write), mode and count
+void heatmap_write_csv(const Heatmap *map, FILE *out);
+
+// Write a ranking of the blocks of I/O addresses with the most reads and
+// writes, the given number of them at most. When the processor was connected
+// to an address space, I/O addresses are those in its unmapped pages (see
+// space.h); otherwise all addresses go through callbacks, and are ranked
+void heatmap_write_report(const Heatmap *map, FILE *out, size_t top);
+
+#endif // LIBRE_6502_HEATMAP_H
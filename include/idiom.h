@@ -0,0 +1,50 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRE_6502_IDIOM_H
+#define LIBRE_6502_IDIOM_H
+
+// Idiom recognition. Guest programs spend a lot of their time in a handful of
+// canonical loops which copy or fill blocks of memory, such as
+//
+//     loop: lda src,x      loop: sta (ptr),y
+//           sta dst,x            iny
+//           inx                  bne loop
+//           bne loop
+//
+// When the run loop of a processor connected to an address space (see
+// space.h) is about to run one of these loops, and all the memory it touches
+// is directly mapped, the remaining iterations are done at once with memmove
+// or memset. Registers, flags, memory and the cycle count end up exactly as
+// they would after running the iterations one instruction at a time. Loops
+// whose writes would change their own code or pointers, or whose copies
+// overlap in a way that memmove does not reproduce, are left alone, and so
+// are all loops while edge coverage is counted (see coverage.h) or the last
+// instructions are recorded (see recorder.h).
+
+#include <stdint.h>
+#include "processor.h"
+
+// Run the block copy or fill loop starting at the program counter of the
+// processor, if there is one, for as many whole iterations as the given
+// number of instructions allows. Returns the number of instructions that were
+// run this way, which is 0 if no idiom was recognized. Used by the core after
+// BNE instructions, which is where these loops start over
+uint32_t idiom_run(Processor *proc, uint32_t budget);
+
+#endif // LIBRE_6502_IDIOM_H
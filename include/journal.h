@@ -0,0 +1,130 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRE_6502_JOURNAL_H
+#define LIBRE_6502_JOURNAL_H
+
+// Deterministic record and replay. Given the same program and initial state,
+// all that can make two runs of a processor differ are the values read from
+// devices (unmapped pages of an address space) and the interrupts raised by
+// the host. A journal records both into a compact, append-only file while a
+// program runs with its real devices, and later replays them with no devices
+// attached at all, so that a run from production can be reproduced exactly,
+// and much faster, since no device is emulated.
+//
+// The host drives the processor through the journal: it runs instructions
+// with journal_run and raises interrupts with journal_request and
+// journal_interrupt, between runs, in both modes; when replaying, the latter
+// two are ignored and the interrupts come from the journal instead. All
+// values are little-endian. A file is a header followed by records, each of
+// which starts with a tag byte:
+//
+//     header: magic "6502JRNL" (8 bytes), version (4 bytes)
+//     reads (tags 0x00 to 0x7F): tag + 1 values read from devices, in order
+//     IRQ (tag 0x80) and NMI (tag 0x81): instructions run and cycles counted
+//         since the previous interrupt (or since the start), as varints
+//     varint: 7 bits at a time, lowest first, the top bit set on all but the
+//         last byte (LEB128)
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "space.h"
+#include "processor.h"
+
+#define JOURNAL_MAGIC   "6502JRNL"
+#define JOURNAL_VERSION 1
+#define JOURNAL_READS   128 // most reads in a single record
+#define JOURNAL_IRQ     0x80
+#define JOURNAL_NMI     0x81
+
+typedef enum : uint8_t {
+    JOURNAL_RECORD = 0, // log device reads and interrupts
+    JOURNAL_REPLAY,     // feed them back, with no devices attached
+} Journal_mode;
+
+// Interrupt in a journal
+typedef struct {
+    uint8_t tag;           // JOURNAL_IRQ or JOURNAL_NMI, 0 if there are no more
+    uint64_t instructions; // instructions run before it
+    uint64_t cycles;       // cycle count when it happened
+    uint64_t reads;        // device reads done before it
+} JournalEvent;
+
+// Journal of a run, attached to the address space of the processor
+typedef struct {
+    Journal_mode mode;
+    uint64_t instructions; // instructions run so far (through journal_run)
+    uint64_t reads;        // device reads so far
+    uint64_t cycles;       // cycle count at the last interrupt
+    uint64_t marked;       // instructions run by the last interrupt
+    bool diverged;         // the replay went differently from the recording
+
+    // Recording: output file and reads not yet written to it
+    FILE *file;
+    uint8_t pending;
+    uint8_t read[JOURNAL_READS];
+
+    // Replay: mapped file, and separate cursors for reads and interrupts
+    const uint8_t *data;
+    size_t size;
+    size_t read_at;     // offset of the next read value
+    uint8_t read_left;  // values left in the current reads record
+    size_t event_at;    // offset past the next interrupt
+    JournalEvent next;  // next interrupt
+
+    // Address space and its devices, restored when the journal is closed
+    AddressSpace *space;
+    AddrReader io_read;
+    AddrWriter io_write;
+    void *io;
+} Journal;
+
+// Start recording the device reads of an address space, and the interrupts
+// raised through the journal, into a new file. Returns false if it cannot be
+// created
+bool journal_record(Journal *journal, const char *path, AddressSpace *space);
+
+// Start replaying a file into an address space, whose devices are detached:
+// reads from them get the recorded values, and writes to them are dropped.
+// The processor must start from the same state as the recording did. Returns
+// false if the file cannot be read or is not a journal
+bool journal_replay(Journal *journal, const char *path, AddressSpace *space);
+
+// Run the given number of instructions; returns how many were run. When
+// replaying, the recorded interrupts are raised at the exact instructions
+// they were raised at, and checked against the cycle count
+uint32_t journal_run(Journal *journal, Processor *proc, uint32_t count);
+
+// Request an interruption (IRQ), recording it; ignored when replaying
+void journal_request(Journal *journal, Processor *proc);
+
+// Generate a non-maskable interruption (NMI), recording it; ignored when
+// replaying
+void journal_interrupt(Journal *journal, Processor *proc);
+
+// Write out the reads recorded so far, so that the file holds the whole run
+// up to this point. Returns false on failure
+bool journal_flush(Journal *journal);
+
+// Stop recording or replaying, reattaching the devices of the address space.
+// Returns false if the recording could not be completely written
+bool journal_close(Journal *journal);
+
+#endif // LIBRE_6502_JOURNAL_H
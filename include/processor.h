@@ -32,6 +32,7 @@
 // This pointer is taken by the read and write functions. I think this will
 // probably always be needed.
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include "definitions.h"
@@ -40,6 +41,19 @@
 typedef uint8_t (*AddrReader)(void *userdata, uint16_t address);
 typedef void    (*AddrWriter)(void *userdata, uint16_t address, uint8_t data);
 
+// Structure representing the CPU's state and metadata (defined below)
+typedef struct Processor Processor;
+
+// Ring of the last instructions run by a processor (see recorder.h)
+typedef struct Recorder Recorder;
+
+// Bitmap of the control flow edges taken by a processor (see coverage.h)
+typedef struct Coverage Coverage;
+
+// Signature for trace hooks, called before each instruction is executed by a
+// processor with the FEATURE_TRACE feature enabled
+typedef void (*Tracer)(void *userdata, const Processor *proc);
+
 // The various CPU flags, stored in the status register. Their purpose is
 // twofold: first, they communicate to the running program information on the
 // instruction previously executed. Second, they can be set to affect future
@@ -55,8 +69,22 @@ typedef enum : uint8_t {
     FLAG_NEGATIVE = (1 << 7), // indicates the last value dealt with was negative
 } Processor_flag;
 
-// Structure representing the CPU's state and metadata
-typedef struct {
+// Optional features of the processor. The library contains a core specialized
+// for each combination of them, so disabled features cost nothing at all. They
+// can also be left out of the build entirely through meson options
+typedef enum : uint8_t {
+    FEATURE_DECIMAL = (1 << 0), // decimal mode (BCD); disable it for the 2A03
+    FEATURE_TRACE   = (1 << 1), // instrumentation, such as the trace hook
+    FEATURE_CYCLES  = (1 << 2), // count the cycles taken by each instruction
+    FEATURE_RECORD  = (1 << 3), // keep the last instructions (see recorder.h)
+} Processor_feature;
+
+// Structure representing the CPU's state and metadata. The fields are laid
+// out so that everything the core touches on each instruction (registers,
+// current instruction, cycle counter, bus and core pointers) fits in the first
+// 64 bytes, which is a single cache line on most hosts when the structure is
+// suitably aligned (as done by the arena, see arena.h)
+struct Processor {
     // Hardware registers
     uint16_t pc;      // program counter, to control the flow of execution
     uint8_t x, y;     // index registers, to hold counters and offsets
@@ -65,16 +93,48 @@ typedef struct {
     uint8_t sp;       // stack pointer, to point to the top of the stack in RAM
 
     // Metadata used by the library
+    uint8_t features; // set of enabled features (Processor_feature)
+    Instruction inst; // representation of the current instruction
+    uint8_t opcode;   // opcode of the current instruction
+    uint32_t fusion;  // set of fused instruction pairs (see fusion.h)
+    uint64_t cycles;  // number of cycles run so far (FEATURE_CYCLES)
     void *u;          // custom userdata, passed to read and write functions
     AddrReader read;  // read from addresses (user-provided)
     AddrWriter write; // write to addresses (user-provided)
-    Instruction inst; // representation of the current instruction
-} Processor;
+
+    // Core specialized for the enabled features, see processor_set_features
+    void (*step)(Processor *proc);
+    uint32_t (*run)(Processor *proc, uint32_t count);
+
+    // Rarely used metadata, kept out of the hot cache line
+    Tracer trace;       // hook called before each instruction (FEATURE_TRACE)
+    Recorder *recorder; // ring of the last instructions (FEATURE_RECORD)
+    Coverage *coverage; // edges taken, counted if not NULL (see coverage.h)
+    uint16_t call_pc;   // address a call from the host returns to
+    uint16_t call_sp;   // stack pointer after it returns (0x100 if no call)
+};
+
+// Fields added to the hot part of the structure must keep it in a cache line
+_Static_assert(offsetof(Processor, run) + sizeof(void *) <= 64,
+        "the hot fields of Processor do not fit in 64 bytes");
 
 // Initializes a new processor instance, connecting it to its address space
 void processor_init(Processor *proc, AddrReader read,
         AddrWriter write, void *userdata);
 
+// Select the optional features of the processor (Processor_feature bitmask).
+// Features that were left out of the build are ignored; the ones that actually
+// got enabled are returned, FEATURE_RECORD only being so when a recorder is
+// attached. By default, all features but tracing and recording are enabled
+uint8_t processor_set_features(Processor *proc, uint8_t features);
+
+// Select the pairs of instructions that the run loop fuses together (bitmask
+// of FUSION_BIT values, see fusion.h). Fusion is disabled by default, and is
+// never done while tracing, so that the trace hook sees every instruction.
+// Only the generic run loop does it, so enabling it switches the processor
+// to that loop, from the faster register-resident one (see resident.h)
+void processor_set_fusion(Processor *proc, uint32_t pairs);
+
 // Reset the CPU, reinitializing its state
 void processor_reset(Processor *proc);
 
@@ -84,7 +144,45 @@ void processor_request(Processor *proc);
 // Generate a non-maskable CPU interruption (NMI)
 void processor_interrupt(Processor *proc);
 
+// Ways in which DMA writes to its destination
+typedef enum : uint8_t {
+    DMA_INCREMENT = 0, // to consecutive addresses, as it reads the source
+    DMA_FIXED,         // always to the same address, such as an I/O port
+} Dma_mode;
+
+// Transfer a block of memory with DMA, stalling the processor while it goes
+// on: one cycle to halt it, then a read and a write cycle per byte, plus one
+// more to align to a read cycle when starting on an odd one (the 513 or 514
+// cycles of the NES sprite DMA, for a page). The stall is added to the cycle
+// count (FEATURE_CYCLES) and returned. Pages that are directly mapped in an
+// address space (see space.h) are transferred with memcpy; anything else
+// goes through the read and write functions, byte by byte
+uint32_t processor_dma(Processor *proc, uint16_t src, uint16_t dst,
+        uint32_t size, Dma_mode mode);
+
 // Run a single instruction as a discrete step (not cycle accurate)
 void processor_step(Processor *proc);
 
+// Run the given number of instructions in a row; returns how many were run.
+// It stops early when a call from the host returns (see processor_call)
+uint32_t processor_run(Processor *proc, uint32_t count);
+
+// Outcome of a call to a subroutine of the guest
+typedef struct {
+    uint8_t acc, x, y; // registers as the subroutine left them
+    uint8_t status;    // flags as the subroutine left them
+    bool returned;     // false if the budget ran out before it returned
+    uint32_t count;    // number of instructions run
+} CallResult;
+
+// Call the subroutine at addr from the host, with the given registers, as if
+// a JSR to it was done at the current PC. It runs in batches until the RTS
+// that matches the call, running no more than budget instructions, after
+// which the PC is back where it was. When the budget runs out first, the
+// processor is left inside the subroutine; running it further eventually
+// returns to the previous PC as well. Calls can be nested (made from read and
+// write functions or trace hooks)
+CallResult processor_call(Processor *proc, uint16_t addr, uint8_t a,
+        uint8_t x, uint8_t y, uint32_t budget);
+
 #endif // LIBRE_6502_PROCESSOR_H
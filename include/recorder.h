@@ -0,0 +1,92 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRE_6502_RECORDER_H
+#define LIBRE_6502_RECORDER_H
+
+// Flight recorder: a ring of the last instructions run by a processor, with
+// the registers as they were before each of them, so that the steps that led
+// a guest astray (into data, or overflowing the stack) can be looked at after
+// the fact. It is cheap enough to be left on: the run loops write a single
+// 8-byte entry per instruction, in cores specialized for FEATURE_RECORD, and
+// nothing else. Block copies run natively (see idiom.h) only show up as the
+// branch that started them. When the processor runs an invalid opcode, which
+// is how most crashes end up, the ring can be dumped right away.
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "processor.h"
+
+// Pack an entry of the ring: PC, opcode, A, X, Y, SP and status, from the
+// lowest byte up
+#define RECORDER_PACK(pc, opcode, a, x, y, sp, p) ((uint64_t) (uint16_t) (pc) \
+        | (uint64_t) (opcode) << 16 | (uint64_t) (a) << 24 \
+        | (uint64_t) (x) << 32 | (uint64_t) (y) << 40 \
+        | (uint64_t) (sp) << 48 | (uint64_t) (p) << 56)
+
+// Instruction in the ring, unpacked
+typedef struct {
+    uint16_t pc;
+    uint8_t opcode;
+    uint8_t acc, x, y, sp, status; // registers before it was run
+} RecorderEntry;
+
+struct Recorder {
+    uint64_t *ring; // entries, packed with RECORDER_PACK
+    uint64_t mask;  // size of the ring minus one
+    uint64_t head;  // instructions recorded so far
+    FILE *out;      // where to dump the ring on an invalid opcode (or NULL)
+    bool halted;    // an invalid opcode was run (the dump is done only once)
+};
+
+// Initialize a recorder that keeps the given number of instructions, which
+// must be a power of two. Returns false otherwise, or on allocation failure
+bool recorder_init(Recorder *rec, size_t size);
+
+// Free the ring of a recorder
+void recorder_free(Recorder *rec);
+
+// Attach a recorder to a processor, enabling FEATURE_RECORD. Returns false
+// if the feature was left out of the build
+bool recorder_attach(Recorder *rec, Processor *proc);
+
+// Detach the recorder of a processor, disabling FEATURE_RECORD
+void recorder_detach(Processor *proc);
+
+// Get the number of instructions in the ring
+size_t recorder_count(const Recorder *rec);
+
+// Get an instruction from the ring, the oldest one being at index 0
+RecorderEntry recorder_get(const Recorder *rec, size_t index);
+
+// Write the instructions in the ring to a file, oldest first, disassembled
+void recorder_dump(const Recorder *rec, FILE *out);
+
+// Called by the run loops when a processor with FEATURE_RECORD runs an
+// invalid opcode: marks the recorder as halted, dumping the ring to its file
+// the first time
+void recorder_halt(Processor *proc);
+
+// Record an instruction, whose opcode was just fetched
+static inline void recorder_put(Recorder *rec, uint64_t entry) {
+    rec->ring[rec->head++ & rec->mask] = entry;
+}
+
+#endif // LIBRE_6502_RECORDER_H
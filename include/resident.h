@@ -0,0 +1,606 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Template for the register-resident run loop, which can be instantiated with
+// any bus, so that the compiler can inline the bus right into it. The library
+// instantiates it for the read and write functions of processor.h, and for
+// address spaces (see space.h); hosts can instantiate it too, for buses of
+// their own, by defining the following before including this file:
+//
+//     RESIDENT_NAME              name of the run function to define (static)
+//     RESIDENT_FEATURES          Processor_feature bitmask (no FEATURE_TRACE)
+//     RESIDENT_READ(u, addr)     read from the bus, u being the userdata
+//     RESIDENT_WRITE(u, addr, data)  write to the bus
+//     RESIDENT_FETCH(u, addr)    read opcodes and operands (optional)
+//     RESIDENT_DECODE(opcode)    decode an opcode (optional)
+//     RESIDENT_IDIOMS            run block copies natively (optional, the bus
+//                                must be an address space, see idiom.h; not
+//                                done while recording)
+//     RESIDENT_ENTER(count)      statement run first on each call, which may
+//                                return instead, such as when the bus is not
+//                                the one the loop was made for (optional)
+//
+// The run function has the signature of Processor.run, and can be used the
+// same way (e.g. assigned to it, once the processor is initialized). The
+// registers are kept in local variables, which live in machine registers, and
+// only written back to the processor when the run function returns. A bus
+// whose functions call back into code that looks at the processor (or that
+// changes it, such as raising an interrupt) must save the registers before
+// doing so and load them back afterwards, with RESIDENT_SAVE() and
+// RESIDENT_LOAD(); the processor itself is always in scope, as proc. Each
+// opcode has its own handler, reached through a table of labels (computed
+// goto, a GNU extension), so there is no central switch and no decoding at
+// all. Fusion does not apply here, as there is no dispatch left for it to
+// save; calls from the host (see processor_call) work just as in the generic
+// core. RESIDENT_NAME and RESIDENT_FEATURES are undefined at the end, so that
+// the template can be included again with the same bus. No include guard, on
+// purpose.
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cycles.h"
+#include "idiom.h"
+#include "decimal.h"
+#include "decoder.h"
+#include "coverage.h"
+#include "recorder.h"
+#include "processor.h"
+
+#if !defined(RESIDENT_NAME) || !defined(RESIDENT_FEATURES)
+#error "RESIDENT_NAME and RESIDENT_FEATURES must be defined"
+#endif
+#if !defined(RESIDENT_READ) || !defined(RESIDENT_WRITE)
+#error "RESIDENT_READ and RESIDENT_WRITE must be defined"
+#endif
+#ifndef RESIDENT_FETCH
+#define RESIDENT_FETCH RESIDENT_READ
+#endif
+#ifndef RESIDENT_DECODE
+#define RESIDENT_DECODE decode
+#endif
+#ifndef RESIDENT_IDIOMS
+#define RESIDENT_IDIOMS 0
+#endif
+#ifndef RESIDENT_ENTER
+#define RESIDENT_ENTER(count) do {} while(0)
+#endif
+
+#define R_DECIMAL ((RESIDENT_FEATURES) & FEATURE_DECIMAL)
+#define R_CYCLES  ((RESIDENT_FEATURES) & FEATURE_CYCLES)
+#define R_RECORD  ((RESIDENT_FEATURES) & FEATURE_RECORD)
+#define R_STACK   0x0100
+
+// Write the registers back to the processor, and load them from it
+#define RESIDENT_SAVE() do { \
+    proc->pc = pc; proc->acc = a; proc->x = x; proc->y = y; \
+    proc->sp = sp; proc->status = p; proc->opcode = opcode; \
+    if(R_CYCLES) proc->cycles = cycles; \
+    if(R_RECORD) proc->recorder->head = head; \
+} while(0)
+#define RESIDENT_LOAD() do { \
+    pc = proc->pc; a = proc->acc; x = proc->x; y = proc->y; \
+    sp = proc->sp; p = proc->status; \
+    if(R_CYCLES) cycles = proc->cycles; \
+    if(R_RECORD) head = proc->recorder->head; \
+} while(0)
+#define R_CYC(base, extra) do { \
+    if(R_CYCLES) cycles += (base) + (extra); \
+} while(0)
+
+// Record the instruction whose opcode was just fetched (see recorder.h); the
+// ring is kept in locals too, and the count of entries written back on saves
+#define R_RECORD_OP() do { \
+    if(R_RECORD) \
+        ring[head++ & mask] = RECORDER_PACK(pc - 1, opcode, a, x, y, sp, p); \
+} while(0)
+
+// Count the control flow edge to the PC, if covering (see coverage.h)
+#define R_EDGE() do { \
+    if(cov != NULL) coverage_edge(cov, pc); \
+} while(0)
+
+// Bus accesses, with the address evaluated only once
+#define R_READ(address) ({ \
+    uint16_t rr_addr = (address); \
+    RESIDENT_READ(u, rr_addr); \
+})
+#define R_WRITE(address, value) do { \
+    uint16_t rw_addr = (address); \
+    uint8_t rw_data = (value); \
+    RESIDENT_WRITE(u, rw_addr, rw_data); \
+} while(0)
+#define R_FETCH() ({ \
+    uint16_t rf_addr = pc++; \
+    RESIDENT_FETCH(u, rf_addr); \
+})
+#define R_PUSH(value) R_WRITE(R_STACK | sp--, value)
+#define R_PULL() R_READ(R_STACK | ++sp)
+
+// Flags
+#define R_FLAG(flag, cond) (p = (cond) ? p | (flag) : p & ~(flag))
+#define R_ZN(value) do { \
+    uint8_t rz_value = (value); \
+    p = (p & ~(FLAG_ZERO | FLAG_NEGATIVE)) \
+        | (rz_value == 0 ? FLAG_ZERO : 0) | (rz_value & FLAG_NEGATIVE); \
+} while(0)
+
+// Addressing modes: each one fetches the operand, leaving the address in addr
+// and whether indexing crossed a page (costing a cycle to reads) in cross
+#define R_IMM addr = pc++; cross = 0
+#define R_ZP  addr = R_FETCH(); cross = 0
+#define R_ZPX addr = (uint8_t) (R_FETCH() + x); cross = 0
+#define R_ZPY addr = (uint8_t) (R_FETCH() + y); cross = 0
+#define R_ABS addr = R_FETCH(); addr |= R_FETCH() << 8; cross = 0
+#define R_ABX R_ABS; cross = (addr & 0xFF) + x > 0xFF; addr += x
+#define R_ABY R_ABS; cross = (addr & 0xFF) + y > 0xFF; addr += y
+#define R_IZX \
+    data = R_FETCH() + x; \
+    addr = R_READ(data); \
+    addr |= R_READ((uint8_t) (data + 1)) << 8; \
+    cross = 0
+#define R_IZY \
+    data = R_FETCH(); \
+    addr = R_READ(data); \
+    addr |= R_READ((uint8_t) (data + 1)) << 8; \
+    cross = (addr & 0xFF) + y > 0xFF; \
+    addr += y
+
+// Operations on the data
+#define R_ORA a |= data; R_ZN(a)
+#define R_AND a &= data; R_ZN(a)
+#define R_EOR a ^= data; R_ZN(a)
+#define R_LDA a = data; R_ZN(a)
+#define R_LDX x = data; R_ZN(x)
+#define R_LDY y = data; R_ZN(y)
+#define R_CMP(reg) R_FLAG(FLAG_CARRY, (reg) >= data); R_ZN((reg) - data)
+#define R_BIT \
+    p = (p & ~(FLAG_ZERO | FLAG_OVERFLOW | FLAG_NEGATIVE)) \
+        | (data & (FLAG_OVERFLOW | FLAG_NEGATIVE)) \
+        | ((data & a) == 0 ? FLAG_ZERO : 0)
+#define R_ADC do { \
+    if(R_DECIMAL && (p & FLAG_DECIMAL)) { \
+        uint16_t rd_entry = decimal_add_table[DECIMAL_INDEX(a, data, \
+                p & FLAG_CARRY)]; \
+        p = (p & ~DECIMAL_FLAGS) | (rd_entry >> 8); \
+        a = rd_entry & 0xFF; \
+        break; \
+    } \
+    uint16_t rs_sum = a + data + (p & FLAG_CARRY); \
+    R_FLAG(FLAG_CARRY, rs_sum & 0x0100); \
+    R_FLAG(FLAG_OVERFLOW, (rs_sum ^ a) & (rs_sum ^ data) & 0x80); \
+    a = rs_sum & 0xFF; \
+    R_ZN(a); \
+} while(0)
+#define R_SBC do { \
+    if(R_DECIMAL && (p & FLAG_DECIMAL)) { \
+        uint16_t rd_entry = decimal_sub_table[DECIMAL_INDEX(a, data, \
+                p & FLAG_CARRY)]; \
+        p = (p & ~DECIMAL_FLAGS) | (rd_entry >> 8); \
+        a = rd_entry & 0xFF; \
+        break; \
+    } \
+    uint16_t rs_diff = (0x0100 | a) - (data + !(p & FLAG_CARRY)); \
+    R_FLAG(FLAG_CARRY, rs_diff & 0x0100); \
+    R_FLAG(FLAG_OVERFLOW, (rs_diff ^ a) & ~(rs_diff ^ data) & 0x80); \
+    a = rs_diff & 0xFF; \
+    R_ZN(a); \
+} while(0)
+#define R_ASL R_FLAG(FLAG_CARRY, data & 0x80); data <<= 1; R_ZN(data)
+#define R_LSR R_FLAG(FLAG_CARRY, data & 0x01); data >>= 1; R_ZN(data)
+#define R_ROL \
+    aux = data >> 7; \
+    data = data << 1 | (p & FLAG_CARRY); \
+    R_FLAG(FLAG_CARRY, aux); \
+    R_ZN(data)
+#define R_ROR \
+    aux = data & 0x01; \
+    data = data >> 1 | (p & FLAG_CARRY) << 7; \
+    R_FLAG(FLAG_CARRY, aux); \
+    R_ZN(data)
+#define R_INC ++data; R_ZN(data)
+#define R_DEC --data; R_ZN(data)
+
+// Handlers, by kind of instruction. Each one ends by dispatching the next
+// instruction straight away, unless the count has been reached
+#define R_NEXT do { \
+    if(++i >= count) goto done; \
+    opcode = R_FETCH(); \
+    R_RECORD_OP(); \
+    goto *handlers[opcode]; \
+} while(0)
+#define R_END(code) R_CYC(cycle_table[0x##code], 0); R_NEXT
+#define R_READ_OP(code, mode, op) \
+    r_##code: mode; data = R_READ(addr); op; \
+    R_CYC(cycle_table[0x##code], cross); R_NEXT
+#define R_STORE_OP(code, mode, reg) \
+    r_##code: mode; R_WRITE(addr, reg); R_END(code)
+#define R_MODIFY_OP(code, mode, op) \
+    r_##code: mode; data = R_READ(addr); op; R_WRITE(addr, data); R_END(code)
+#define R_ACC_OP(code, op) r_##code: data = a; op; a = data; R_END(code)
+#define R_IMPLIED_OP(code, op) r_##code: op; R_END(code)
+#define R_BRANCH_OP(code, cond) \
+    r_##code: \
+    if(cond) { \
+        data = R_FETCH(); \
+        addr = pc; \
+        pc += (int8_t) data; \
+        R_CYC(cycle_table[0x##code], ((addr ^ pc) & 0xFF00) ? 2 : 1); \
+    } else { \
+        ++pc; \
+        R_CYC(cycle_table[0x##code], 0); \
+    } \
+    R_EDGE(); \
+    R_NEXT
+
+// Run a number of instructions in a row, with the registers kept in locals
+static uint32_t RESIDENT_NAME(Processor *proc, uint32_t count) {
+    _Static_assert(!((RESIDENT_FEATURES) & FEATURE_TRACE),
+            "the resident run loop does not support tracing");
+    static void *const handlers[256] = {
+        &&r_00, &&r_01, &&r_xx, &&r_xx, &&r_xx, &&r_05, &&r_06, &&r_xx,
+        &&r_08, &&r_09, &&r_0A, &&r_xx, &&r_xx, &&r_0D, &&r_0E, &&r_xx,
+        &&r_10, &&r_11, &&r_xx, &&r_xx, &&r_xx, &&r_15, &&r_16, &&r_xx,
+        &&r_18, &&r_19, &&r_xx, &&r_xx, &&r_xx, &&r_1D, &&r_1E, &&r_xx,
+        &&r_20, &&r_21, &&r_xx, &&r_xx, &&r_24, &&r_25, &&r_26, &&r_xx,
+        &&r_28, &&r_29, &&r_2A, &&r_xx, &&r_2C, &&r_2D, &&r_2E, &&r_xx,
+        &&r_30, &&r_31, &&r_xx, &&r_xx, &&r_xx, &&r_35, &&r_36, &&r_xx,
+        &&r_38, &&r_39, &&r_xx, &&r_xx, &&r_xx, &&r_3D, &&r_3E, &&r_xx,
+        &&r_40, &&r_41, &&r_xx, &&r_xx, &&r_xx, &&r_45, &&r_46, &&r_xx,
+        &&r_48, &&r_49, &&r_4A, &&r_xx, &&r_4C, &&r_4D, &&r_4E, &&r_xx,
+        &&r_50, &&r_51, &&r_xx, &&r_xx, &&r_xx, &&r_55, &&r_56, &&r_xx,
+        &&r_58, &&r_59, &&r_xx, &&r_xx, &&r_xx, &&r_5D, &&r_5E, &&r_xx,
+        &&r_60, &&r_61, &&r_xx, &&r_xx, &&r_xx, &&r_65, &&r_66, &&r_xx,
+        &&r_68, &&r_69, &&r_6A, &&r_xx, &&r_6C, &&r_6D, &&r_6E, &&r_xx,
+        &&r_70, &&r_71, &&r_xx, &&r_xx, &&r_xx, &&r_75, &&r_76, &&r_xx,
+        &&r_78, &&r_79, &&r_xx, &&r_xx, &&r_xx, &&r_7D, &&r_7E, &&r_xx,
+        &&r_xx, &&r_81, &&r_xx, &&r_xx, &&r_84, &&r_85, &&r_86, &&r_xx,
+        &&r_88, &&r_xx, &&r_8A, &&r_xx, &&r_8C, &&r_8D, &&r_8E, &&r_xx,
+        &&r_90, &&r_91, &&r_xx, &&r_xx, &&r_94, &&r_95, &&r_96, &&r_xx,
+        &&r_98, &&r_99, &&r_9A, &&r_xx, &&r_xx, &&r_9D, &&r_xx, &&r_xx,
+        &&r_A0, &&r_A1, &&r_A2, &&r_xx, &&r_A4, &&r_A5, &&r_A6, &&r_xx,
+        &&r_A8, &&r_A9, &&r_AA, &&r_xx, &&r_AC, &&r_AD, &&r_AE, &&r_xx,
+        &&r_B0, &&r_B1, &&r_xx, &&r_xx, &&r_B4, &&r_B5, &&r_B6, &&r_xx,
+        &&r_B8, &&r_B9, &&r_BA, &&r_xx, &&r_BC, &&r_BD, &&r_BE, &&r_xx,
+        &&r_C0, &&r_C1, &&r_xx, &&r_xx, &&r_C4, &&r_C5, &&r_C6, &&r_xx,
+        &&r_C8, &&r_C9, &&r_CA, &&r_xx, &&r_CC, &&r_CD, &&r_CE, &&r_xx,
+        &&r_D0, &&r_D1, &&r_xx, &&r_xx, &&r_xx, &&r_D5, &&r_D6, &&r_xx,
+        &&r_D8, &&r_D9, &&r_xx, &&r_xx, &&r_xx, &&r_DD, &&r_DE, &&r_xx,
+        &&r_E0, &&r_E1, &&r_xx, &&r_xx, &&r_E4, &&r_E5, &&r_E6, &&r_xx,
+        &&r_E8, &&r_E9, &&r_EA, &&r_xx, &&r_EC, &&r_ED, &&r_EE, &&r_xx,
+        &&r_F0, &&r_F1, &&r_xx, &&r_xx, &&r_xx, &&r_F5, &&r_F6, &&r_xx,
+        &&r_F8, &&r_F9, &&r_xx, &&r_xx, &&r_xx, &&r_FD, &&r_FE, &&r_xx,
+    };
+    RESIDENT_ENTER(count);
+    void *u = proc->u;
+    uint16_t pc, addr;
+    uint8_t a, x, y, sp, p, data, aux, cross;
+    uint64_t cycles = 0;
+    uint64_t *ring = R_RECORD ? proc->recorder->ring : NULL;
+    uint64_t mask = R_RECORD ? proc->recorder->mask : 0;
+    uint64_t head = 0;
+    (void) ring;
+    (void) mask;
+    Coverage *cov = proc->coverage;
+    uint8_t opcode = proc->opcode;
+    uint32_t i = 0;
+    // Target of the last taken BNE that did not start an idiom; it is not
+    // tried again during this run (missing an idiom only costs speed)
+    uint32_t tried = 0x10000;
+    (void) tried;
+    if(count == 0) return 0;
+    RESIDENT_LOAD();
+    opcode = R_FETCH();
+    R_RECORD_OP();
+    goto *handlers[opcode];
+
+    // Load and store operations
+    R_READ_OP(A9, R_IMM, R_LDA);
+    R_READ_OP(A5, R_ZP, R_LDA);
+    R_READ_OP(B5, R_ZPX, R_LDA);
+    R_READ_OP(AD, R_ABS, R_LDA);
+    R_READ_OP(BD, R_ABX, R_LDA);
+    R_READ_OP(B9, R_ABY, R_LDA);
+    R_READ_OP(A1, R_IZX, R_LDA);
+    R_READ_OP(B1, R_IZY, R_LDA);
+    R_READ_OP(A2, R_IMM, R_LDX);
+    R_READ_OP(A6, R_ZP, R_LDX);
+    R_READ_OP(B6, R_ZPY, R_LDX);
+    R_READ_OP(AE, R_ABS, R_LDX);
+    R_READ_OP(BE, R_ABY, R_LDX);
+    R_READ_OP(A0, R_IMM, R_LDY);
+    R_READ_OP(A4, R_ZP, R_LDY);
+    R_READ_OP(B4, R_ZPX, R_LDY);
+    R_READ_OP(AC, R_ABS, R_LDY);
+    R_READ_OP(BC, R_ABX, R_LDY);
+    R_STORE_OP(85, R_ZP, a);
+    R_STORE_OP(95, R_ZPX, a);
+    R_STORE_OP(8D, R_ABS, a);
+    R_STORE_OP(9D, R_ABX, a);
+    R_STORE_OP(99, R_ABY, a);
+    R_STORE_OP(81, R_IZX, a);
+    R_STORE_OP(91, R_IZY, a);
+    R_STORE_OP(86, R_ZP, x);
+    R_STORE_OP(96, R_ZPY, x);
+    R_STORE_OP(8E, R_ABS, x);
+    R_STORE_OP(84, R_ZP, y);
+    R_STORE_OP(94, R_ZPX, y);
+    R_STORE_OP(8C, R_ABS, y);
+
+    // Register transfer operations
+    R_IMPLIED_OP(AA, x = a; R_ZN(x));
+    R_IMPLIED_OP(A8, y = a; R_ZN(y));
+    R_IMPLIED_OP(8A, a = x; R_ZN(a));
+    R_IMPLIED_OP(98, a = y; R_ZN(a));
+    R_IMPLIED_OP(BA, x = sp; R_ZN(x));
+    R_IMPLIED_OP(9A, sp = x);
+
+    // Stack operations
+    R_IMPLIED_OP(48, R_PUSH(a));
+    R_IMPLIED_OP(08, R_PUSH(p | FLAG_BREAK | FLAG_NIL));
+    R_IMPLIED_OP(68, a = R_PULL(); R_ZN(a));
+    R_IMPLIED_OP(28, data = R_PULL();
+            p = (data & ~(FLAG_BREAK | FLAG_NIL))
+                | (p & (FLAG_BREAK | FLAG_NIL)));
+
+    // Logic operations
+    R_READ_OP(29, R_IMM, R_AND);
+    R_READ_OP(25, R_ZP, R_AND);
+    R_READ_OP(35, R_ZPX, R_AND);
+    R_READ_OP(2D, R_ABS, R_AND);
+    R_READ_OP(3D, R_ABX, R_AND);
+    R_READ_OP(39, R_ABY, R_AND);
+    R_READ_OP(21, R_IZX, R_AND);
+    R_READ_OP(31, R_IZY, R_AND);
+    R_READ_OP(49, R_IMM, R_EOR);
+    R_READ_OP(45, R_ZP, R_EOR);
+    R_READ_OP(55, R_ZPX, R_EOR);
+    R_READ_OP(4D, R_ABS, R_EOR);
+    R_READ_OP(5D, R_ABX, R_EOR);
+    R_READ_OP(59, R_ABY, R_EOR);
+    R_READ_OP(41, R_IZX, R_EOR);
+    R_READ_OP(51, R_IZY, R_EOR);
+    R_READ_OP(09, R_IMM, R_ORA);
+    R_READ_OP(05, R_ZP, R_ORA);
+    R_READ_OP(15, R_ZPX, R_ORA);
+    R_READ_OP(0D, R_ABS, R_ORA);
+    R_READ_OP(1D, R_ABX, R_ORA);
+    R_READ_OP(19, R_ABY, R_ORA);
+    R_READ_OP(01, R_IZX, R_ORA);
+    R_READ_OP(11, R_IZY, R_ORA);
+    R_READ_OP(24, R_ZP, R_BIT);
+    R_READ_OP(2C, R_ABS, R_BIT);
+
+    // Arithmetic operations
+    R_READ_OP(69, R_IMM, R_ADC);
+    R_READ_OP(65, R_ZP, R_ADC);
+    R_READ_OP(75, R_ZPX, R_ADC);
+    R_READ_OP(6D, R_ABS, R_ADC);
+    R_READ_OP(7D, R_ABX, R_ADC);
+    R_READ_OP(79, R_ABY, R_ADC);
+    R_READ_OP(61, R_IZX, R_ADC);
+    R_READ_OP(71, R_IZY, R_ADC);
+    R_READ_OP(E9, R_IMM, R_SBC);
+    R_READ_OP(E5, R_ZP, R_SBC);
+    R_READ_OP(F5, R_ZPX, R_SBC);
+    R_READ_OP(ED, R_ABS, R_SBC);
+    R_READ_OP(FD, R_ABX, R_SBC);
+    R_READ_OP(F9, R_ABY, R_SBC);
+    R_READ_OP(E1, R_IZX, R_SBC);
+    R_READ_OP(F1, R_IZY, R_SBC);
+    R_READ_OP(C9, R_IMM, R_CMP(a));
+    R_READ_OP(C5, R_ZP, R_CMP(a));
+    R_READ_OP(D5, R_ZPX, R_CMP(a));
+    R_READ_OP(CD, R_ABS, R_CMP(a));
+    R_READ_OP(DD, R_ABX, R_CMP(a));
+    R_READ_OP(D9, R_ABY, R_CMP(a));
+    R_READ_OP(C1, R_IZX, R_CMP(a));
+    R_READ_OP(D1, R_IZY, R_CMP(a));
+    R_READ_OP(E0, R_IMM, R_CMP(x));
+    R_READ_OP(E4, R_ZP, R_CMP(x));
+    R_READ_OP(EC, R_ABS, R_CMP(x));
+    R_READ_OP(C0, R_IMM, R_CMP(y));
+    R_READ_OP(C4, R_ZP, R_CMP(y));
+    R_READ_OP(CC, R_ABS, R_CMP(y));
+
+    // Increment and decrement operations
+    R_MODIFY_OP(E6, R_ZP, R_INC);
+    R_MODIFY_OP(F6, R_ZPX, R_INC);
+    R_MODIFY_OP(EE, R_ABS, R_INC);
+    R_MODIFY_OP(FE, R_ABX, R_INC);
+    R_MODIFY_OP(C6, R_ZP, R_DEC);
+    R_MODIFY_OP(D6, R_ZPX, R_DEC);
+    R_MODIFY_OP(CE, R_ABS, R_DEC);
+    R_MODIFY_OP(DE, R_ABX, R_DEC);
+    R_IMPLIED_OP(E8, ++x; R_ZN(x));
+    R_IMPLIED_OP(C8, ++y; R_ZN(y));
+    R_IMPLIED_OP(CA, --x; R_ZN(x));
+    R_IMPLIED_OP(88, --y; R_ZN(y));
+
+    // Shift operations
+    R_ACC_OP(0A, R_ASL);
+    R_MODIFY_OP(06, R_ZP, R_ASL);
+    R_MODIFY_OP(16, R_ZPX, R_ASL);
+    R_MODIFY_OP(0E, R_ABS, R_ASL);
+    R_MODIFY_OP(1E, R_ABX, R_ASL);
+    R_ACC_OP(4A, R_LSR);
+    R_MODIFY_OP(46, R_ZP, R_LSR);
+    R_MODIFY_OP(56, R_ZPX, R_LSR);
+    R_MODIFY_OP(4E, R_ABS, R_LSR);
+    R_MODIFY_OP(5E, R_ABX, R_LSR);
+    R_ACC_OP(2A, R_ROL);
+    R_MODIFY_OP(26, R_ZP, R_ROL);
+    R_MODIFY_OP(36, R_ZPX, R_ROL);
+    R_MODIFY_OP(2E, R_ABS, R_ROL);
+    R_MODIFY_OP(3E, R_ABX, R_ROL);
+    R_ACC_OP(6A, R_ROR);
+    R_MODIFY_OP(66, R_ZP, R_ROR);
+    R_MODIFY_OP(76, R_ZPX, R_ROR);
+    R_MODIFY_OP(6E, R_ABS, R_ROR);
+    R_MODIFY_OP(7E, R_ABX, R_ROR);
+
+    // Jump operations
+    R_IMPLIED_OP(4C, R_ABS; pc = addr; R_EDGE());
+    R_IMPLIED_OP(6C, R_ABS;
+            data = R_READ(addr);
+            // The original bug: the pointer does not cross pages
+            addr = (addr & 0x00FF) == 0x00FF ? addr & 0xFF00 : addr + 1;
+            pc = data | R_READ(addr) << 8;
+            R_EDGE());
+    R_IMPLIED_OP(20, R_ABS;
+            R_PUSH((pc - 1) >> 8);
+            R_PUSH((pc - 1) & 0xFF);
+            pc = addr;
+            R_EDGE());
+r_60:
+    addr = R_PULL();
+    addr |= R_PULL() << 8;
+    pc = addr + 1;
+    R_CYC(cycle_table[0x60], 0);
+    R_EDGE();
+    // Calls from the host end at the matching RTS (see processor_call)
+    if(sp == proc->call_sp && pc == proc->call_pc) {
+        ++i;
+        goto done;
+    }
+    R_NEXT;
+
+    // Branch operations. Block copy and fill loops start over after a BNE
+    // (see idiom.h), which is the only one that tries them
+    R_BRANCH_OP(F0, p & FLAG_ZERO);
+    R_BRANCH_OP(B0, p & FLAG_CARRY);
+    R_BRANCH_OP(90, !(p & FLAG_CARRY));
+    R_BRANCH_OP(30, p & FLAG_NEGATIVE);
+    R_BRANCH_OP(10, !(p & FLAG_NEGATIVE));
+    R_BRANCH_OP(70, p & FLAG_OVERFLOW);
+    R_BRANCH_OP(50, !(p & FLAG_OVERFLOW));
+r_D0:
+    if(p & FLAG_ZERO) {
+        ++pc;
+        R_CYC(cycle_table[0xD0], 0);
+        R_EDGE();
+        R_NEXT;
+    }
+    data = R_FETCH();
+    addr = pc;
+    pc += (int8_t) data;
+    R_CYC(cycle_table[0xD0], ((addr ^ pc) & 0xFF00) ? 2 : 1);
+    R_EDGE();
+    if(RESIDENT_IDIOMS && !R_RECORD && pc != tried && i + 1 < count) {
+        RESIDENT_SAVE();
+        uint32_t ran = idiom_run(proc, count - i - 1);
+        RESIDENT_LOAD();
+        if(ran == 0) tried = pc;
+        i += ran;
+    }
+    R_NEXT;
+
+    // Flag operations
+    R_IMPLIED_OP(38, p |= FLAG_CARRY);
+    R_IMPLIED_OP(78, p |= FLAG_IRQ_DIS);
+    R_IMPLIED_OP(F8, p |= FLAG_DECIMAL);
+    R_IMPLIED_OP(18, p &= ~FLAG_CARRY);
+    R_IMPLIED_OP(58, p &= ~FLAG_IRQ_DIS);
+    R_IMPLIED_OP(D8, p &= ~FLAG_DECIMAL);
+    R_IMPLIED_OP(B8, p &= ~FLAG_OVERFLOW);
+
+    // System operations. BRK skips the byte after it and pushes the status
+    // with the break flag, as in the generic core
+    R_IMPLIED_OP(00, ++pc;
+            R_PUSH(pc >> 8);
+            R_PUSH(pc & 0xFF);
+            R_PUSH(p | FLAG_BREAK | FLAG_NIL);
+            p |= FLAG_IRQ_DIS;
+            addr = R_READ(IRQ_VECTOR);
+            addr |= R_READ(IRQ_VECTOR + 1) << 8;
+            pc = addr;
+            R_EDGE());
+    R_IMPLIED_OP(40, data = R_PULL();
+            p = (data & ~(FLAG_BREAK | FLAG_NIL))
+                | (p & (FLAG_BREAK | FLAG_NIL));
+            addr = R_PULL();
+            addr |= R_PULL() << 8;
+            pc = addr;
+            R_EDGE());
+    R_IMPLIED_OP(EA, (void) 0);
+r_xx:
+    // Invalid opcodes do nothing, but end the flight of a recording processor
+    if(R_RECORD) {
+        RESIDENT_SAVE();
+        recorder_halt(proc);
+        RESIDENT_LOAD();
+    }
+    R_CYC(cycle_table[opcode], 0);
+    R_NEXT;
+
+done:
+    RESIDENT_SAVE();
+    proc->inst = RESIDENT_DECODE(opcode);
+    return i;
+}
+
+#undef R_BRANCH_OP
+#undef R_IMPLIED_OP
+#undef R_ACC_OP
+#undef R_MODIFY_OP
+#undef R_STORE_OP
+#undef R_READ_OP
+#undef R_END
+#undef R_NEXT
+#undef R_DEC
+#undef R_INC
+#undef R_ROR
+#undef R_ROL
+#undef R_LSR
+#undef R_ASL
+#undef R_SBC
+#undef R_ADC
+#undef R_BIT
+#undef R_CMP
+#undef R_LDY
+#undef R_LDX
+#undef R_LDA
+#undef R_EOR
+#undef R_AND
+#undef R_ORA
+#undef R_IZY
+#undef R_IZX
+#undef R_ABY
+#undef R_ABX
+#undef R_ABS
+#undef R_ZPY
+#undef R_ZPX
+#undef R_ZP
+#undef R_IMM
+#undef R_ZN
+#undef R_FLAG
+#undef R_PULL
+#undef R_PUSH
+#undef R_FETCH
+#undef R_WRITE
+#undef R_READ
+#undef R_CYC
+#undef R_EDGE
+#undef R_RECORD_OP
+#undef RESIDENT_LOAD
+#undef RESIDENT_SAVE
+#undef R_STACK
+#undef R_RECORD
+#undef R_CYCLES
+#undef R_DECIMAL
+#undef RESIDENT_FEATURES
+#undef RESIDENT_NAME
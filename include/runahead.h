@@ -0,0 +1,91 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef LIBRE_6502_RUNAHEAD_H
+#define LIBRE_6502_RUNAHEAD_H
+
+// Run-ahead: running a processor some frames into the future to cut the
+// latency of its reaction to input. Each frame, the real frame is run with
+// the current input and the machine is snapshotted; then more frames are run
+// ahead with the same input, the last of which is the one presented, and the
+// machine is rolled back to the snapshot. What the host sees is thus the
+// output the guest would give that many frames later, had the input been
+// held down since. As the real frame is also the first speculative one, this
+// takes one more frame of emulation per frame run ahead.
+//
+// Snapshots are taken in memory and cost next to nothing: the pages of the
+// address space are shared with the snapshot, so only the ones written to
+// while running ahead get copied (see space_snapshot). Pages mapped to I/O
+// belong to the host, which saves and restores the state of its devices
+// through the hooks given to runahead_init.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "space.h"
+#include "processor.h"
+
+// Host hooks, any of which may be NULL. The state of the devices is saved
+// after each real frame and restored after running ahead; everything but
+// the output presented should be. The frame hook is called at the end of
+// every frame, real or not, with the processor stopped at its boundary: it
+// is where the host raises the interrupts of the frame (such as vertical
+// blank) and takes the output, which is to be presented if the frame is the
+// last one run (shown). Output of frames that are not real, such as sound,
+// should not be played twice
+typedef struct {
+    void (*save)(void *host);
+    void (*restore)(void *host);
+    void (*frame)(void *host, Processor *proc, bool real, bool shown);
+} RunaheadHooks;
+
+// Run-ahead state of a processor and its address space
+typedef struct {
+    Processor *proc;
+    AddressSpace *space;
+    uint64_t frame;    // length of a frame, in cycles
+    uint32_t ahead;    // frames run ahead of the real one
+    uint64_t end;      // cycle count at which the current frame ends
+    RunaheadHooks hooks;
+    void *host;        // userdata of the hooks
+
+    // Snapshot after the last real frame
+    Processor saved;
+    SpaceSnapshot memory;
+    uint64_t saved_end;
+} Runahead;
+
+// Set up run-ahead for a processor connected to an address space, with the
+// given frame length, in cycles, and number of frames to run ahead (zero
+// only runs real frames). Frames are counted in cycles, so the processor
+// needs the FEATURE_CYCLES feature; returns false if it does not have it
+bool runahead_init(Runahead *ra, Processor *proc, AddressSpace *space,
+        uint64_t frame, uint32_t ahead, RunaheadHooks hooks, void *host);
+
+// Change the number of frames run ahead, such as when the latency of the
+// guest program is measured
+void runahead_set_ahead(Runahead *ra, uint32_t ahead);
+
+// Run a real frame and then the frames ahead of it, leaving the machine at
+// the end of the real one. Each frame may run past its end by a single
+// instruction, which the next one makes up for. Returns false if a call from
+// the host returned before the end of the real frame (see processor_call)
+bool runahead_frame(Runahead *ra);
+
+// Release the snapshot held by the run-ahead state
+void runahead_free(Runahead *ra);
+
+#endif // LIBRE_6502_RUNAHEAD_H
@@ -0,0 +1,85 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRE_6502_SAVESTATE_H
+#define LIBRE_6502_SAVESTATE_H
+
+// Savestates: snapshots of a processor and its address space on disk, from
+// which a simulation can be restarted. Loading one does not parse or copy
+// memory: the file is mapped into memory and its pages are mapped straight
+// into the address space, where they are only copied on their first write,
+// so restoring even many large checkpoints is nearly instant. Any number of
+// address spaces can be loaded from the same open savestate. All values are
+// little-endian. A file is laid out as follows:
+//
+//     0     magic "6502SAVE" (8 bytes)
+//     8     version (4 bytes)
+//     12    number of memory pages in the file (2 bytes)
+//     14    PC (2 bytes)
+//     16    accumulator, X, Y, stack pointer and status (1 byte each)
+//     21    enabled features (1 byte, Processor_feature)
+//     22    pending interrupts (1 byte, bit 0 for IRQ and bit 1 for NMI)
+//     23    reserved, zero (1 byte)
+//     24    cycle count (8 bytes)
+//     32    fused instruction pairs (4 bytes, see fusion.h)
+//     36    how each page of the address space is mapped (256 bytes, Map_kind)
+//     4096  contents of each page mapped to RAM or ROM, 256 bytes each, in
+//           the order of the address space
+//
+// The processor raises interrupts as soon as the host requests them, so none
+// are ever pending when a savestate is made; the field is there for cores
+// that latch them. Pages mapped to I/O belong to the host, which saves the
+// state of its devices by itself, and so does the state of calls from the
+// host (see processor_call), which savestates do not include
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "space.h"
+#include "processor.h"
+
+#define SAVESTATE_MAGIC   "6502SAVE"
+#define SAVESTATE_VERSION 1
+#define SAVESTATE_MEMORY  4096 // offset of memory, aligned to the host page
+
+// Savestate mapped into memory
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+} Savestate;
+
+// Save the state of a processor and of its address space into a new file.
+// Returns false if it cannot be written
+bool savestate_save(const char *path, const Processor *proc,
+        const AddressSpace *space);
+
+// Open a savestate, mapping it into memory. Returns false if the file cannot
+// be read or is not a savestate
+bool savestate_open(Savestate *state, const char *path);
+
+// Restore the state of a processor, which must be connected to the given
+// address space, from a savestate. The memory of the savestate replaces all
+// of the pages of the space, leaving its devices alone; the savestate must
+// stay open for as long as the space maps any of them
+void savestate_load(const Savestate *state, Processor *proc,
+        AddressSpace *space);
+
+// Close a savestate, unmapping it from memory
+void savestate_close(Savestate *state);
+
+#endif // LIBRE_6502_SAVESTATE_H
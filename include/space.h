@@ -0,0 +1,158 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRE_6502_SPACE_H
+#define LIBRE_6502_SPACE_H
+
+// Paged address spaces with shared pages. The 64KiB address space of the 6502
+// is split into 256 pages of 256 bytes, each of which can be mapped to RAM, to
+// ROM or left to the host (I/O). Pages are reference counted, so that many
+// address spaces (one per instance) can map the very same pages of a program
+// image. A shared page that is mapped as writable is only copied into a
+// private page when an instance first writes to it (copy on write). Running
+// thousands of instances of the same program thus costs a single copy of its
+// code and data, plus the pages each instance actually writes to.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "processor.h"
+
+#define SPACE_PAGE_SIZE 256 // size of a page, in bytes
+#define SPACE_PAGES 256 // number of pages in an address space
+
+// Page number and offset within the page of an address
+#define PAGE_OF(addr)    ((uint16_t) (addr) >> 8)
+#define OFFSET_OF(addr)  ((uint16_t) (addr) & 0xFF)
+
+// Ways in which a page can be mapped
+typedef enum : uint8_t {
+    MAP_IO = 0, // not mapped to memory, handled by the host callbacks
+    MAP_ROM,    // read only memory, writes are ignored
+    MAP_RAM,    // read-write memory, copied on write if shared
+} Map_kind;
+
+// Reference counted page of memory
+typedef struct Page Page;
+
+// Immutable set of pages with the contents of a program or ROM image, which
+// can be mapped into any number of address spaces
+typedef struct {
+    size_t pages; // number of pages
+    Page **page;  // the pages themselves
+} Image;
+
+// Address space of an instance. The direct maps contain pointers to the data
+// of each page, for fast access; a NULL entry in the read map means the page
+// is handled by the host, and one in the write map means writing to the page
+// must go through the slow path (the page is either ROM, I/O or shared). The
+// dirty bitmap tracks which pages were written to or remapped, so that work
+// that depends on the contents of memory (such as hashing) can be redone only
+// for those pages; it is up to such users to clear it. Borrowed pages are
+// mapped from memory that the space does not own (see space_map_memory)
+typedef struct {
+    const uint8_t *rmap[SPACE_PAGES];    // direct map for reads
+    uint8_t *wmap[SPACE_PAGES];          // direct map for writes
+    Map_kind kind[SPACE_PAGES];          // how each page is mapped
+    uint64_t dirty[SPACE_PAGES / 64];    // pages changed, one bit each
+    uint64_t borrowed[SPACE_PAGES / 64]; // pages not owned, one bit each
+
+    // Host callbacks for unmapped (I/O) pages, and their userdata
+    AddrReader io_read;
+    AddrWriter io_write;
+    void *io;
+} AddressSpace;
+
+// Create an image from the given data, which is copied into shared pages. The
+// last page is padded with zeros. Returns NULL on allocation failure
+Image *image_create(const uint8_t *data, size_t size);
+
+// Destroy an image. Its pages live on for as long as they are mapped somewhere
+void image_destroy(Image *image);
+
+// Initialize an address space with all pages unmapped. Accesses to unmapped
+// pages are handled by the given callbacks, either of which may be NULL (in
+// which case reads return 0 and writes are ignored)
+void space_init(AddressSpace *space, AddrReader io_read, AddrWriter io_write,
+        void *io);
+
+// Unmap every page of an address space, releasing the memory it used
+void space_free(AddressSpace *space);
+
+// Map fresh, zeroed and private RAM pages, starting at the given page.
+// Returns false on allocation failure
+bool space_map_ram(AddressSpace *space, uint8_t first, size_t count);
+
+// Map the pages of an image, starting at the given page, as ROM or as RAM. In
+// the latter case, each page is copied on its first write
+void space_map_image(AddressSpace *space, const Image *image, uint8_t first,
+        Map_kind kind);
+
+// Map memory that the space does not own, such as a file mapped into memory
+// (see savestate.h), starting at the given page. It is never written to: RAM
+// pages are copied into private pages on their first write, like the shared
+// pages of images. The memory must outlive the mapping
+void space_map_memory(AddressSpace *space, uint8_t first, const uint8_t *data,
+        size_t count, Map_kind kind);
+
+// Unmap pages, leaving them to the host callbacks
+void space_unmap(AddressSpace *space, uint8_t first, size_t count);
+
+// Mark a page as dirty. Writes through space_write do this by themselves, so
+// this is only needed when the host changes memory through the write map
+void space_mark_dirty(AddressSpace *space, uint8_t index);
+
+// Get the number of pages that are private to an address space (not shared)
+size_t space_private_pages(const AddressSpace *space);
+
+// Snapshot of the memory of an address space. It holds references to the
+// pages of the space rather than copies of them, so it takes no memory of its
+// own until the space writes to them (see space_snapshot)
+typedef struct {
+    const uint8_t *rmap[SPACE_PAGES];    // data of each page
+    Map_kind kind[SPACE_PAGES];          // how each page was mapped
+    uint64_t borrowed[SPACE_PAGES / 64]; // pages not owned, one bit each
+} SpaceSnapshot;
+
+// Take a snapshot of the memory of an address space, replacing whatever the
+// snapshot held before; it must be zeroed before its first use. No memory is
+// copied: the pages are shared with the snapshot, and so the space copies
+// each one on its next write to it
+void space_snapshot(AddressSpace *space, SpaceSnapshot *snap);
+
+// Bring the memory of an address space back to a snapshot of it. Only the
+// pages that changed since are remapped (and marked dirty); the snapshot is
+// kept, and can be rolled back to again
+void space_rollback(AddressSpace *space, const SpaceSnapshot *snap);
+
+// Release the pages held by a snapshot, leaving it empty
+void space_snapshot_free(SpaceSnapshot *snap);
+
+// Read from an address space; suitable as an AddrReader
+uint8_t space_read(void *userdata, uint16_t addr);
+
+// Write to an address space; suitable as an AddrWriter
+void space_write(void *userdata, uint16_t addr, uint8_t data);
+
+// Initialize a processor connected to an address space. Its run loop then
+// accesses directly mapped pages by itself, keeping the registers out of the
+// processor structure in the meantime (see resident.h), and does block
+// copies and fills over them natively (idiom.h)
+void space_connect(AddressSpace *space, Processor *proc);
+
+#endif // LIBRE_6502_SPACE_H
@@ -0,0 +1,109 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRE_6502_SYSTEM_H
+#define LIBRE_6502_SYSTEM_H
+
+// Systems of several processors, such as a main CPU along with the CPU of a
+// disk drive or of a sound board, that share memory or talk through latches.
+// The scheduler runs them in turns, each for a quantum of cycles, so that no
+// processor gets further ahead of the others than that; between turns,
+// everything is deterministic. Larger quanta mean fewer switches between
+// processors, and thus faster runs, but coarser interleaving of whatever
+// they do to each other.
+//
+// To get the best of both, the scheduler only interleaves finely around
+// accesses to shared regions: when a processor touches one, the turns of the
+// processors after it in the round are cut short, and turns are kept tight
+// until the processors leave the shared regions alone for a while. The
+// processor that touched the region is not stopped right away, though: it
+// goes on to the end of the batch of instructions it was running, which may
+// be the end of its turn. The first access after a quiet period can thus be
+// up to a quantum off; only the ones that follow are finely interleaved.
+// Shared regions are pages that each processor leaves to its devices (I/O
+// pages of its address space, see space.h), all of which are handled by the
+// very same devices; memory shared by the processors is mapped that way too,
+// as a device over host memory. Time is counted in cycles, so the processors
+// need the FEATURE_CYCLES feature, and all of them run at the same clock
+// rate.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "space.h"
+#include "processor.h"
+
+#define SYSTEM_CPUS 8 // most processors in a system
+
+typedef struct System System;
+
+// Processor of a system. The devices of its address space are replaced by
+// the scheduler, which passes accesses on to them
+typedef struct {
+    System *system;
+    Processor *proc;
+    AddressSpace *space;
+    uint64_t offset;     // its cycle count at the time 0 of the system
+
+    // The devices of the address space
+    AddrReader io_read;
+    AddrWriter io_write;
+    void *io;
+} SystemCpu;
+
+struct System {
+    SystemCpu cpu[SYSTEM_CPUS];
+    uint8_t count;
+    int current;                       // index of the running processor
+    uint64_t shared[SPACE_PAGES / 64]; // shared pages, one bit each
+
+    uint32_t quantum;     // longest turn, in cycles
+    uint32_t tight;       // turn length around accesses to shared regions
+    uint32_t window;      // cycles turns stay tight after such an access
+                          // (a quantum, by default)
+    uint64_t now;         // time that all processors have reached, in cycles
+    uint64_t tight_until; // time until which turns are kept tight
+    bool touched;         // a shared region was accessed in this turn
+    uint64_t rounds;      // rounds of turns taken so far
+};
+
+// Initialize a system with no processors, given the length of a turn, in
+// cycles, normally and around accesses to shared regions
+void system_init(System *sys, uint32_t quantum, uint32_t tight);
+
+// Add a processor, connected to an address space, to a system. Its time
+// starts at the time of the system. Returns its index, or -1 if the system
+// is full or the processor does not count cycles
+int system_add(System *sys, Processor *proc, AddressSpace *space);
+
+// Mark pages as shared between the processors of a system
+void system_share(System *sys, uint8_t first, size_t count);
+
+// Get the time of a processor of the system, in cycles
+uint64_t system_time(const System *sys, int index);
+
+// Run all processors for the given number of cycles, from the time they
+// have all reached. Each one may run past it by a single instruction.
+// Returns the time they have all reached then
+uint64_t system_run(System *sys, uint64_t cycles);
+
+// Remove all processors from a system, giving the devices back to their
+// address spaces
+void system_free(System *sys);
+
+#endif // LIBRE_6502_SYSTEM_H
@@ -0,0 +1,108 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRE_6502_THREAD_H
+#define LIBRE_6502_THREAD_H
+
+// Threaded execution mode, in which a processor runs on a dedicated thread.
+// Host threads (UI, I/O and so on) never touch the processor directly, and
+// thus never have to lock around it; instead, they send commands to it
+// through a lock-free queue, which the CPU thread drains between batches of
+// instructions, and read its registers from snapshots that it publishes
+// through a seqlock after each batch.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "processor.h"
+
+// Capacity of the command queue (a power of two)
+#define COMMAND_QUEUE_SIZE 256
+
+// Commands that can be sent to the CPU thread
+typedef enum : uint8_t {
+    COMMAND_IRQ = 0,  // request an interruption (processor_request)
+    COMMAND_NMI,      // generate a non-maskable interruption
+    COMMAND_POKE,     // write data to an address
+    COMMAND_PAUSE,    // stop running instructions until resumed
+    COMMAND_RESUME,   // resume running instructions
+    COMMAND_SNAPSHOT, // publish a snapshot right away, even while paused
+} Command_kind;
+
+typedef struct {
+    Command_kind kind;
+    uint8_t data;     // data to be written (COMMAND_POKE)
+    uint16_t addr;    // address to write to (COMMAND_POKE)
+} Command;
+
+// Consistent copy of the registers of a running processor
+typedef struct {
+    uint16_t pc;
+    uint8_t x, y, acc, status, sp;
+    bool paused;
+    uint64_t cycles;
+    uint64_t instructions; // number of instructions run by the thread
+    uint32_t sequence;     // number of snapshots published before this one
+} Snapshot;
+
+// A processor running on its own thread
+typedef struct {
+    Processor *proc;
+    uint32_t batch;  // number of instructions run between command checks
+    pthread_t thread;
+
+    // Bounded multi-producer, single-consumer command queue. Each slot has a
+    // sequence number telling whether it is free or holds a command, so that
+    // producers only ever contend on the tail index
+    struct {
+        atomic_uint_fast32_t seq;
+        Command command;
+    } queue[COMMAND_QUEUE_SIZE];
+    atomic_uint_fast32_t tail; // next slot to be claimed by a producer
+    uint_fast32_t head;        // next slot to be consumed (CPU thread only)
+
+    // Seqlock protecting the published snapshot: it is odd while the
+    // snapshot is being written. The snapshot itself is kept in atomic words,
+    // so that readers racing with the writer are still well defined
+    atomic_uint_fast32_t version;
+    atomic_uint_fast64_t words[3];
+
+    atomic_bool stop;
+    bool paused;
+    uint64_t instructions;
+} CpuThread;
+
+// Start running a processor on a new thread, in batches of the given number
+// of instructions. The processor must not be touched until the thread is
+// stopped. Returns false if the thread could not be created
+bool cpu_thread_start(CpuThread *thread, Processor *proc, uint32_t batch);
+
+// Stop the CPU thread and wait for it to finish. Commands still in the queue
+// are discarded
+void cpu_thread_stop(CpuThread *thread);
+
+// Send a command to the CPU thread; safe to call from any number of threads.
+// Returns false if the queue is full
+bool cpu_thread_send(CpuThread *thread, Command command);
+
+// Read the latest snapshot published by the CPU thread; safe to call from any
+// number of threads
+void cpu_thread_snapshot(CpuThread *thread, Snapshot *snapshot);
+
+#endif // LIBRE_6502_THREAD_H
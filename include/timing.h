@@ -0,0 +1,94 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRE_6502_TIMING_H
+#define LIBRE_6502_TIMING_H
+
+// Static timing analysis: bounds on the number of cycles a routine of the
+// guest takes, from its first instruction up to the RTS (or RTI) that ends
+// it, without running it. This is meant for code that must fit in a fixed
+// budget, such as raster interrupt handlers and audio drivers.
+//
+// The control flow graph of the routine is built from the decoded code, and
+// every instruction is given its base cost (see cycles.h). Taken branches
+// cost one more cycle, and another one when they land on a different page;
+// those costs are exact, as the target is known. Indexed reads that may cross
+// a page cost one more cycle in the worst case only, unless their base
+// address is at the start of a page, so that they never can. Subroutines are
+// analyzed on their own and their bounds added at each JSR, which is assumed
+// to return to the instruction that follows it.
+//
+// Loops must be given bounds: the least and the most number of times their
+// first instruction (the header, where the branch back to it lands) is run
+// each time the loop is entered. Loops nested in others are bounded on their
+// own, per entry, and loops that can be entered other than through their
+// header are not supported. Neither are indirect jumps, BRK, invalid opcodes
+// and recursion, which are reported as errors along with where they are.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Bounds of a loop, by the address of its header
+typedef struct {
+    uint16_t address;
+    uint32_t min, max; // times the header is run per entry, at least 1
+} TimingBound;
+
+typedef enum : uint8_t {
+    TIMING_OK = 0,
+    TIMING_UNBOUNDED,   // a loop was not given bounds
+    TIMING_IRREDUCIBLE, // a loop can be entered other than through its header
+    TIMING_INDIRECT,    // an indirect jump
+    TIMING_INVALID,     // an invalid opcode, or BRK
+    TIMING_RECURSIVE,   // a subroutine that calls itself, directly or not
+    TIMING_NO_RETURN,   // the routine never gets to an RTS or RTI
+    TIMING_NO_MEMORY,
+} Timing_error;
+
+// Basic block on the critical path, the one that takes the most cycles
+typedef struct {
+    uint16_t address; // of its first instruction
+    uint16_t last;    // address of its last instruction
+    uint64_t count;   // number of times it is run on the path
+    uint64_t cycles;  // taken by it on the path, including calls
+} TimingStep;
+
+typedef struct {
+    Timing_error error;
+    uint16_t at;        // address where the error was found
+    uint64_t best;      // least number of cycles the routine takes
+    uint64_t worst;     // most number of cycles the routine takes
+    TimingStep *path;   // critical path, in the order the blocks are reached
+    size_t length;      // number of blocks in it
+} Timing;
+
+// Analyze the routine at the given entry point of a 64KiB memory image, with
+// the given loop bounds. Returns false on errors, which are described by the
+// error and at fields of the result. It must be freed with timing_free
+// either way
+bool timing_analyze(Timing *timing, const uint8_t *memory, uint16_t entry,
+        const TimingBound *bounds, size_t count);
+
+// Free the critical path of an analysis
+void timing_free(Timing *timing);
+
+// Get a description of an error, such as "loop without bounds"
+const char *timing_error_name(Timing_error error);
+
+#endif // LIBRE_6502_TIMING_H
@@ -0,0 +1,134 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRE_6502_VECTORS_H
+#define LIBRE_6502_VECTORS_H
+
+// Single-step test vectors. Each vector describes a single instruction: the
+// registers and the relevant memory before it runs, the registers and memory
+// after it, the number of cycles it takes and the list of bus accesses it
+// does, in order. Memory is sparse: only the bytes the instruction touches
+// (its own opcode and operands included) are part of a vector, and touching
+// anything else is a failure.
+//
+// Vectors are stored in a compact binary format, so that millions of them
+// can be loaded (mapped into memory) and checked in seconds. All values are
+// little-endian. A file is a header followed by fixed-size records:
+//
+//     header: magic "6502VECS" (8 bytes), version (4 bytes), count (4 bytes)
+//     record: initial registers (8 bytes), final registers (8 bytes),
+//             cycles (2 bytes), number of cells (1 byte), number of bus
+//             accesses (1 byte), VECTOR_CELLS cells (4 bytes each) and
+//             VECTOR_ACCESSES accesses (4 bytes each), unused ones zeroed
+//     registers: pc (2 bytes), a, x, y, sp, p, and a zero byte
+//     cell: address (2 bytes), value before, value after
+//     access: address (2 bytes), value, kind (0 for reads, 1 for writes)
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "processor.h"
+
+#define VECTOR_MAGIC       "6502VECS"
+#define VECTOR_VERSION     1
+#define VECTOR_HEADER_SIZE 16
+#define VECTOR_CELLS       8   // most memory cells in a vector
+#define VECTOR_ACCESSES    8   // most bus accesses in a vector
+#define VECTOR_SIZE        (20 + 4 * VECTOR_CELLS + 4 * VECTOR_ACCESSES)
+
+// Kinds of bus accesses
+typedef enum : uint8_t {
+    ACCESS_READ = 0,
+    ACCESS_WRITE,
+} Access_kind;
+
+// Registers of the processor
+typedef struct {
+    uint16_t pc;
+    uint8_t acc, x, y, sp, status;
+} VectorRegisters;
+
+// Byte of memory, before and after the instruction runs
+typedef struct {
+    uint16_t addr;
+    uint8_t before, after;
+} VectorCell;
+
+// Access to the bus
+typedef struct {
+    uint16_t addr;
+    uint8_t data;
+    Access_kind kind;
+} VectorAccess;
+
+// Test vector for a single instruction
+typedef struct {
+    VectorRegisters initial, final;
+    uint16_t cycles;
+    uint8_t cells, accesses;
+    VectorCell cell[VECTOR_CELLS];
+    VectorAccess access[VECTOR_ACCESSES];
+} Vector;
+
+// What to check when running a vector; registers and memory always are
+typedef enum : uint8_t {
+    CHECK_CYCLES = (1 << 0), // the number of cycles taken
+    CHECK_BUS    = (1 << 1), // the bus accesses, in order
+} Vector_check;
+
+// Generate a vector for an opcode, from random initial registers and memory,
+// by running it on the reference core (processor_step with the default
+// features). The seed is advanced. Returns false if the instruction touched
+// too much memory to fit in a vector, which never happens with this core
+bool vector_generate(Vector *vector, uint8_t opcode, uint64_t *seed);
+
+// Run a vector on the given (initialized) processor, which is connected to a
+// bus with the memory of the vector. Everything but the registers and the bus
+// is left as it was, features included. Returns true if the vector passes
+bool vector_run(const Vector *vector, Processor *proc, uint8_t checks);
+
+// Run a vector like vector_run, printing what it expects and what the
+// processor did instead
+void vector_explain(FILE *out, const Vector *vector, Processor *proc);
+
+// Serialize a vector into a record and back
+void vector_encode(const Vector *vector, uint8_t record[VECTOR_SIZE]);
+void vector_decode(Vector *vector, const uint8_t record[VECTOR_SIZE]);
+
+// File of vectors, mapped into memory
+typedef struct {
+    const uint8_t *data; // start of the records
+    size_t count;        // number of records
+    void *map;           // whole mapping
+    size_t size;         // size of the mapping
+} VectorFile;
+
+// Open a file of vectors, checking its header. Returns false on failure
+bool vector_file_open(VectorFile *file, const char *path);
+
+// Close a file of vectors
+void vector_file_close(VectorFile *file);
+
+// Get a vector from a file
+void vector_file_get(const VectorFile *file, size_t index, Vector *vector);
+
+// Write vectors to a file. Returns false on failure
+bool vector_file_write(const char *path, const Vector *vectors, size_t count);
+
+#endif // LIBRE_6502_VECTORS_H
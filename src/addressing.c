@@ -101,12 +101,13 @@ uint16_t get_address(const Processor *proc) {
             addr |= proc->read(proc->u, (ptr + 1) & 0xFF) << 8;
             break;
         case MODE_INDIRECT_Y:
-            // The following byte contains a zero page address, which is to be
-            // added to the contents of the y register, with zero page wrap
-            // around, to get a pointer to the real absolute address
-            ptr = (proc->read(proc->u, proc->pc) + proc->x) & 0xFF;
+            // The following byte contains a zero page address, which holds a
+            // pointer to a base address. The contents of the y register are
+            // added to it to get the real absolute address
+            ptr = proc->read(proc->u, proc->pc);
             addr = proc->read(proc->u, ptr);
             addr |= proc->read(proc->u, (ptr + 1) & 0xFF) << 8;
+            addr += proc->y;
             break;
         default:
             // Should never ever happen
@@ -150,5 +151,7 @@ uint8_t get_data(const Processor *proc, uint16_t *address) {
 uint8_t get_inc(Mode mode) {
     if(mode <= MODE_ACCUMULATOR) return 0;
     if(mode <= MODE_RELATIVE) return 1;
+    // Indexed indirect modes take a single zero page byte as their operand
+    if(mode >= MODE_INDIRECT_X) return 1;
     return 2;
 }
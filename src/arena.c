@@ -0,0 +1,115 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "processor.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+// Preferred size of a slab; this is also the size of a huge page on most
+// hosts, which the kernel is asked to use for them when possible
+#define SLAB_SIZE (2 * 1024 * 1024)
+
+// Round a size up to a multiple of the given alignment (a power of two)
+#define ALIGN_UP(size, align) (((size) + (align) - 1) & ~((size_t) (align) - 1))
+
+// An arena is a set of slabs, each containing a number of slots. A slot holds
+// a processor followed by its RAM, both aligned to a cache line
+struct Arena {
+    size_t count;     // number of instances
+    size_t ram_size;  // amount of RAM of each instance
+    size_t slot_size; // size of a slot, processor and RAM included
+    size_t per_slab;  // number of slots in each slab
+    size_t slabs;     // number of slabs
+    uint8_t **slab;   // the slabs themselves
+};
+
+// Get the slot of an instance
+static inline uint8_t *slot(const Arena *arena, size_t index) {
+    return arena->slab[index / arena->per_slab]
+        + (index % arena->per_slab) * arena->slot_size;
+}
+
+// Create an arena with the given number of instances, each of them with the
+// given amount of RAM (which is zeroed). Returns NULL on allocation failure
+Arena *arena_create(size_t count, size_t ram_size) {
+    Arena *arena = calloc(1, sizeof(Arena));
+    if(arena == NULL) return NULL;
+    arena->count = count;
+    arena->ram_size = ram_size;
+    arena->slot_size = ALIGN_UP(sizeof(Processor), ARENA_ALIGN)
+        + ALIGN_UP(ram_size, ARENA_ALIGN);
+    arena->per_slab = SLAB_SIZE / arena->slot_size;
+    if(arena->per_slab == 0) arena->per_slab = 1; // huge instances
+    arena->slabs = (count + arena->per_slab - 1) / arena->per_slab;
+    arena->slab = calloc(arena->slabs ? arena->slabs : 1, sizeof(uint8_t *));
+    if(arena->slab == NULL) {
+        free(arena);
+        return NULL;
+    }
+    size_t slab_size = ALIGN_UP(arena->per_slab * arena->slot_size, SLAB_SIZE);
+    for(size_t i = 0; i < arena->slabs; ++i) {
+        arena->slab[i] = aligned_alloc(SLAB_SIZE, slab_size);
+        if(arena->slab[i] == NULL) {
+            arena_destroy(arena);
+            return NULL;
+        }
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        madvise(arena->slab[i], slab_size, MADV_HUGEPAGE); // just a hint
+#endif
+        memset(arena->slab[i], 0, slab_size);
+    }
+    return arena;
+}
+
+// Destroy an arena, freeing all of its instances at once
+void arena_destroy(Arena *arena) {
+    if(arena == NULL) return;
+    for(size_t i = 0; i < arena->slabs; ++i) free(arena->slab[i]);
+    free(arena->slab);
+    free(arena);
+}
+
+// Get the number of instances in an arena
+size_t arena_count(const Arena *arena) {
+    return arena->count;
+}
+
+// Get the processor of an instance
+Processor *arena_processor(const Arena *arena, size_t index) {
+    return (Processor *) slot(arena, index);
+}
+
+// Get the RAM of an instance
+uint8_t *arena_memory(const Arena *arena, size_t index) {
+    return slot(arena, index) + ALIGN_UP(sizeof(Processor), ARENA_ALIGN);
+}
+
+// Initialize the processors of all instances, connecting them to the given
+// address space functions. The userdata of each processor is its own RAM
+void arena_init(Arena *arena, AddrReader read, AddrWriter write) {
+    for(size_t i = 0; i < arena->count; ++i)
+        processor_init(arena_processor(arena, i), read, write,
+                arena_memory(arena, i));
+}
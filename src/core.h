@@ -0,0 +1,527 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Template for the core of the processor, the code that executes instructions.
+// It is included several times by processor.c, each time with CORE_FEATURES
+// set to a different Processor_feature bitmask, to produce cores that are
+// specialized for each combination of optional features. That way, a core
+// never pays for a feature it does not use, not even for checking if it is
+// enabled. Each inclusion defines core_step_N and core_run_N, N being the
+// value of CORE_FEATURES. No include guard, on purpose.
+
+#ifndef CORE_FEATURES
+#error "CORE_FEATURES must be defined before including core.h"
+#endif
+
+#define CORE_DECIMAL ((CORE_FEATURES) & 1)
+#define CORE_TRACE   ((CORE_FEATURES) >> 1 & 1)
+#define CORE_CYCLES  ((CORE_FEATURES) >> 2 & 1)
+#define CORE_RECORD  ((CORE_FEATURES) >> 3 & 1)
+
+// Record an instruction whose opcode was just fetched (see recorder.h). The
+// tracing cores, which are slow anyway, also serve processors that record,
+// checking for it as they go
+#if CORE_RECORD || CORE_TRACE
+#define CORE_RECORD_OP(proc, opcode) do { \
+    if(CORE_RECORD || ((proc)->features & FEATURE_RECORD)) \
+        recorder_put((proc)->recorder, RECORDER_PACK((proc)->pc - 1, opcode, \
+                (proc)->acc, (proc)->x, (proc)->y, (proc)->sp, \
+                (proc)->status)); \
+} while(0)
+#else
+#define CORE_RECORD_OP(proc, opcode) ((void) 0)
+#endif
+
+#define CORE_PASTE(name, n) name##n
+#define CORE_NAME(name, n) CORE_PASTE(name, n)
+
+// Run a single instruction, whose opcode has already been fetched
+static inline void CORE_NAME(core_exec_, CORE_FEATURES)(Processor *proc,
+        uint8_t opcode) {
+    // Decode the opcode (through the table filled by processor_init)
+    proc->opcode = opcode;
+    proc->inst = decode_table[opcode];
+
+    // Now execute it (with some auxiliary variables). Extra cycles taken due
+    // to page crossing or branching are accumulated in the penalty variable
+    uint16_t addr;
+    uint8_t data, aux, penalty = 0;
+    switch(proc->inst.op) {
+        // Load and store operations:
+        case LDA:
+            // LDA: load given data into the accumulator
+            proc->acc = read_data(proc, &penalty);
+            set_zn(proc, proc->acc);
+            break;
+        case LDX:
+            // LDX: load given data into the x register
+            proc->x = read_data(proc, &penalty);
+            set_zn(proc, proc->x);
+            break;
+        case LDY:
+            // LDY: load given data into the y register
+            proc->y = read_data(proc, &penalty);
+            set_zn(proc, proc->y);
+            break;
+        case STA:
+            // STA: store the contents of the accumulator into the given address
+            addr = get_address(proc);
+            proc->write(proc->u, addr, proc->acc);
+            break;
+        case STX:
+            // STX: store the contents of the x register into the given address
+            addr = get_address(proc);
+            proc->write(proc->u, addr, proc->x);
+            break;
+        case STY:
+            // STY: store the contents of the y register into the given address
+            addr = get_address(proc);
+            proc->write(proc->u, addr, proc->y);
+            break;
+        // Register transfer operations:
+        case TAX:
+            // TAX: copy the accumulator into the x register
+            proc->x = proc->acc;
+            set_zn(proc, proc->x);
+            break;
+        case TAY:
+            // TAY: copy the accumulator into the y register
+            proc->y = proc->acc;
+            set_zn(proc, proc->y);
+            break;
+        case TXA:
+            // TXA: copy the x register into the accumulator
+            proc->acc = proc->x;
+            set_zn(proc, proc->acc);
+            break;
+        case TYA:
+            // TYA: copy the y register into the accumulator
+            proc->acc = proc->y;
+            set_zn(proc, proc->acc);
+            break;
+        case TSX:
+            // TSX: copy the stack pointer into the x register
+            proc->x = proc->sp;
+            set_zn(proc, proc->x);
+            break;
+        case TXS:
+            // TXS: copy the x register into the stack pointer
+            proc->sp = proc->x;
+            break;
+        // Stack operations:
+        case PHA:
+            // PHA: push the accumulator on the stack
+            stack_push(proc, proc->acc);
+            break;
+        case PHP:
+            // PHP: push the status register on the stack, with the break flag
+            stack_push(proc, pushed_status(proc, true));
+            break;
+        case PLA:
+            // PLA: pull a byte from the stack and put it in the accumulator
+            proc->acc = stack_pull(proc);
+            set_zn(proc, proc->acc);
+            break;
+        case PLP:
+            // PLP: pull a byte from the stack and put it in the status register
+            proc->status = pulled_status(proc, stack_pull(proc));
+            break;
+        // Logic operations:
+        case AND:
+            // AND: bitwise AND data into the accumulator
+            proc->acc &= read_data(proc, &penalty);
+            set_zn(proc, proc->acc);
+            break;
+        case EOR:
+            // EOR: bitwise XOR data into the accumulator
+            proc->acc ^= read_data(proc, &penalty);
+            set_zn(proc, proc->acc);
+            break;
+        case ORA:
+            // ORA: bitwise OR data into the accumulator
+            proc->acc |= read_data(proc, &penalty);
+            set_zn(proc, proc->acc);
+            break;
+        case BIT:
+            // BIT: bitwise AND data with the accumulator, but the result isn't
+            // kept. It is instead used to set the zero flag, while the overflow
+            // and negative flags are copied from bits 6 and 7 of the data
+            data = get_data(proc, NULL);
+            set_flag(proc, FLAG_ZERO, (data & proc->acc) == 0);
+            set_flag(proc, FLAG_OVERFLOW, data & 0x40);
+            set_flag(proc, FLAG_NEGATIVE, data & 0x80);
+            break;
+        // Arithmetic instructions:
+        case ADC:
+            // ADC: Add the given data and the carry flag to the accumulator.
+            // Variants without decimal mode (such as the 2A03) ignore the flag
+            data = read_data(proc, &penalty);
+            if(CORE_DECIMAL && (proc->status & FLAG_DECIMAL))
+                processor_decimal_add(proc, data);
+            else processor_add(proc, data);
+            break;
+        case SBC:
+            // SBC: subtract the given data and the negation of the carry flag (which
+            // represents a borrow) from the accumulator
+            data = read_data(proc, &penalty);
+            if(CORE_DECIMAL && (proc->status & FLAG_DECIMAL))
+                processor_decimal_sub(proc, data);
+            else processor_sub(proc, data);
+            break;
+        case CMP:
+            // CMP: compare the contents of the accumulator and the given data,
+            // setting the appropriate flags in the status register
+            compare(proc, proc->acc, read_data(proc, &penalty));
+            break;
+        case CPX:
+            // CPX: compare the contents of the x register and the given data,
+            // setting the appropriate flags in the status register
+            compare(proc, proc->x, get_data(proc, NULL));
+            break;
+        case CPY:
+            // CPY: compare the contents of the y register and the given data,
+            // setting the appropriate flags in the status register
+            compare(proc, proc->y, get_data(proc, NULL));
+            break;
+        // Increment operations:
+        case INC:
+            // INC: increment the memory location at the given address
+            data = get_data(proc, &addr);
+            proc->write(proc->u, addr, data + 1);
+            set_zn(proc, data + 1);
+            break;
+        case INX:
+            // INX: increment the x register
+            set_zn(proc, ++proc->x);
+            break;
+        case INY:
+            // INY: increment the y register
+            set_zn(proc, ++proc->y);
+            break;
+        // Decrement operations:
+        case DEC:
+            // DEC: decrement the memory location at the given address
+            data = get_data(proc, &addr);
+            proc->write(proc->u, addr, data - 1);
+            set_zn(proc, data - 1);
+            break;
+        case DEX:
+            // DEX: decrement the x register
+            set_zn(proc, --proc->x);
+            break;
+        case DEY:
+            // DEY: decrement the y register
+            set_zn(proc, --proc->y);
+            break;
+        // Shift operations:
+        case ASL:
+            // ASL: arithmetic left shift of the memory location at the given
+            // address or the accumulator, depending on the addressing mode
+            data = get_data(proc, &addr);
+            set_flag(proc, FLAG_CARRY, data & 0x80);
+            data <<= 1;
+            set_zn(proc, data);
+            if(proc->inst.mode != MODE_ACCUMULATOR)
+                proc->write(proc->u, addr, data);
+            else
+                proc->acc = data;
+            break;
+        case LSR:
+            // LSR: logical right shift of the memory location at the given
+            // address or the accumulator, depending on the addressing mode
+            data = get_data(proc, &addr);
+            set_flag(proc, FLAG_CARRY, data & 0x01);
+            data >>= 1;
+            set_zn(proc, data);
+            if(proc->inst.mode != MODE_ACCUMULATOR)
+                proc->write(proc->u, addr, data);
+            else
+                proc->acc = data;
+            break;
+        case ROL:
+            // ROL: rotate to the left the memory location at the given address
+            // or the accumulator, depending on the addressing mode
+            data = get_data(proc, &addr);
+            aux = data & 0x80; // leftmost bit (7), to be put in the carry flag
+            data <<= 1;
+            // The rightmost bit (0) is filled with the current carry flag
+            data |= proc->status & FLAG_CARRY;
+            set_flag(proc, FLAG_CARRY, aux);
+            set_zn(proc, data);
+            if(proc->inst.mode != MODE_ACCUMULATOR)
+                proc->write(proc->u, addr, data);
+            else
+                proc->acc = data;
+            break;
+        case ROR:
+            // ROR: rotate to the right the memory location at the given
+            // address or the accumulator, depending on the addressing mode
+            data = get_data(proc, &addr);
+            aux = data & 0x01; // rightmost bit (0), to be put in the carry flag
+            data >>= 1;
+            // The leftmost bit (7) is filled with the current carry flag
+            data |= (proc->status & FLAG_CARRY) << 7;
+            set_flag(proc, FLAG_CARRY, aux);
+            set_zn(proc, data);
+            if(proc->inst.mode != MODE_ACCUMULATOR)
+                proc->write(proc->u, addr, data);
+            else
+                proc->acc = data;
+            break;
+        // Jump operations:
+        case JMP:
+            // JMP: unconditional jump to the given address
+            proc->pc = get_address(proc);
+            cover(proc, proc->pc);
+            goto jumped;
+        case JSR:
+            // JSR: jump to subroutine. It pushes the address of the last byte of
+            // the instruction to the stack and then does an unconditional jump
+            // to the given address. This way, a future RTS can return to the
+            // calling code
+            addr = get_address(proc);
+            stack_push16(proc, proc->pc + 1);
+            proc->pc = addr;
+            cover(proc, proc->pc);
+            goto jumped;
+        case RTS:
+            // RTS: return from subroutine. It pulls a 16-bit address from the
+            // stack and puts the one after it into the PC, thus returning to
+            // the calling code
+            proc->pc = stack_pull16(proc) + 1;
+            cover(proc, proc->pc);
+            break;
+        // Branch operations:
+        case BEQ:
+            // BEQ: branch if equal (zero flag is set)
+            penalty = branch(proc, proc->status & FLAG_ZERO);
+            break;
+        case BNE:
+            // BNE: branch if not equal (zero flag is clear)
+            penalty = branch(proc, !(proc->status & FLAG_ZERO));
+            break;
+        case BCS:
+            // BCS: branch if carry is set
+            penalty = branch(proc, proc->status & FLAG_CARRY);
+            break;
+        case BCC:
+            // BCC: branch if carry is clear
+            penalty = branch(proc, !(proc->status & FLAG_CARRY));
+            break;
+        case BMI:
+            // BCS: branch if negative (negative flag is set)
+            penalty = branch(proc, proc->status & FLAG_NEGATIVE);
+            break;
+        case BPL:
+            // BPL: branch if positive (negative flag is clear)
+            penalty = branch(proc, !(proc->status & FLAG_NEGATIVE));
+            break;
+        case BVS:
+            // BVS: branch if an overflow happened (overflow flag is set)
+            penalty = branch(proc, proc->status & FLAG_OVERFLOW);
+            break;
+        case BVC:
+            // BVC: branch if no overflow happened (overflow flag is clear)
+            penalty = branch(proc, !(proc->status & FLAG_OVERFLOW));
+            break;
+        // Flag operations:
+        case SEC:
+            // SEC: set carry flag
+            proc->status |= FLAG_CARRY;
+            break;
+        case SEI:
+            // SEI: set interrupt disable flag
+            proc->status |= FLAG_IRQ_DIS;
+            break;
+        case SED:
+            // SED: set decimal flag (BCD arithmetic)
+            proc->status |= FLAG_DECIMAL;
+            break;
+        case CLC:
+            // CLC: clear carry flag
+            proc->status &= ~FLAG_CARRY;
+            break;
+        case CLI:
+            // CLI: clear interrupt disable flag
+            proc->status &= ~FLAG_IRQ_DIS;
+            break;
+        case CLD:
+            // CLD: clear decimal flag (binary arithmetic)
+            proc->status &= ~FLAG_DECIMAL;
+            break;
+        case CLV:
+            // CLV: clear overflow flag
+            proc->status &= ~FLAG_OVERFLOW;
+            break;
+
+        // System/symbolic operations:
+        case BRK:
+            // BRK: force an interrupt (IRQ) even if they are disabled, setting
+            // the break flag on the pushed status. The byte after the opcode is
+            // skipped, so that it can be used as an argument to the handler
+            ++proc->pc;
+            interrupt(proc, IRQ_VECTOR, true);
+            break;
+        case NOP:
+            // NOP: do nothing
+            break;
+        case RTI:
+            // RTI: return from an interrupt handler
+            proc->status = pulled_status(proc, stack_pull(proc));
+            proc->pc = stack_pull16(proc);
+            cover(proc, proc->pc);
+            break;
+        case ERR:
+            // ERR: this represents an invalid opcode. In the real hardware,
+            // this would cause undefined behavior; this allows to just do
+            // nothing without much of an issue (I think)
+#if CORE_RECORD || CORE_TRACE
+            if(CORE_RECORD || (proc->features & FEATURE_RECORD))
+                recorder_halt(proc);
+#endif
+            break;
+    }
+    proc->pc += get_inc(proc->inst.mode); // advance to the next instruction
+jumped: // jumps leave the PC on their target
+#if CORE_CYCLES
+    proc->cycles += cycle_table[opcode] + penalty;
+#else
+    (void) penalty;
+#endif
+}
+
+// Run the second instruction of a fused pair (see fusion.h), whose opcode has
+// already been fetched. Every opcode in fusion_second has a handler here that
+// does exactly what the generic code does, minus the decoding and addressing
+// logic; the rest of them just go through the generic code
+static inline void CORE_NAME(core_fused_, CORE_FEATURES)(Processor *proc,
+        uint8_t opcode) {
+    uint8_t data, penalty = 0;
+    proc->opcode = opcode;
+    proc->inst = decode_table[opcode];
+    switch(opcode) {
+        case 0xD0: // bne
+            penalty = fused_branch(proc, !(proc->status & FLAG_ZERO));
+            break;
+        case 0xF0: // beq
+            penalty = fused_branch(proc, proc->status & FLAG_ZERO);
+            break;
+        case 0x10: // bpl
+            penalty = fused_branch(proc, !(proc->status & FLAG_NEGATIVE));
+            break;
+        case 0x69: // adc #imm
+            data = fused_byte(proc);
+            if(CORE_DECIMAL && (proc->status & FLAG_DECIMAL))
+                processor_decimal_add(proc, data);
+            else processor_add(proc, data);
+            break;
+        case 0xE9: // sbc #imm
+            data = fused_byte(proc);
+            if(CORE_DECIMAL && (proc->status & FLAG_DECIMAL))
+                processor_decimal_sub(proc, data);
+            else processor_sub(proc, data);
+            break;
+        case 0x85: // sta zpg
+            data = fused_byte(proc);
+            proc->write(proc->u, data, proc->acc);
+            break;
+        case 0x8D: // sta abs
+            proc->write(proc->u, fused_word(proc), proc->acc);
+            break;
+        case 0x9D: // sta abs,x
+            proc->write(proc->u, fused_word(proc) + proc->x, proc->acc);
+            break;
+        case 0x91: // sta (zpg),y
+            proc->write(proc->u, fused_indirect_y(proc), proc->acc);
+            break;
+        case 0xE8: // inx
+            set_zn(proc, ++proc->x);
+            break;
+        case 0xC8: // iny
+            set_zn(proc, ++proc->y);
+            break;
+        default:
+            CORE_NAME(core_exec_, CORE_FEATURES)(proc, opcode);
+            return;
+    }
+#if CORE_CYCLES
+    proc->cycles += cycle_table[opcode] + penalty;
+#else
+    (void) penalty;
+#endif
+}
+
+// Run a single instruction as a discrete step
+static void CORE_NAME(core_step_, CORE_FEATURES)(Processor *proc) {
+#if CORE_TRACE
+    if(proc->trace != NULL) proc->trace(proc->u, proc);
+#endif
+    uint8_t opcode = proc->read(proc->u, proc->pc++);
+    CORE_RECORD_OP(proc, opcode);
+    CORE_NAME(core_exec_, CORE_FEATURES)(proc, opcode);
+}
+
+// Run a number of instructions in a row, without going through the core
+// selection for each one of them. Unless tracing, after each instruction that
+// starts an enabled pair, the next opcode is fetched right away and, if it
+// completes the pair, run by its fused handler; this goes on for as long as
+// the pairs chain and the count allows. Also unless tracing, block copy and
+// fill loops over address spaces are run natively when recognized
+static uint32_t CORE_NAME(core_run_, CORE_FEATURES)(Processor *proc,
+        uint32_t count) {
+    uint32_t i = 0;
+    while(i < count) {
+#if CORE_TRACE
+        if(proc->trace != NULL) proc->trace(proc->u, proc);
+#endif
+        uint8_t opcode = proc->read(proc->u, proc->pc++);
+        CORE_RECORD_OP(proc, opcode);
+        CORE_NAME(core_exec_, CORE_FEATURES)(proc, opcode);
+        ++i;
+#if !CORE_TRACE
+        while(i < count && (proc->fusion & fusion_first[opcode])) {
+            uint8_t next = proc->read(proc->u, proc->pc++);
+            CORE_RECORD_OP(proc, next);
+            if(proc->fusion & fusion_first[opcode] & fusion_second[next])
+                CORE_NAME(core_fused_, CORE_FEATURES)(proc, next);
+            else CORE_NAME(core_exec_, CORE_FEATURES)(proc, next);
+            opcode = next;
+            ++i;
+        }
+#if !CORE_RECORD
+        // Block copy and fill loops start over after a BNE (see idiom.h).
+        // The recorder is to see every instruction, so it goes without them
+        if(opcode == 0xD0 && proc->write == space_write && i < count)
+            i += idiom_run(proc, count - i);
+#endif
+#endif
+        // Calls from the host end at the matching RTS (see processor_call)
+        if(opcode == 0x60 && proc->sp == proc->call_sp
+                && proc->pc == proc->call_pc) break;
+    }
+    return i;
+}
+
+#undef CORE_NAME
+#undef CORE_PASTE
+#undef CORE_RECORD_OP
+#undef CORE_RECORD
+#undef CORE_CYCLES
+#undef CORE_TRACE
+#undef CORE_DECIMAL
+#undef CORE_FEATURES
@@ -0,0 +1,85 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <sys/shm.h>
+
+#include "coverage.h"
+#include "processor.h"
+
+// Initialize edge coverage over a bitmap of the given size
+bool coverage_init(Coverage *cov, uint8_t *map, size_t size) {
+    *cov = (Coverage) { 0 };
+    if(size == 0 || (size & (size - 1)) != 0 || size > UINT32_MAX)
+        return false;
+    if(map == NULL) {
+        map = calloc(size, 1);
+        if(map == NULL) return false;
+        cov->owned = true;
+    }
+    cov->map = map;
+    cov->mask = size - 1;
+    return true;
+}
+
+// Initialize edge coverage over the shared memory of AFL. Its size is given
+// by AFL_MAP_SIZE, when it is not the usual one
+bool coverage_init_afl(Coverage *cov) {
+    *cov = (Coverage) { 0 };
+    const char *id = getenv("__AFL_SHM_ID");
+    if(id == NULL) return false;
+    const char *env = getenv("AFL_MAP_SIZE");
+    size_t size = env != NULL ? strtoul(env, NULL, 0) : COVERAGE_SIZE;
+    void *map = shmat(atoi(id), NULL, 0);
+    if(map == (void *) -1) return false;
+    if(!coverage_init(cov, map, size)) {
+        shmdt(map);
+        return false;
+    }
+    cov->shared = true;
+    return true;
+}
+
+// Release the bitmap, or detach from the shared memory of AFL
+void coverage_free(Coverage *cov) {
+    if(cov->owned) free(cov->map);
+    if(cov->shared) shmdt(cov->map);
+    cov->map = NULL;
+}
+
+// Attach coverage to a processor
+void coverage_attach(Coverage *cov, Processor *proc) {
+    proc->coverage = cov;
+}
+
+// Clear the bitmap and forget the previous location
+void coverage_reset(Coverage *cov) {
+    memset(cov->map, 0, (size_t) cov->mask + 1);
+    cov->prev = 0;
+}
+
+// Get the number of edges that were hit
+size_t coverage_count(const Coverage *cov) {
+    size_t count = 0;
+    for(size_t i = 0; i <= cov->mask; ++i) count += cov->map[i] != 0;
+    return count;
+}
@@ -40,6 +40,17 @@ static const char *op_text[] = {
     [RTI] = "rti", [ERR] = "<invalid opcode>",
 };
 
+// Names of the addressing modes
+static const char *mode_text[] = {
+    [MODE_IMPLIED]     = "implied"     , [MODE_ACCUMULATOR] = "accumulator" ,
+    [MODE_IMMEDIATE]   = "immediate"   , [MODE_ZEROPAGE]    = "zeropage"    ,
+    [MODE_ZEROPAGE_X]  = "zeropage,x"  , [MODE_ZEROPAGE_Y]  = "zeropage,y"  ,
+    [MODE_RELATIVE]    = "relative"    , [MODE_ABSOLUTE]    = "absolute"    ,
+    [MODE_ABSOLUTE_X]  = "absolute,x"  , [MODE_ABSOLUTE_Y]  = "absolute,y"  ,
+    [MODE_INDIRECT]    = "indirect"    , [MODE_INDIRECT_X]  = "(indirect,x)",
+    [MODE_INDIRECT_Y]  = "(indirect),y",
+};
+
 // Format string table for addressing modes
 static const char *arg_format[] = {
     [MODE_IMMEDIATE]  = " #%d"       ,
@@ -55,6 +66,16 @@ static const char *arg_format[] = {
     [MODE_INDIRECT_Y] = " ($%02X),Y" ,
 };
 
+// Get the mnemonic of an operation
+const char *operation_name(Operation op) {
+    return op_text[op];
+}
+
+// Get the name of an addressing mode
+const char *mode_name(Mode mode) {
+    return mode_text[mode];
+}
+
 // Read code from the given addressing space (provided via the userdata and
 // read parameters) at the given address and with the given length,
 // decoding and disassembling it to the given file
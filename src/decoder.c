@@ -16,10 +16,14 @@
    libre-6502. If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 #include <stdbool.h>
+#include <pthread.h>
 
 #include "definitions.h"
+#include "addressing.h"
 #include "decoder.h"
 
 // The decoding logic found here was heavily guided by the following resource:
@@ -200,3 +204,44 @@ Instruction decode(uint8_t opcode) {
 }
 
 #undef error_if
+
+// Decoded form and instruction length of every opcode, filled on the first
+// call to decode_tables_init
+Instruction decode_table[256];
+uint8_t decode_length[256];
+static pthread_once_t decode_once = PTHREAD_ONCE_INIT;
+
+static void fill_tables(void) {
+    for(int opcode = 0; opcode < 256; ++opcode) {
+        decode_table[opcode] = decode(opcode);
+        decode_length[opcode] = 1 + get_inc(decode_table[opcode].mode);
+    }
+}
+
+// Fill the tables of decoded opcodes, once
+void decode_tables_init(void) {
+    pthread_once(&decode_once, fill_tables);
+}
+
+// Decode every byte of a buffer of machine code as an opcode, in bulk
+void decode_buffer(const uint8_t *code, size_t n, Instruction *out,
+        uint8_t *lengths) {
+    decode_tables_init();
+    // Separate passes keep each loop down to a load and a store per byte
+    if(out != NULL)
+        for(size_t i = 0; i < n; ++i) out[i] = decode_table[code[i]];
+    if(lengths != NULL)
+        for(size_t i = 0; i < n; ++i) lengths[i] = decode_length[code[i]];
+}
+
+// Find where the instructions of a buffer of machine code start
+size_t decode_sweep(const uint8_t *code, size_t n, uint8_t *starts) {
+    decode_tables_init();
+    memset(starts, 0, n);
+    size_t count = 0;
+    for(size_t i = 0; i < n; i += decode_length[code[i]]) {
+        starts[i] = 1;
+        ++count;
+    }
+    return count;
+}
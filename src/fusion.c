@@ -0,0 +1,122 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "fusion.h"
+#include "processor.h"
+
+// Opcodes making up each supported pair
+const struct FusionOpcodes fusion_opcodes[FUSION_PAIRS] = {
+    [FUSE_CMP_IMM_BNE] = { 0xC9, 0xD0 },
+    [FUSE_CMP_IMM_BEQ] = { 0xC9, 0xF0 },
+    [FUSE_CMP_ZPG_BNE] = { 0xC5, 0xD0 },
+    [FUSE_CPX_IMM_BNE] = { 0xE0, 0xD0 },
+    [FUSE_CPY_IMM_BNE] = { 0xC0, 0xD0 },
+    [FUSE_DEX_BNE]     = { 0xCA, 0xD0 },
+    [FUSE_DEY_BNE]     = { 0x88, 0xD0 },
+    [FUSE_INX_BNE]     = { 0xE8, 0xD0 },
+    [FUSE_INY_BNE]     = { 0xC8, 0xD0 },
+    [FUSE_DEX_BPL]     = { 0xCA, 0x10 },
+    [FUSE_DEY_BPL]     = { 0x88, 0x10 },
+    [FUSE_CLC_ADC]     = { 0x18, 0x69 },
+    [FUSE_SEC_SBC]     = { 0x38, 0xE9 },
+    [FUSE_LDA_STA_ZPG] = { 0xA5, 0x85 },
+    [FUSE_LDA_STA_ABS] = { 0xAD, 0x8D },
+    [FUSE_LDA_STA_ABX] = { 0xBD, 0x9D },
+    [FUSE_LDA_STA_IDY] = { 0xB1, 0x91 },
+    [FUSE_STA_ABX_INX] = { 0x9D, 0xE8 },
+    [FUSE_STA_IDY_INY] = { 0x91, 0xC8 },
+    [FUSE_LDA_IMM_ZPG] = { 0xA9, 0x85 },
+    [FUSE_LDA_IMM_ABS] = { 0xA9, 0x8D },
+};
+
+// Sets of pairs that start with each opcode
+const uint32_t fusion_first[256] = {
+    [0xC9] = FUSION_BIT(FUSE_CMP_IMM_BNE) | FUSION_BIT(FUSE_CMP_IMM_BEQ),
+    [0xC5] = FUSION_BIT(FUSE_CMP_ZPG_BNE),
+    [0xE0] = FUSION_BIT(FUSE_CPX_IMM_BNE),
+    [0xC0] = FUSION_BIT(FUSE_CPY_IMM_BNE),
+    [0xCA] = FUSION_BIT(FUSE_DEX_BNE) | FUSION_BIT(FUSE_DEX_BPL),
+    [0x88] = FUSION_BIT(FUSE_DEY_BNE) | FUSION_BIT(FUSE_DEY_BPL),
+    [0xE8] = FUSION_BIT(FUSE_INX_BNE),
+    [0xC8] = FUSION_BIT(FUSE_INY_BNE),
+    [0x18] = FUSION_BIT(FUSE_CLC_ADC),
+    [0x38] = FUSION_BIT(FUSE_SEC_SBC),
+    [0xA5] = FUSION_BIT(FUSE_LDA_STA_ZPG),
+    [0xAD] = FUSION_BIT(FUSE_LDA_STA_ABS),
+    [0xBD] = FUSION_BIT(FUSE_LDA_STA_ABX),
+    [0xB1] = FUSION_BIT(FUSE_LDA_STA_IDY),
+    [0x9D] = FUSION_BIT(FUSE_STA_ABX_INX),
+    [0x91] = FUSION_BIT(FUSE_STA_IDY_INY),
+    [0xA9] = FUSION_BIT(FUSE_LDA_IMM_ZPG) | FUSION_BIT(FUSE_LDA_IMM_ABS),
+};
+
+// Sets of pairs that end in each opcode; the core has a specialized handler
+// for each of these opcodes
+const uint32_t fusion_second[256] = {
+    [0xD0] = FUSION_BIT(FUSE_CMP_IMM_BNE) | FUSION_BIT(FUSE_CMP_ZPG_BNE)
+        | FUSION_BIT(FUSE_CPX_IMM_BNE) | FUSION_BIT(FUSE_CPY_IMM_BNE)
+        | FUSION_BIT(FUSE_DEX_BNE) | FUSION_BIT(FUSE_DEY_BNE)
+        | FUSION_BIT(FUSE_INX_BNE) | FUSION_BIT(FUSE_INY_BNE),
+    [0xF0] = FUSION_BIT(FUSE_CMP_IMM_BEQ),
+    [0x10] = FUSION_BIT(FUSE_DEX_BPL) | FUSION_BIT(FUSE_DEY_BPL),
+    [0x69] = FUSION_BIT(FUSE_CLC_ADC),
+    [0xE9] = FUSION_BIT(FUSE_SEC_SBC),
+    [0x85] = FUSION_BIT(FUSE_LDA_STA_ZPG) | FUSION_BIT(FUSE_LDA_IMM_ZPG),
+    [0x8D] = FUSION_BIT(FUSE_LDA_STA_ABS) | FUSION_BIT(FUSE_LDA_IMM_ABS),
+    [0x9D] = FUSION_BIT(FUSE_LDA_STA_ABX),
+    [0x91] = FUSION_BIT(FUSE_LDA_STA_IDY),
+    [0xE8] = FUSION_BIT(FUSE_STA_ABX_INX),
+    [0xC8] = FUSION_BIT(FUSE_STA_IDY_INY),
+};
+
+// Initialize (or clear) a profile
+void fusion_profile_init(FusionProfile *profile) {
+    memset(profile, 0, sizeof(FusionProfile));
+}
+
+// Run the given number of instructions, one step at a time, recording the
+// pairs of opcodes that got executed. Returns how many were run
+uint32_t fusion_profile(FusionProfile *profile, Processor *proc,
+        uint32_t count) {
+    for(uint32_t i = 0; i < count; ++i) {
+        processor_step(proc);
+        if(profile->started) {
+            ++profile->count[profile->last][proc->opcode];
+            ++profile->total;
+        }
+        profile->last = proc->opcode;
+        profile->started = true;
+    }
+    return count;
+}
+
+// Pick the supported pairs that make up at least the given share (between 0
+// and 1) of all the pairs in a profile
+uint32_t fusion_select(const FusionProfile *profile, double share) {
+    uint32_t pairs = 0;
+    if(profile->total == 0) return pairs;
+    for(int i = 0; i < FUSION_PAIRS; ++i) {
+        uint32_t n = profile->count[fusion_opcodes[i].first]
+            [fusion_opcodes[i].second];
+        if(n > 0 && n >= share * profile->total) pairs |= FUSION_BIT(i);
+    }
+    return pairs;
+}
@@ -0,0 +1,80 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "hash.h"
+#include "space.h"
+#include "processor.h"
+
+// Finalizer of MurmurHash3, which scrambles all the bits of a 64-bit value
+static inline uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Hash a page of an address space. The page number and the way the page is
+// mapped are part of the hash, so that equal contents in different places (or
+// in a ROM instead of RAM) do not cancel each other out. Unmapped pages
+// belong to the host and their contents are not known
+static uint64_t hash_page(const AddressSpace *space, uint8_t index) {
+    uint64_t h = mix((uint64_t) index << 8 | space->kind[index]);
+    const uint8_t *data = space->rmap[index];
+    if(data == NULL) return h;
+    for(size_t i = 0; i < SPACE_PAGE_SIZE; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        h = mix(h ^ word) + i;
+    }
+    return h;
+}
+
+// Initialize a running hash. The first query will hash every page
+void state_hash_init(StateHash *hash, AddressSpace *space) {
+    memset(hash, 0, sizeof(StateHash));
+    memset(space->dirty, 0xFF, sizeof(space->dirty));
+}
+
+// Get the digest of the current state of a machine, rehashing dirty pages
+uint64_t state_hash(StateHash *hash, AddressSpace *space,
+        const Processor *proc) {
+    for(size_t w = 0; w < SPACE_PAGES / 64; ++w) {
+        uint64_t dirty = space->dirty[w];
+        space->dirty[w] = 0;
+        while(dirty != 0) {
+            uint8_t index = w * 64 + __builtin_ctzll(dirty);
+            dirty &= dirty - 1;
+            // Page hashes are combined with XOR, so the old one is removed
+            // simply by combining it again
+            uint64_t h = hash_page(space, index);
+            hash->memory ^= hash->page[index] ^ h;
+            hash->page[index] = h;
+        }
+    }
+    uint64_t regs = (uint64_t) proc->pc << 40 | (uint64_t) proc->acc << 32
+        | (uint64_t) proc->x << 24 | (uint64_t) proc->y << 16
+        | (uint64_t) proc->sp << 8 | proc->status;
+    // The cycle count is only meaningful if the processor keeps it
+    uint64_t cycles = proc->features & FEATURE_CYCLES ? proc->cycles : 0;
+    return mix(mix(hash->memory ^ regs) ^ cycles);
+}
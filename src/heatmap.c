@@ -0,0 +1,210 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "heatmap.h"
+#include "debug.h"
+#include "space.h"
+#include "decoder.h"
+#include "processor.h"
+#include "definitions.h"
+
+#define ADDRESSES 0x10000u
+
+static const char *access_name[HEATMAP_ACCESSES] = {
+    [HEATMAP_FETCH] = "fetch", [HEATMAP_READ] = "read",
+    [HEATMAP_WRITE] = "write",
+};
+
+// Initialize a heatmap with blocks of 1 << shift addresses
+bool heatmap_init(Heatmap *map, uint8_t shift) {
+    *map = (Heatmap) { .shift = shift };
+    if(shift > 8) return false;
+    map->counts = calloc(ADDRESSES >> shift, sizeof(*map->counts));
+    return map->counts != NULL;
+}
+
+// Free the counters of a heatmap
+void heatmap_free(Heatmap *map) {
+    free(map->counts);
+    map->counts = NULL;
+}
+
+// Reads, classified as they go through the bus
+static uint8_t heatmap_read(void *userdata, uint16_t addr) {
+    Heatmap *map = userdata;
+    uint8_t data = map->read(map->u, addr);
+    Heatmap_access access = HEATMAP_READ;
+    if(map->opcode) {
+        map->mode = decode_table[data].mode;
+        map->operands = decode_length[data] - 1;
+        map->operand = addr + 1;
+        map->opcode = false;
+        access = HEATMAP_FETCH;
+    } else if(map->operands > 0 && addr == map->operand) {
+        --map->operands;
+        ++map->operand;
+        access = HEATMAP_FETCH;
+    }
+    ++map->counts[addr >> map->shift][access][map->mode];
+    return data;
+}
+
+static void heatmap_write(void *userdata, uint16_t addr, uint8_t data) {
+    Heatmap *map = userdata;
+    ++map->counts[addr >> map->shift][HEATMAP_WRITE][map->mode];
+    map->write(map->u, addr, data);
+}
+
+// Called before each instruction. The trace hook that was already set gets
+// the processor with its own bus, so that whatever it reads is not counted
+static void heatmap_trace(void *userdata, const Processor *proc) {
+    Heatmap *map = userdata;
+    if(map->trace != NULL) {
+        Processor *p = map->proc;
+        p->read = map->read;
+        p->write = map->write;
+        p->u = map->u;
+        map->trace(map->u, proc);
+        p->read = heatmap_read;
+        p->write = heatmap_write;
+        p->u = map;
+    }
+    map->opcode = true;
+    map->operands = 0;
+}
+
+// Attach a heatmap to a processor
+bool heatmap_attach(Heatmap *map, Processor *proc) {
+    decode_tables_init(); // opcode fetches are decoded through them
+    map->proc = proc;
+    map->read = proc->read;
+    map->write = proc->write;
+    map->u = proc->u;
+    map->trace = proc->trace;
+    map->features = proc->features;
+    map->mode = MODE_IMPLIED;
+    map->opcode = false;
+    map->operands = 0;
+    proc->read = heatmap_read;
+    proc->write = heatmap_write;
+    proc->u = map;
+    proc->trace = heatmap_trace;
+    uint8_t features = proc->features | FEATURE_TRACE;
+    if(processor_set_features(proc, features) == features) return true;
+    heatmap_detach(map);
+    return false;
+}
+
+// Detach a heatmap from its processor
+void heatmap_detach(Heatmap *map) {
+    Processor *proc = map->proc;
+    proc->read = map->read;
+    proc->write = map->write;
+    proc->u = map->u;
+    proc->trace = map->trace;
+    processor_set_features(proc, (proc->features & ~FEATURE_TRACE)
+            | (map->features & FEATURE_TRACE));
+    map->proc = NULL;
+}
+
+// Clear the counters of a heatmap
+void heatmap_reset(Heatmap *map) {
+    memset(map->counts, 0, (ADDRESSES >> map->shift) * sizeof(*map->counts));
+}
+
+// Get the number of accesses of a kind to the block of an address, in a mode
+uint64_t heatmap_get(const Heatmap *map, uint16_t addr, Heatmap_access access,
+        Mode mode) {
+    return map->counts[addr >> map->shift][access][mode];
+}
+
+// Get the number of accesses of a kind to the block of an address
+uint64_t heatmap_total(const Heatmap *map, uint16_t addr,
+        Heatmap_access access) {
+    uint64_t total = 0;
+    for(int mode = 0; mode < HEATMAP_MODES; ++mode)
+        total += map->counts[addr >> map->shift][access][mode];
+    return total;
+}
+
+// Write the counters that are not zero as CSV
+void heatmap_write_csv(const Heatmap *map, FILE *out) {
+    fprintf(out, "address,access,mode,count\n");
+    for(uint32_t block = 0; block < ADDRESSES >> map->shift; ++block)
+        for(int access = 0; access < HEATMAP_ACCESSES; ++access)
+            for(int mode = 0; mode < HEATMAP_MODES; ++mode) {
+                uint64_t count = map->counts[block][access][mode];
+                if(count == 0) continue;
+                // The names of the modes have commas
+                fprintf(out, "$%04X,%s,\"%s\",%lu\n", block << map->shift,
+                        access_name[access], mode_name(mode),
+                        (unsigned long) count);
+            }
+}
+
+// Block of addresses in the ranking of I/O
+typedef struct {
+    uint32_t block;
+    uint64_t reads, writes;
+} Hot;
+
+static int compare_hot(const void *a, const void *b) {
+    const Hot *x = a, *y = b;
+    uint64_t tx = x->reads + x->writes, ty = y->reads + y->writes;
+    if(tx != ty) return tx < ty ? 1 : -1;
+    return x->block < y->block ? -1 : x->block > y->block;
+}
+
+// Write a ranking of the blocks of I/O addresses with the most accesses
+void heatmap_write_report(const Heatmap *map, FILE *out, size_t top) {
+    uint32_t blocks = ADDRESSES >> map->shift;
+    Hot *hot = malloc(blocks * sizeof(Hot));
+    if(hot == NULL) return;
+    const AddressSpace *space = map->read == space_read ? map->u : NULL;
+    size_t count = 0;
+    for(uint32_t block = 0; block < blocks; ++block) {
+        uint16_t addr = block << map->shift;
+        if(space != NULL && space->kind[PAGE_OF(addr)] != MAP_IO) continue;
+        Hot h = { block, heatmap_total(map, addr, HEATMAP_READ),
+            heatmap_total(map, addr, HEATMAP_WRITE) };
+        if(h.reads + h.writes > 0) hot[count++] = h;
+    }
+    qsort(hot, count, sizeof(Hot), compare_hot);
+
+    for(size_t i = 0; i < count && i < top; ++i) {
+        // Mode in which the block is accessed the most
+        uint64_t (*c)[HEATMAP_MODES] = map->counts[hot[i].block];
+        int mostly = 0;
+        for(int mode = 1; mode < HEATMAP_MODES; ++mode)
+            if(c[HEATMAP_READ][mode] + c[HEATMAP_WRITE][mode]
+                    > c[HEATMAP_READ][mostly] + c[HEATMAP_WRITE][mostly])
+                mostly = mode;
+        fprintf(out, "%4zu  $%04X  %10lu reads  %10lu writes  mostly %s\n",
+                i + 1, hot[i].block << map->shift,
+                (unsigned long) hot[i].reads, (unsigned long) hot[i].writes,
+                mode_name(mostly));
+    }
+    free(hot);
+}
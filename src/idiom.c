@@ -0,0 +1,250 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "idiom.h"
+#include "space.h"
+#include "decoder.h"
+#include "processor.h"
+
+// Wildcard in the byte patterns of the loops, standing for an operand
+#define ANY -1
+
+// Longest loop body that is recognized, in bytes
+#define MAX_BODY 9
+
+// Base number of cycles taken by the instructions of the loops
+#define CYCLES_LOAD_ABS   4 // lda abs,x / lda abs,y (+1 if a page is crossed)
+#define CYCLES_LOAD_IND   5 // lda (zpg),y (+1 if a page is crossed)
+#define CYCLES_STORE_ABS  5 // sta abs,x / sta abs,y
+#define CYCLES_STORE_IND  6 // sta (zpg),y
+#define CYCLES_INCREMENT  2 // inx / iny
+#define CYCLES_BRANCH     2 // bne (+1 if taken, +1 more if a page is crossed)
+
+// Shapes of the recognized loops. All of them go on until the index register
+// wraps around to zero; copies load from the source before every store
+static const struct Shape {
+    int16_t pattern[MAX_BODY]; // bytes of the loop body
+    uint8_t length;            // size of the body, in bytes
+    uint8_t count;             // number of instructions in the body
+    bool copy;                 // copy (lda; sta) rather than fill (sta)
+    bool y;                    // indexed by y rather than by x
+    bool indirect;             // (zpg),y rather than absolute addressing
+} shapes[] = {
+    { { 0xBD, ANY, ANY, 0x9D, ANY, ANY, 0xE8, 0xD0, 0xF7 }, 9, 4,
+        true, false, false },
+    { { 0xB9, ANY, ANY, 0x99, ANY, ANY, 0xC8, 0xD0, 0xF7 }, 9, 4,
+        true, true, false },
+    { { 0xB1, ANY, 0x91, ANY, 0xC8, 0xD0, 0xF9 }, 7, 4,
+        true, true, true },
+    { { 0x9D, ANY, ANY, 0xE8, 0xD0, 0xFA }, 6, 3, false, false, false },
+    { { 0x99, ANY, ANY, 0xC8, 0xD0, 0xFA }, 6, 3, false, true, false },
+    { { 0x91, ANY, 0xC8, 0xD0, 0xFB }, 5, 3, false, true, true },
+};
+
+#define SHAPE_COUNT (sizeof(shapes) / sizeof(shapes[0]))
+
+// A loop recognized in memory, with its operands
+typedef struct {
+    const struct Shape *shape;
+    uint16_t src, dst;         // base addresses of the source and destination
+    uint8_t src_ptr, dst_ptr;  // zero page pointers to them (indirect only)
+} Loop;
+
+// Read a byte of directly mapped memory. Returns false if it is not
+static inline bool peek(const AddressSpace *space, uint16_t addr,
+        uint8_t *data) {
+    const uint8_t *page = space->rmap[PAGE_OF(addr)];
+    if(page == NULL) return false;
+    *data = page[OFFSET_OF(addr)];
+    return true;
+}
+
+// Read a pointer from the zero page
+static inline bool peek_pointer(const AddressSpace *space, uint8_t ptr,
+        uint16_t *addr) {
+    uint8_t low, high;
+    if(!peek(space, ptr, &low) || !peek(space, (uint8_t) (ptr + 1), &high))
+        return false;
+    *addr = low | high << 8;
+    return true;
+}
+
+// Check whether two ranges of addresses (which wrap around) overlap
+static inline bool overlaps(uint16_t a, uint32_t a_size, uint16_t b,
+        uint32_t b_size) {
+    return (uint16_t) (b - a) < a_size || (uint16_t) (a - b) < b_size;
+}
+
+// Check whether a range of at most a page worth of addresses can be directly
+// read or written, which only needs to be checked at its ends
+static inline bool readable(const AddressSpace *space, uint16_t addr,
+        uint32_t size) {
+    return space->rmap[PAGE_OF(addr)] != NULL
+        && space->rmap[PAGE_OF(addr + size - 1)] != NULL;
+}
+
+static inline bool writable(const AddressSpace *space, uint16_t addr,
+        uint32_t size) {
+    return space->wmap[PAGE_OF(addr)] != NULL
+        && space->wmap[PAGE_OF(addr + size - 1)] != NULL;
+}
+
+// Recognize the loop at the given address, if there is one
+static bool match(const AddressSpace *space, uint16_t pc, Loop *loop) {
+    uint8_t body[MAX_BODY];
+    size_t size = 0;
+    while(size < MAX_BODY && peek(space, pc + size, &body[size])) ++size;
+
+    for(size_t s = 0; s < SHAPE_COUNT; ++s) {
+        const struct Shape *shape = &shapes[s];
+        if(size < shape->length) continue;
+        bool ok = true;
+        for(size_t i = 0; ok && i < shape->length; ++i)
+            ok = shape->pattern[i] == ANY || shape->pattern[i] == body[i];
+        if(!ok) continue;
+
+        // Operands: the store comes right after the load, if there is one
+        loop->shape = shape;
+        size_t store = shape->copy ? (shape->indirect ? 2 : 3) : 0;
+        if(shape->indirect) {
+            loop->src_ptr = body[1];
+            loop->dst_ptr = body[store + 1];
+            if(!peek_pointer(space, loop->src_ptr, &loop->src)
+                    || !peek_pointer(space, loop->dst_ptr, &loop->dst))
+                return false;
+        } else {
+            loop->src_ptr = loop->dst_ptr = 0;
+            loop->src = body[1] | body[2] << 8;
+            loop->dst = body[store + 1] | body[store + 2] << 8;
+        }
+        return true;
+    }
+    return false;
+}
+
+// Check that running a number of iterations of a loop at once gives the same
+// results as running them one by one: all memory involved must be directly
+// mapped (and the destination writable), and the stores must not change the
+// code of the loop, its pointers or source bytes that are yet to be copied
+static bool safe(const AddressSpace *space, const Loop *loop, uint16_t pc,
+        uint16_t src, uint16_t dst, uint32_t iterations) {
+    const struct Shape *shape = loop->shape;
+    if(!writable(space, dst, iterations))
+        return false;
+    if(overlaps(dst, iterations, pc, shape->length)) return false;
+    if(shape->indirect) {
+        if(overlaps(dst, iterations, loop->dst_ptr, 1)
+                || overlaps(dst, iterations, (uint8_t) (loop->dst_ptr + 1), 1)
+                || overlaps(dst, iterations, loop->src_ptr, 1)
+                || overlaps(dst, iterations, (uint8_t) (loop->src_ptr + 1), 1))
+            return false;
+    }
+    if(shape->copy) {
+        if(!readable(space, src, iterations))
+            return false;
+        // A store to src + k from an earlier iteration j < k would be read
+        // back by the copy, which memmove does not reproduce
+        uint16_t distance = dst - src;
+        if(distance >= 1 && distance < iterations) return false;
+    }
+    return true;
+}
+
+// Copy or fill memory, a page at a time
+static void transfer(AddressSpace *space, const Loop *loop, uint16_t src,
+        uint16_t dst, uint32_t size, uint8_t value) {
+    uint32_t done = 0;
+    while(done < size) {
+        uint16_t s = src + done, d = dst + done;
+        uint32_t chunk = size - done;
+        if(chunk > (uint32_t) SPACE_PAGE_SIZE - OFFSET_OF(d))
+            chunk = SPACE_PAGE_SIZE - OFFSET_OF(d);
+        uint8_t *to = space->wmap[PAGE_OF(d)] + OFFSET_OF(d);
+        if(loop->shape->copy) {
+            if(chunk > (uint32_t) SPACE_PAGE_SIZE - OFFSET_OF(s))
+                chunk = SPACE_PAGE_SIZE - OFFSET_OF(s);
+            memmove(to, space->rmap[PAGE_OF(s)] + OFFSET_OF(s), chunk);
+        } else memset(to, value, chunk);
+        space_mark_dirty(space, PAGE_OF(d));
+        done += chunk;
+    }
+}
+
+// Number of cycles taken by a number of iterations of a loop, starting with
+// the given index. The last one may fall through the branch
+static uint64_t cycles(const Loop *loop, uint16_t pc, uint8_t index,
+        uint32_t iterations, bool last) {
+    const struct Shape *shape = loop->shape;
+    uint64_t total = iterations * (uint64_t) (CYCLES_INCREMENT + CYCLES_BRANCH
+            + 1 + (shape->indirect ? CYCLES_STORE_IND : CYCLES_STORE_ABS));
+    if(((pc + shape->length) ^ pc) & 0xFF00) total += iterations;
+    if(last) total -= ((pc + shape->length) ^ pc) & 0xFF00 ? 2 : 1;
+    if(!shape->copy) return total;
+    total += iterations * (uint64_t) (shape->indirect ? CYCLES_LOAD_IND
+            : CYCLES_LOAD_ABS);
+    for(uint32_t i = 0; i < iterations; ++i)
+        if(OFFSET_OF(loop->src) + (uint8_t) (index + i) > 0xFF) ++total;
+    return total;
+}
+
+// Run the block copy or fill loop starting at the program counter of the
+// processor, if there is one, for as many whole iterations as the given
+// number of instructions allows
+uint32_t idiom_run(Processor *proc, uint32_t budget) {
+    if(proc->read != space_read || proc->write != space_write) return 0;
+    // Edge coverage counts every iteration of the loop
+    if(proc->coverage != NULL) return 0;
+    AddressSpace *space = proc->u;
+    Loop loop;
+    if(!match(space, proc->pc, &loop)) return 0;
+
+    // The loop goes on until the index register wraps around to zero
+    const struct Shape *shape = loop.shape;
+    uint8_t index = shape->y ? proc->y : proc->x;
+    uint32_t left = SPACE_PAGE_SIZE - index;
+    uint32_t iterations = budget / shape->count;
+    if(iterations > left) iterations = left;
+    if(iterations == 0) return 0;
+    uint16_t src = loop.src + index, dst = loop.dst + index;
+    if(!safe(space, &loop, proc->pc, src, dst, iterations)) return 0;
+
+    // The accumulator ends up with the last byte copied, which is read
+    // before the copy (nothing earlier in it can have been stored to)
+    if(shape->copy) peek(space, src + iterations - 1, &proc->acc);
+    transfer(space, &loop, src, dst, iterations, proc->acc);
+
+    // Leave the registers as the last increment and branch would
+    bool last = iterations == left;
+    index += iterations;
+    if(shape->y) proc->y = index;
+    else proc->x = index;
+    proc->status &= ~(FLAG_ZERO | FLAG_NEGATIVE);
+    if(index == 0) proc->status |= FLAG_ZERO;
+    proc->status |= index & FLAG_NEGATIVE;
+    if(proc->features & FEATURE_CYCLES)
+        proc->cycles += cycles(&loop, proc->pc, index - iterations,
+                iterations, last);
+    if(last) proc->pc += shape->length;
+    proc->opcode = 0xD0;
+    proc->inst = decode(0xD0);
+    return iterations * shape->count;
+}
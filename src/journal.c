@@ -0,0 +1,282 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "journal.h"
+#include "space.h"
+#include "processor.h"
+
+#define JOURNAL_HEADER_SIZE 12
+
+// Write the pending reads as a single record. Failures to write are left to
+// be found by journal_flush or journal_close (through the error indicator)
+static void write_reads(Journal *journal) {
+    if(journal->pending == 0) return;
+    fputc(journal->pending - 1, journal->file);
+    fwrite(journal->read, journal->pending, 1, journal->file);
+    journal->pending = 0;
+}
+
+// Device reader while recording: read from the device and log the value
+static uint8_t record_read(void *userdata, uint16_t addr) {
+    Journal *journal = userdata;
+    uint8_t data = journal->io_read != NULL
+        ? journal->io_read(journal->io, addr) : 0;
+    journal->read[journal->pending++] = data;
+    ++journal->reads;
+    if(journal->pending == JOURNAL_READS) write_reads(journal);
+    return data;
+}
+
+// Device writer while recording: write to the device
+static void record_write(void *userdata, uint16_t addr, uint8_t data) {
+    Journal *journal = userdata;
+    if(journal->io_write != NULL) journal->io_write(journal->io, addr, data);
+}
+
+// Device reader while replaying: the next recorded value. Records of
+// interrupts are skipped, they are followed by the other cursor
+static uint8_t replay_read(void *userdata, uint16_t addr) {
+    (void) addr;
+    Journal *journal = userdata;
+    while(journal->read_left == 0) {
+        if(journal->read_at >= journal->size) {
+            journal->diverged = true; // read more than was recorded
+            return 0;
+        }
+        uint8_t tag = journal->data[journal->read_at++];
+        if(tag < JOURNAL_IRQ) {
+            journal->read_left = tag + 1;
+            break;
+        }
+        // Skip both varints of the interrupt
+        for(int i = 0; i < 2; ++i)
+            while(journal->read_at < journal->size
+                    && journal->data[journal->read_at++] & 0x80);
+    }
+    if(journal->read_at >= journal->size) {
+        journal->diverged = true; // truncated record
+        journal->read_left = 0;
+        return 0;
+    }
+    --journal->read_left;
+    ++journal->reads;
+    return journal->data[journal->read_at++];
+}
+
+// Device writer while replaying: there are no devices to write to
+static void replay_write(void *userdata, uint16_t addr, uint8_t data) {
+    (void) userdata;
+    (void) addr;
+    (void) data;
+}
+
+// Encode a varint
+static void put_varint(FILE *file, uint64_t value) {
+    while(value >= 0x80) {
+        fputc((value & 0x7F) | 0x80, file);
+        value >>= 7;
+    }
+    fputc(value, file);
+}
+
+// Decode a varint, moving the offset past it. Returns false if truncated
+static bool get_varint(const Journal *journal, size_t *at, uint64_t *value) {
+    *value = 0;
+    for(int shift = 0; *at < journal->size && shift < 64; shift += 7) {
+        uint8_t byte = journal->data[(*at)++];
+        *value |= (uint64_t) (byte & 0x7F) << shift;
+        if(!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+// Move the interrupt cursor to the next interrupt, counting the reads that
+// come before it
+static void next_event(Journal *journal) {
+    JournalEvent *next = &journal->next;
+    uint8_t tag = 0;
+    while(tag == 0 && journal->event_at < journal->size) {
+        uint8_t t = journal->data[journal->event_at++];
+        if(t < JOURNAL_IRQ) {
+            journal->event_at += t + 1;
+            next->reads += t + 1;
+        } else tag = t;
+    }
+    uint64_t instructions, cycles;
+    if(tag != 0 && get_varint(journal, &journal->event_at, &instructions)
+            && get_varint(journal, &journal->event_at, &cycles)) {
+        next->tag = tag;
+        next->instructions += instructions;
+        next->cycles += cycles;
+    } else next->tag = 0;
+}
+
+// Replace the devices of an address space with the journal
+static void attach(Journal *journal, AddressSpace *space, AddrReader read,
+        AddrWriter write) {
+    journal->space = space;
+    journal->io_read = space->io_read;
+    journal->io_write = space->io_write;
+    journal->io = space->io;
+    space->io_read = read;
+    space->io_write = write;
+    space->io = journal;
+}
+
+// Start recording into a new file
+bool journal_record(Journal *journal, const char *path, AddressSpace *space) {
+    memset(journal, 0, sizeof(Journal));
+    journal->mode = JOURNAL_RECORD;
+    journal->file = fopen(path, "wb");
+    if(journal->file == NULL) return false;
+    uint8_t header[JOURNAL_HEADER_SIZE] = { 0 };
+    memcpy(header, JOURNAL_MAGIC, 8);
+    header[8] = JOURNAL_VERSION;
+    if(fwrite(header, JOURNAL_HEADER_SIZE, 1, journal->file) != 1) {
+        fclose(journal->file);
+        return false;
+    }
+    attach(journal, space, record_read, record_write);
+    return true;
+}
+
+// Start replaying a file, which is mapped into memory
+bool journal_replay(Journal *journal, const char *path, AddressSpace *space) {
+    memset(journal, 0, sizeof(Journal));
+    journal->mode = JOURNAL_REPLAY;
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return false;
+    struct stat st;
+    void *map = MAP_FAILED;
+    if(fstat(fd, &st) == 0 && st.st_size >= JOURNAL_HEADER_SIZE)
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) return false;
+
+    const uint8_t *header = map;
+    uint32_t version = header[8] | header[9] << 8
+        | header[10] << 16 | (uint32_t) header[11] << 24;
+    if(memcmp(header, JOURNAL_MAGIC, 8) != 0 || version != JOURNAL_VERSION) {
+        munmap(map, st.st_size);
+        return false;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    journal->data = map;
+    journal->size = st.st_size;
+    journal->read_at = journal->event_at = JOURNAL_HEADER_SIZE;
+    next_event(journal);
+    attach(journal, space, replay_read, replay_write);
+    return true;
+}
+
+// Raise the next recorded interrupt, which is due now. It must come after
+// just as many reads, and at the same cycle, as when it was recorded
+static void replay_event(Journal *journal, Processor *proc) {
+    const JournalEvent *next = &journal->next;
+    if(next->reads != journal->reads || next->cycles != proc->cycles)
+        journal->diverged = true;
+    if(next->tag == JOURNAL_IRQ) processor_request(proc);
+    else processor_interrupt(proc);
+    next_event(journal);
+}
+
+// Run instructions, raising the recorded interrupts when replaying. Runs are
+// split at each interrupt, so the run loop itself never checks for them
+uint32_t journal_run(Journal *journal, Processor *proc, uint32_t count) {
+    if(journal->mode == JOURNAL_RECORD) {
+        uint32_t ran = processor_run(proc, count);
+        journal->instructions += ran;
+        return ran;
+    }
+    uint32_t done = 0;
+    while(done < count) {
+        const JournalEvent *next = &journal->next;
+        if(next->tag != 0 && next->instructions == journal->instructions) {
+            replay_event(journal, proc);
+            continue;
+        }
+        uint32_t batch = count - done;
+        if(next->tag != 0 && next->instructions - journal->instructions < batch)
+            batch = next->instructions - journal->instructions;
+        uint32_t ran = processor_run(proc, batch);
+        journal->instructions += ran;
+        done += ran;
+        if(ran < batch) break; // a call from the host returned
+    }
+    // Interrupts raised right after the last instruction of the run
+    while(journal->next.tag != 0
+            && journal->next.instructions == journal->instructions)
+        replay_event(journal, proc);
+    return done;
+}
+
+// Record an interrupt, along with the reads done before it
+static void record_event(Journal *journal, const Processor *proc,
+        uint8_t tag) {
+    write_reads(journal);
+    fputc(tag, journal->file);
+    put_varint(journal->file, journal->instructions - journal->marked);
+    put_varint(journal->file, proc->cycles - journal->cycles);
+    journal->marked = journal->instructions;
+    journal->cycles = proc->cycles;
+}
+
+// Request an interruption (IRQ)
+void journal_request(Journal *journal, Processor *proc) {
+    if(journal->mode == JOURNAL_REPLAY) return;
+    record_event(journal, proc, JOURNAL_IRQ);
+    processor_request(proc);
+}
+
+// Generate a non-maskable interruption (NMI)
+void journal_interrupt(Journal *journal, Processor *proc) {
+    if(journal->mode == JOURNAL_REPLAY) return;
+    record_event(journal, proc, JOURNAL_NMI);
+    processor_interrupt(proc);
+}
+
+// Write out the recorded reads
+bool journal_flush(Journal *journal) {
+    if(journal->mode == JOURNAL_REPLAY) return true;
+    write_reads(journal);
+    return fflush(journal->file) == 0 && !ferror(journal->file);
+}
+
+// Stop recording or replaying
+bool journal_close(Journal *journal) {
+    AddressSpace *space = journal->space;
+    space->io_read = journal->io_read;
+    space->io_write = journal->io_write;
+    space->io = journal->io;
+    if(journal->mode == JOURNAL_REPLAY) {
+        munmap((void *) journal->data, journal->size);
+        return true;
+    }
+    write_reads(journal);
+    bool ok = !ferror(journal->file);
+    return fclose(journal->file) == 0 && ok;
+}
@@ -19,16 +19,20 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
 
+#include "space.h"
+#include "idiom.h"
+#include "fusion.h"
 #include "decoder.h"
+#include "decimal.h"
+#include "cycles.h"
+#include "coverage.h"
+#include "recorder.h"
 #include "processor.h"
 #include "addressing.h"
 #include "definitions.h"
 
-// Convert from and to (packed) BCD representation (for decimal mode)
-#define FROM_BCD(bin) (((bin) >> 4) * 10 + ((bin) & 0xF))
-#define TO_BCD(dec)   (((dec) / 10) << 4 | ((dec) % 10))
-
 // Base address of the stack. It is confined to page #01, and its primary use
 // is to store return addresses (though it can be used for arbitrary data
 // storage). It grows downward and shrinks upward
@@ -41,8 +45,8 @@ static inline void stack_push(Processor *proc, uint8_t u) {
 
 // Push a 16-bit value to the stack in main memory
 static void stack_push16(Processor *proc, uint16_t w) {
-    proc->write(proc->u, STACK_BASE | proc->sp--, w & 0x00FF);
     proc->write(proc->u, STACK_BASE | proc->sp--, w >> 8);
+    proc->write(proc->u, STACK_BASE | proc->sp--, w & 0x00FF);
 }
 
 // Pop/pull a byte from the stack in main memory
@@ -52,8 +56,8 @@ static inline uint8_t stack_pull(Processor *proc) {
 
 // Pop/pull a 16-bit value from the stack in main memory
 static uint16_t stack_pull16(Processor *proc) {
-    uint16_t w = proc->read(proc->u, STACK_BASE | ++proc->sp) << 8;
-    w |= proc->read(proc->u, STACK_BASE | ++proc->sp);
+    uint16_t w = proc->read(proc->u, STACK_BASE | ++proc->sp);
+    w |= proc->read(proc->u, STACK_BASE | ++proc->sp) << 8;
     return w;
 }
 
@@ -77,14 +81,29 @@ static inline void set_zn(Processor *proc, uint8_t data) {
     set_flag(proc, FLAG_NEGATIVE, data & 0x80);
 }
 
-// Initializes a new processor instance, connecting it to its address space
-void processor_init(Processor *proc, AddrReader read,
-        AddrWriter write, void *userdata) {
-    proc->read = read;
-    proc->write = write;
-    proc->u = userdata;
-    processor_reset(proc);
-}
+// Set by meson to select the features compiled into the library; each of them
+// doubles the number of core variants that get instantiated
+#ifndef LIBRE_6502_DECIMAL
+#define LIBRE_6502_DECIMAL 1
+#endif
+#ifndef LIBRE_6502_TRACE
+#define LIBRE_6502_TRACE 1
+#endif
+#ifndef LIBRE_6502_CYCLES
+#define LIBRE_6502_CYCLES 1
+#endif
+#ifndef LIBRE_6502_RECORD
+#define LIBRE_6502_RECORD 1
+#endif
+
+// Set of features available in this build, as a Processor_feature bitmask
+#define FEATURES_AVAILABLE (LIBRE_6502_DECIMAL * FEATURE_DECIMAL \
+        | LIBRE_6502_TRACE * FEATURE_TRACE | LIBRE_6502_CYCLES * FEATURE_CYCLES \
+        | LIBRE_6502_RECORD * FEATURE_RECORD)
+
+// Features enabled on a new processor: everything available but tracing and
+// recording (which needs a recorder to be attached)
+#define FEATURES_DEFAULT (FEATURES_AVAILABLE & ~(FEATURE_TRACE | FEATURE_RECORD))
 
 // Initialize/reset the state of the CPU
 void processor_reset(Processor *proc) {
@@ -96,33 +115,116 @@ void processor_reset(Processor *proc) {
     proc->pc = read_address(proc, RESET_VECTOR);
 }
 
-// Request a CPU interruption (IRQ)
-void processor_request(Processor *proc) {
-    // If IRQ has been disabled, ignore this request
-    if(proc->status & FLAG_IRQ_DIS) return;
+// Number of cycles taken by an interrupt sequence (IRQ, NMI or BRK)
+#define INTERRUPT_CYCLES 7
+
+// Status register as pushed onto the stack. The break flag only exists in
+// the pushed copy, where it tells BRK and PHP apart from hardware interrupts
+static inline uint8_t pushed_status(const Processor *proc, bool brk) {
+    uint8_t status = (proc->status & ~FLAG_BREAK) | FLAG_NIL;
+    return brk ? status | FLAG_BREAK : status;
+}
+
+// Status register as pulled from the stack, which leaves the break and nil
+// bits of the register alone
+static inline uint8_t pulled_status(const Processor *proc, uint8_t status) {
+    return (status & ~(FLAG_BREAK | FLAG_NIL))
+        | (proc->status & (FLAG_BREAK | FLAG_NIL));
+}
+
+// Count a control flow edge to the given address, if covering (coverage.h)
+static inline void cover(Processor *proc, uint16_t pc) {
+    if(proc->coverage != NULL) coverage_edge(proc->coverage, pc);
+}
+
+// Interrupt the CPU, jumping to the handler pointed to by the given vector
+static void interrupt(Processor *proc, uint16_t vector, bool brk) {
     // When an interrupt happens, the PC and status registers are pushed onto
     // the stack and a new value for the PC is loaded from an interrupt vector,
     // stored at a fixed location in memory
     stack_push16(proc, proc->pc);
-    stack_push(proc, proc->status);
+    stack_push(proc, pushed_status(proc, brk));
     proc->status |= FLAG_IRQ_DIS; // disable IRQ
-    proc->pc = read_address(proc, IRQ_VECTOR);
+    proc->pc = read_address(proc, vector);
+    cover(proc, proc->pc);
+}
+
+// Request a CPU interruption (IRQ)
+void processor_request(Processor *proc) {
+    // If IRQ has been disabled, ignore this request
+    if(proc->status & FLAG_IRQ_DIS) return;
+    interrupt(proc, IRQ_VECTOR, false);
+    if(proc->features & FEATURE_CYCLES) proc->cycles += INTERRUPT_CYCLES;
 }
 
 // Generate a non-maskable CPU interruption (NMI)
 void processor_interrupt(Processor *proc) {
-    // When an interrupt happens, the PC and status registers are pushed onto
-    // the stack and a new value for the PC is loaded from an interrupt vector,
-    // stored at a fixed location in memory
-    stack_push16(proc, proc->pc);
-    stack_push(proc, proc->status);
-    proc->status |= FLAG_IRQ_DIS; // disable IRQ
-    proc->pc = read_address(proc, NMI_VECTOR);
+    interrupt(proc, NMI_VECTOR, false);
+    if(proc->features & FEATURE_CYCLES) proc->cycles += INTERRUPT_CYCLES;
+}
+
+// Cycles taken to halt the processor for DMA
+#define DMA_HALT_CYCLES 1
+
+// Copy bytes from one address to another through the read and write functions
+static void dma_bus(Processor *proc, uint16_t src, uint16_t dst,
+        uint32_t size, Dma_mode mode) {
+    for(uint32_t i = 0; i < size; ++i) {
+        uint8_t data = proc->read(proc->u, src + i);
+        proc->write(proc->u, mode == DMA_FIXED ? dst : dst + i, data);
+    }
+}
+
+// Copy bytes within an address space, a page at a time. Pieces whose source
+// and destination are both directly mapped are done with memmove (or just by
+// storing their last byte, for a fixed destination)
+static void dma_space(Processor *proc, AddressSpace *space, uint16_t src,
+        uint16_t dst, uint32_t size, Dma_mode mode) {
+    // A destination just ahead of the source (or, if fixed, within it) gets
+    // bytes that were written earlier in the transfer read back, which is
+    // only done right byte by byte
+    uint16_t distance = dst - src;
+    if(distance < size && (mode == DMA_FIXED || distance >= 1)) {
+        dma_bus(proc, src, dst, size, mode);
+        return;
+    }
+    uint32_t done = 0;
+    while(done < size) {
+        uint16_t s = src + done, d = mode == DMA_FIXED ? dst : dst + done;
+        uint32_t chunk = SPACE_PAGE_SIZE - OFFSET_OF(s);
+        uint32_t room = SPACE_PAGE_SIZE - OFFSET_OF(d);
+        if(mode == DMA_INCREMENT && chunk > room) chunk = room;
+        if(chunk > size - done) chunk = size - done;
+        const uint8_t *from = space->rmap[PAGE_OF(s)];
+        uint8_t *to = space->wmap[PAGE_OF(d)];
+        if(from == NULL || to == NULL) {
+            dma_bus(proc, s, d, chunk, mode);
+        } else {
+            if(mode == DMA_FIXED)
+                to[OFFSET_OF(d)] = from[OFFSET_OF(s + chunk - 1)];
+            else memmove(to + OFFSET_OF(d), from + OFFSET_OF(s), chunk);
+            space_mark_dirty(space, PAGE_OF(d));
+        }
+        done += chunk;
+    }
+}
+
+// Transfer a block of memory with DMA, stalling the processor
+uint32_t processor_dma(Processor *proc, uint16_t src, uint16_t dst,
+        uint32_t size, Dma_mode mode) {
+    uint32_t stall = DMA_HALT_CYCLES + 2 * size;
+    if(proc->features & FEATURE_CYCLES) {
+        stall += proc->cycles & 1;
+        proc->cycles += stall;
+    }
+    if(proc->read == space_read && proc->write == space_write)
+        dma_space(proc, proc->u, src, dst, size, mode);
+    else dma_bus(proc, src, dst, size, mode);
+    return stall;
 }
 
 // Operation of addition in the processor
-static void processor_add(Processor *proc) {
-    uint8_t data = get_data(proc, NULL);
+static void processor_add(Processor *proc, uint8_t data) {
     // The result has to be stored in 16 bits to detect carry out. This is a
     // poor man's substitute for the carry out signal in the original hardware
     uint16_t sum = proc->acc + data + (proc->status & FLAG_CARRY);
@@ -142,32 +244,22 @@ static void processor_add(Processor *proc) {
 }
 
 // Operation of decimal (BCD) addition in the processor
-static void processor_decimal_add(Processor *proc) {
-    // NOTE what happens when one of the operands is invalid BCD is undefined
-    // in the original hardware, causing some really weird behavior. We do not
-    // (and don't need to) check for this situation
-    uint8_t data = get_data(proc, NULL);
-    data = FROM_BCD(data); // convert data from BCD
-
-    // We no longer have to store the result in 16 bits, because in BCD
-    // arithmetic carry is communicated by a value of over 0x64 (100)
-    uint8_t sum = FROM_BCD(proc->acc) + data + (proc->status & FLAG_CARRY);
-    set_flag(proc, FLAG_CARRY, sum >= 0x64);
-    if(sum >= 0x64) sum -= 0x64;
-    // Convert the result back to BCD and set the NEG and ZERO flags based on
-    // the converted value, to allow 0x80-0x99 to represent a negative range if
-    // so desired
-    proc->acc = TO_BCD(sum);
-    set_zn(proc, proc->acc);
+static void processor_decimal_add(Processor *proc, uint8_t data) {
+    // The outcome of every possible decimal addition has been precomputed
+    // at build time, including the weird ones that arise from invalid BCD
+    // operands, so it is just a matter of looking it up
+    uint16_t entry = decimal_add_table[DECIMAL_INDEX(proc->acc, data,
+            proc->status & FLAG_CARRY)];
+    proc->status = (proc->status & ~DECIMAL_FLAGS) | (entry >> 8);
+    proc->acc = (uint8_t) (entry & 0xFF);
 }
 
 // Operation of subtraction in the processor
-static void processor_sub(Processor *proc) {
-    uint8_t data = get_data(proc, NULL);
+static void processor_sub(Processor *proc, uint8_t data) {
     // The result has to be stored in 16 bits to detect carry out. This is a
     // poor man's substitute for the carry out signal in the original hardware
     uint16_t diff = 0x0100 | proc->acc;
-    diff -= data - !(proc->status & FLAG_CARRY);
+    diff -= data + !(proc->status & FLAG_CARRY);
 
     // Here we check for a borrow
     set_flag(proc, FLAG_CARRY, diff & 0x0100);
@@ -185,374 +277,448 @@ static void processor_sub(Processor *proc) {
 }
 
 // Operation of decimal (BCD) subtraction in the processor
-static void processor_decimal_sub(Processor *proc) {
-    // NOTE what happens when one of the operands is invalid BCD is undefined
-    // in the original hardware, causing some really weird behavior. We do not
-    // (and don't need to) check for this situation
-    uint8_t data = get_data(proc, NULL);
-    data = FROM_BCD(data); // convert data from BCD
+static void processor_decimal_sub(Processor *proc, uint8_t data) {
+    // Same as decimal addition, the result and flags come from a table
+    uint16_t entry = decimal_sub_table[DECIMAL_INDEX(proc->acc, data,
+            proc->status & FLAG_CARRY)];
+    proc->status = (proc->status & ~DECIMAL_FLAGS) | (entry >> 8);
+    proc->acc = (uint8_t) (entry & 0xFF);
+}
 
-    // We no longer have to store the result in 16 bits, because in BCD
-    // arithmetic borrow is communicated by a value below 0x64 (100)
-    uint8_t diff = 0x64 + FROM_BCD(proc->acc);
-    diff -= data - !(proc->status & FLAG_CARRY);
-    set_flag(proc, FLAG_CARRY, diff >= 0x64);
-    if(diff >= 0x64) diff -= 0x64;
-    // Convert the result back to BCD and set the NEG and ZERO flags based on
-    // the converted value, to allow 0x80-0x99 to represent a negative range if
-    // so desired
-    proc->acc = TO_BCD(diff);
-    set_zn(proc, proc->acc);
+// Compare a register with some data, setting the flags as a subtraction
+// would (but without the effect of the carry flag on it)
+static inline void compare(Processor *proc, uint8_t reg, uint8_t data) {
+    set_flag(proc, FLAG_CARRY, reg >= data);
+    set_zn(proc, reg - data);
 }
 
-// Branches on flag set (BEQ, BCS, BMI, BVS)
-static inline void branch_set(Processor *proc, Processor_flag flag) {
-    if(proc->status & flag) proc->pc = get_address(proc);
+// Branch if the given condition holds. Returns the number of extra cycles
+// taken by the branch: one if it is taken and another one if it lands on a
+// different page than the instruction that follows it
+static inline uint8_t branch(Processor *proc, bool cond) {
+    uint16_t next = proc->pc + 1;
+    if(!cond) {
+        cover(proc, next);
+        return 0;
+    }
+    proc->pc = get_address(proc);
+    cover(proc, proc->pc + 1);
+    return ((proc->pc + 1) ^ next) & 0xFF00 ? 2 : 1;
 }
 
-// Branches on flag clear (BNE, BCC, BPL, BVC)
-static inline void branch_clear(Processor *proc, Processor_flag flag) {
-    if(!(proc->status & flag)) proc->pc = get_address(proc);
+// Get the data for an instruction that only reads it. Indexed reads take an
+// extra cycle when the index makes them cross a page boundary, which is
+// reported through the penalty parameter
+static inline uint8_t read_data(const Processor *proc, uint8_t *penalty) {
+    uint16_t addr = 0, base;
+    uint8_t data = get_data(proc, &addr);
+    switch(proc->inst.mode) {
+        case MODE_ABSOLUTE_X: base = addr - proc->x; break;
+        case MODE_ABSOLUTE_Y: base = addr - proc->y; break;
+        case MODE_INDIRECT_Y: base = addr - proc->y; break;
+        default: base = addr;
+    }
+    *penalty = (base ^ addr) & 0xFF00 ? 1 : 0;
+    return data;
 }
 
-// Run a single clock cycle of execution
-void processor_step(Processor *proc) {
-    // Fetch an opcode and decode it
-    uint8_t opcode = proc->read(proc->u, proc->pc++);
-    proc->inst = decode(opcode);
-
-    // Now execute it (with some auxiliary variables)
-    uint16_t addr;
-    uint8_t data, aux;
-    switch(proc->inst.op) {
-        // Load and store operations:
-        case LDA:
-            // LDA: load given data into the accumulator
-            proc->acc = get_data(proc, NULL);
-            set_zn(proc, proc->acc);
-            break;
-        case LDX:
-            // LDX: load given data into the x register
-            proc->x = get_data(proc, NULL);
-            set_zn(proc, proc->x);
-            break;
-        case LDY:
-            // LDY: load given data into the y register
-            proc->y = get_data(proc, NULL);
-            set_zn(proc, proc->y);
-            break;
-        case STA:
-            // STA: store the contents of the accumulator into the given address
-            addr = get_address(proc);
-            proc->write(proc->u, addr, proc->acc);
-            break;
-        case STX:
-            // STX: store the contents of the x register into the given address
-            addr = get_address(proc);
-            proc->write(proc->u, addr, proc->x);
-            break;
-        case STY:
-            // STY: store the contents of the y register into the given address
-            addr = get_address(proc);
-            proc->write(proc->u, addr, proc->y);
-            break;
-        // Register transfer operations:
-        case TAX:
-            // TAX: copy the accumulator into the x register
-            proc->x = proc->acc;
-            set_zn(proc, proc->x);
-            break;
-        case TAY:
-            // TAY: copy the accumulator into the y register
-            proc->y = proc->acc;
-            set_zn(proc, proc->y);
-            break;
-        case TXA:
-            // TXA: copy the x register into the accumulator
-            proc->acc = proc->x;
-            set_zn(proc, proc->acc);
-            break;
-        case TYA:
-            // TYA: copy the y register into the accumulator
-            proc->acc = proc->y;
-            set_zn(proc, proc->acc);
-            break;
-        case TSX:
-            // TSX: copy the stack pointer into the x register
-            proc->x = proc->sp;
-            set_zn(proc, proc->x);
-            break;
-        case TXS:
-            // TXS: copy the x register into the stack pointer
-            proc->sp = proc->x;
-            break;
-        // Stack operations:
-        case PHA:
-            // PHA: push the accumulator on the stack
-            stack_push(proc, proc->acc);
-            break;
-        case PHP:
-            // PHP: push the status register on the stack
-            proc->status |= FLAG_BREAK;
-            stack_push(proc, proc->status);
-            break;
-        case PLA:
-            // PLA: pull a byte from the stack and put it in the accumulator
-            proc->acc = stack_pull(proc);
-            set_zn(proc, proc->acc);
-            break;
-        case PLP:
-            // PLP: pull a byte from the stack and put it in the status register
-            proc->status = stack_pull(proc);
-            break;
-        // Logic operations:
-        case AND:
-            // AND: bitwise AND data into the accumulator
-            proc->acc &= get_data(proc, NULL);
-            set_zn(proc, proc->acc);
-            break;
-        case EOR:
-            // EOR: bitwise XOR data into the accumulator
-            proc->acc ^= get_data(proc, NULL);
-            set_zn(proc, proc->acc);
-            break;
-        case ORA:
-            // ORA: bitwise OR data into the accumulator
-            proc->acc |= get_data(proc, NULL);
-            set_zn(proc, proc->acc);
-            break;
-        case BIT:
-            // BIT: bitwise AND data with the accumulator, but the result isn't
-            // kept. It is instead used to set some CPU flags
-            data = get_data(proc, NULL) & proc->acc;
-            set_flag(proc, FLAG_OVERFLOW, data & 0x40);
-            set_zn(proc, data);
-            break;
-        // Arithmetic instructions:
-        case ADC:
-            // ADC: Add the given data and the carry flag to the accumulator
-            if(proc->status & FLAG_DECIMAL) processor_decimal_add(proc);
-            else processor_add(proc);
-            break;
-        case SBC:
-            // SBC: subtract the given data and the negation of the carry flag (which
-            // represents a borrow) from the accumulator
-            if(proc->status & FLAG_DECIMAL) processor_decimal_sub(proc);
-            else processor_sub(proc);
-            break;
-        case CMP:
-            // CMP: compare the contents of the accumulator and the given data,
-            // setting the appropriate flags in the status register
-            data = get_data(proc, NULL);
-            set_flag(proc, FLAG_CARRY, proc->acc >= data);
-            set_flag(proc, FLAG_ZERO, proc->acc == data);
-            set_flag(proc, FLAG_NEGATIVE, proc->acc < data);
-            break;
-        case CPX:
-            // CPX: compare the contents of the x register and the given data,
-            // setting the appropriate flags in the status register
-            data = get_data(proc, NULL);
-            set_flag(proc, FLAG_CARRY, proc->x >= data);
-            set_flag(proc, FLAG_ZERO, proc->x == data);
-            set_flag(proc, FLAG_NEGATIVE, proc->x < data);
-            break;
-        case CPY:
-            // CPY: compare the contents of the y register and the given data,
-            // setting the appropriate flags in the status register
-            data = get_data(proc, NULL);
-            set_flag(proc, FLAG_CARRY, proc->y >= data);
-            set_flag(proc, FLAG_ZERO, proc->y == data);
-            set_flag(proc, FLAG_NEGATIVE, proc->y < data);
-            break;
-        // Increment operations:
-        case INC:
-            // INC: increment the memory location at the given address
-            data = get_data(proc, &addr);
-            proc->write(proc->u, addr, data + 1);
-            set_zn(proc, data + 1);
-            break;
-        case INX:
-            // INX: increment the x register
-            set_zn(proc, ++proc->x);
-            break;
-        case INY:
-            // INY: increment the y register
-            set_zn(proc, ++proc->y);
-            break;
-        // Decrement operations:
-        case DEC:
-            // DEC: decrement the memory location at the given address
-            data = get_data(proc, &addr);
-            proc->write(proc->u, addr, data - 1);
-            set_zn(proc, data + 1);
-            break;
-        case DEX:
-            // DEX: decrement the x register
-            set_zn(proc, --proc->x);
-            break;
-        case DEY:
-            // INY: decrement the x register
-            set_zn(proc, --proc->y);
-            break;
-        // Shift operations:
-        case ASL:
-            // ASL: arithmetic left shift of the memory location at the given
-            // address or the accumulator, depending on the addressing mode
-            data = get_data(proc, &addr);
-            set_flag(proc, FLAG_CARRY, data & 0x80);
-            data <<= 1;
-            set_zn(proc, data);
-            if(proc->inst.mode != MODE_ACCUMULATOR)
-                proc->write(proc->u, addr, data);
-            else
-                proc->acc = data;
-            break;
-        case LSR:
-            // LSR: logical right shift of the memory location at the given
-            // address or the accumulator, depending on the addressing mode
-            data = get_data(proc, &addr);
-            set_flag(proc, FLAG_CARRY, data & 0x01);
-            data >>= 1;
-            set_zn(proc, data);
-            if(proc->inst.mode != MODE_ACCUMULATOR)
-                proc->write(proc->u, addr, data);
-            else
-                proc->acc = data;
-            break;
-        case ROL:
-            // ROL: rotate to the left the memory location at the given address
-            // or the accumulator, depending on the addressing mode
-            data = get_data(proc, &addr);
-            aux = data & 0x80; // leftmost bit (7), to be put in the carry flag
-            data <<= 1;
-            // The rightmost bit (0) is filled with the current carry flag
-            data |= proc->status & FLAG_CARRY;
-            set_flag(proc, FLAG_CARRY, aux);
-            set_zn(proc, data);
-            if(proc->inst.mode != MODE_ACCUMULATOR)
-                proc->write(proc->u, addr, data);
-            else
-                proc->acc = data;
-            break;
-        case ROR:
-            // ROR: rotate to the right the memory location at the given
-            // address or the accumulator, depending on the addressing mode
-            data = get_data(proc, &addr);
-            aux = data & 0x01; // rightmost bit (0), to be put in the carry flag
-            data >>= 1;
-            // The leftmost bit (7) is filled with the current carry flag
-            data |= (proc->status & FLAG_CARRY) << 7;
-            set_flag(proc, FLAG_CARRY, aux);
-            set_zn(proc, data);
-            if(proc->inst.mode != MODE_ACCUMULATOR)
-                proc->write(proc->u, addr, data);
-            else
-                proc->acc = data;
-            break;
-        // Jump operations:
-        case JMP:
-            // JMP: unconditional jump to the given address
-            proc->pc = get_address(proc);
-            break;
-        case JSR:
-            // JSR: jump to subroutine. It pushes the current value of the PC to
-            // the stack and then does an unconditional jump to the given address.
-            // This way, a future RTS can return to the calling code
-            stack_push16(proc, proc->pc);
-            proc->pc = get_address(proc);
-            break;
-        case RTS:
-            // RTS: return from subroutine. It pulls a 16-bit address from the
-            // stack and puts it into the PC, thus returning to the calling code
-            proc->pc = stack_pull16(proc);
-            break;
-        // Branch operations:
-        case BEQ:
-            // BEQ: branch if equal (zero flag is set)
-            branch_set(proc, FLAG_ZERO);
-            break;
-        case BNE:
-            // BNE: branch if not equal (zero flag is clear)
-            branch_clear(proc, FLAG_ZERO);
-            break;
-        case BCS:
-            // BCS: branch if carry is set
-            branch_set(proc, FLAG_CARRY);
-            break;
-        case BCC:
-            // BCC: branch if carry is clear
-            branch_clear(proc, FLAG_CARRY);
-            break;
-        case BMI:
-            // BCS: branch if negative (negative flag is set)
-            branch_set(proc, FLAG_NEGATIVE);
-            break;
-        case BPL:
-            // BPL: branch if positive (negative flag is clear)
-            branch_clear(proc, FLAG_NEGATIVE);
-            break;
-        case BVS:
-            // BVS: branch if an overflow happened (overflow flag is set)
-            branch_set(proc, FLAG_OVERFLOW);
-            break;
-        case BVC:
-            // BVC: branch if no overflow happened (overflow flag is clear)
-            branch_clear(proc, FLAG_OVERFLOW);
-            break;
-        // Flag operations:
-        case SEC:
-            // SEC: set carry flag
-            proc->status |= FLAG_CARRY;
-            break;
-        case SEI:
-            // SEI: set interrupt disable flag
-            proc->status |= FLAG_IRQ_DIS;
-            break;
-        case SED:
-            // SED: set decimal flag (BCD arithmetic)
-            proc->status |= FLAG_DECIMAL;
-            break;
-        case CLC:
-            // CLC: clear carry flag
-            proc->status &= ~FLAG_CARRY;
-            break;
-        case CLI:
-            // CLI: clear interrupt disable flag
-            proc->status &= ~FLAG_IRQ_DIS;
-            break;
-        case CLD:
-            // CLD: clear decimal flag (binary arithmetic)
-            proc->status &= ~FLAG_DECIMAL;
-            break;
-        case CLV:
-            // CLV: clear overflow flag
-            proc->status &= ~FLAG_OVERFLOW;
-            break;
-
-        // System/symbolic operations:
-        case BRK:
-            // BRK: force an interrupt (IRQ), setting the BRK flag
-            proc->status |= FLAG_BREAK;
-            processor_request(proc);
-            break;
-        case NOP:
-            // NOP: do nothing
-            break;
-        case RTI:
-            // RTI: return from an interrupt handler
-            proc->status = stack_pull(proc); // restore status register
-            proc->status &= ~FLAG_BREAK; // clear break
-            proc->status &= ~FLAG_NIL;   // clear nil
-            proc->pc = stack_pull16(proc);
-            break;
-        case ERR:
-            // ERR: this represents an invalid opcode. In the real hardware,
-            // this would cause undefined behavior; this allows to just do
-            // nothing without much of an issue (I think)
-            break;
+// Relative branch for fused instructions, equivalent to branch but without
+// going through the generic addressing logic. The offset is only read if the
+// branch is taken, and the program counter is left on the next instruction
+static inline uint8_t fused_branch(Processor *proc, bool cond) {
+    uint16_t next = proc->pc + 1;
+    if(!cond) {
+        proc->pc = next;
+        cover(proc, next);
+        return 0;
     }
-    proc->pc += get_inc(proc->inst.mode); // advance to the next instruction
+    int8_t offset = (int8_t) proc->read(proc->u, proc->pc);
+    proc->pc = next + offset;
+    cover(proc, proc->pc);
+    return (proc->pc ^ next) & 0xFF00 ? 2 : 1;
+}
+
+// Operand of fused instructions: an immediate or zero page byte
+static inline uint8_t fused_byte(Processor *proc) {
+    return proc->read(proc->u, proc->pc++);
+}
+
+// Operand of fused instructions: an absolute address
+static inline uint16_t fused_word(Processor *proc) {
+    uint16_t addr = read_address(proc, proc->pc);
+    proc->pc += 2;
+    return addr;
+}
+
+// Operand of fused instructions: a (zpg),y address
+static inline uint16_t fused_indirect_y(Processor *proc) {
+    uint8_t ptr = fused_byte(proc);
+    uint16_t addr = proc->read(proc->u, ptr);
+    addr |= proc->read(proc->u, (uint8_t) (ptr + 1)) << 8;
+    return addr + proc->y;
+}
+
+// Instantiate the core once for every combination of available features (see
+// core.h). CORE_FEATURES is the Processor_feature bitmask of each variant
+#define CORE_FEATURES 0
+#include "core.h"
+#if LIBRE_6502_DECIMAL
+#define CORE_FEATURES 1
+#include "core.h"
+#endif
+#if LIBRE_6502_TRACE
+#define CORE_FEATURES 2
+#include "core.h"
+#endif
+#if LIBRE_6502_DECIMAL && LIBRE_6502_TRACE
+#define CORE_FEATURES 3
+#include "core.h"
+#endif
+#if LIBRE_6502_CYCLES
+#define CORE_FEATURES 4
+#include "core.h"
+#endif
+#if LIBRE_6502_DECIMAL && LIBRE_6502_CYCLES
+#define CORE_FEATURES 5
+#include "core.h"
+#endif
+#if LIBRE_6502_TRACE && LIBRE_6502_CYCLES
+#define CORE_FEATURES 6
+#include "core.h"
+#endif
+#if LIBRE_6502_DECIMAL && LIBRE_6502_TRACE && LIBRE_6502_CYCLES
+#define CORE_FEATURES 7
+#include "core.h"
+#endif
+// Recording along with tracing is done by the tracing cores, so recording
+// only adds variants without it
+#if LIBRE_6502_RECORD
+#define CORE_FEATURES 8
+#include "core.h"
+#endif
+#if LIBRE_6502_RECORD && LIBRE_6502_DECIMAL
+#define CORE_FEATURES 9
+#include "core.h"
+#endif
+#if LIBRE_6502_RECORD && LIBRE_6502_CYCLES
+#define CORE_FEATURES 12
+#include "core.h"
+#endif
+#if LIBRE_6502_RECORD && LIBRE_6502_DECIMAL && LIBRE_6502_CYCLES
+#define CORE_FEATURES 13
+#include "core.h"
+#endif
+
+// The register-resident run loop needs computed goto (a GNU extension), and
+// is left out of builds with compilers that do not have it
+#ifndef LIBRE_6502_RESIDENT
+#ifdef __GNUC__
+#define LIBRE_6502_RESIDENT 1
+#else
+#define LIBRE_6502_RESIDENT 0
+#endif
+#endif
+
+#if LIBRE_6502_RESIDENT
+
+// Select the run loop of a processor (defined below, with the cores)
+static void select_run(Processor *proc);
+
+// Bus of the resident run loop for address spaces (see resident.h). Directly
+// mapped pages are accessed right away; anything else goes through
+// space_read and space_write, which may end up calling the host
+#define RESIDENT_READ(u, addr) ({ \
+    const uint8_t *sr_page = ((AddressSpace *) (u))->rmap[PAGE_OF(addr)]; \
+    uint8_t sr_data; \
+    if(sr_page != NULL) sr_data = sr_page[OFFSET_OF(addr)]; \
+    else { \
+        RESIDENT_SAVE(); \
+        sr_data = space_read(u, addr); \
+        RESIDENT_LOAD(); \
+    } \
+    sr_data; \
+})
+#define RESIDENT_WRITE(u, addr, data) do { \
+    AddressSpace *sw_space = (u); \
+    uint8_t sw_index = PAGE_OF(addr); \
+    uint8_t *sw_page = sw_space->wmap[sw_index]; \
+    if(sw_page != NULL) { \
+        sw_page[OFFSET_OF(addr)] = (data); \
+        sw_space->dirty[sw_index >> 6] |= (uint64_t) 1 << (sw_index & 63); \
+    } else { \
+        RESIDENT_SAVE(); \
+        space_write(sw_space, addr, data); \
+        RESIDENT_LOAD(); \
+    } \
+} while(0)
+#define RESIDENT_DECODE(opcode) decode_table[opcode]
+#define RESIDENT_IDIOMS 1
+// Hosts may put another bus on the processor after the loop was selected, by
+// assigning the bus fields; the run then goes to the loop for that bus
+#define RESIDENT_ENTER(count) do { \
+    if(proc->read != space_read || proc->write != space_write) { \
+        select_run(proc); \
+        return proc->run(proc, count); \
+    } \
+} while(0)
+
+// Instantiate it once for every combination of available features but
+// tracing, which it does not do
+#define RESIDENT_NAME core_space_0
+#define RESIDENT_FEATURES 0
+#include "resident.h"
+#if LIBRE_6502_DECIMAL
+#define RESIDENT_NAME core_space_1
+#define RESIDENT_FEATURES FEATURE_DECIMAL
+#include "resident.h"
+#endif
+#if LIBRE_6502_CYCLES
+#define RESIDENT_NAME core_space_4
+#define RESIDENT_FEATURES FEATURE_CYCLES
+#include "resident.h"
+#endif
+#if LIBRE_6502_DECIMAL && LIBRE_6502_CYCLES
+#define RESIDENT_NAME core_space_5
+#define RESIDENT_FEATURES (FEATURE_DECIMAL | FEATURE_CYCLES)
+#include "resident.h"
+#endif
+#if LIBRE_6502_RECORD
+#define RESIDENT_NAME core_space_8
+#define RESIDENT_FEATURES FEATURE_RECORD
+#include "resident.h"
+#endif
+#if LIBRE_6502_RECORD && LIBRE_6502_DECIMAL
+#define RESIDENT_NAME core_space_9
+#define RESIDENT_FEATURES (FEATURE_RECORD | FEATURE_DECIMAL)
+#include "resident.h"
+#endif
+#if LIBRE_6502_RECORD && LIBRE_6502_CYCLES
+#define RESIDENT_NAME core_space_12
+#define RESIDENT_FEATURES (FEATURE_RECORD | FEATURE_CYCLES)
+#include "resident.h"
+#endif
+#if LIBRE_6502_RECORD && LIBRE_6502_DECIMAL && LIBRE_6502_CYCLES
+#define RESIDENT_NAME core_space_13
+#define RESIDENT_FEATURES (FEATURE_RECORD | FEATURE_DECIMAL | FEATURE_CYCLES)
+#include "resident.h"
+#endif
+#undef RESIDENT_ENTER
+#undef RESIDENT_IDIOMS
+#undef RESIDENT_WRITE
+#undef RESIDENT_READ
+
+// Bus of the resident run loop for the read and write functions. These may
+// look at the processor, so the registers are written back around each call
+#define RESIDENT_READ(u, addr) ({ \
+    RESIDENT_SAVE(); \
+    uint8_t fr_data = proc->read(u, addr); \
+    RESIDENT_LOAD(); \
+    fr_data; \
+})
+#define RESIDENT_WRITE(u, addr, data) do { \
+    RESIDENT_SAVE(); \
+    proc->write(u, addr, data); \
+    RESIDENT_LOAD(); \
+} while(0)
+
+#define RESIDENT_NAME core_bus_0
+#define RESIDENT_FEATURES 0
+#include "resident.h"
+#if LIBRE_6502_DECIMAL
+#define RESIDENT_NAME core_bus_1
+#define RESIDENT_FEATURES FEATURE_DECIMAL
+#include "resident.h"
+#endif
+#if LIBRE_6502_CYCLES
+#define RESIDENT_NAME core_bus_4
+#define RESIDENT_FEATURES FEATURE_CYCLES
+#include "resident.h"
+#endif
+#if LIBRE_6502_DECIMAL && LIBRE_6502_CYCLES
+#define RESIDENT_NAME core_bus_5
+#define RESIDENT_FEATURES (FEATURE_DECIMAL | FEATURE_CYCLES)
+#include "resident.h"
+#endif
+#if LIBRE_6502_RECORD
+#define RESIDENT_NAME core_bus_8
+#define RESIDENT_FEATURES FEATURE_RECORD
+#include "resident.h"
+#endif
+#if LIBRE_6502_RECORD && LIBRE_6502_DECIMAL
+#define RESIDENT_NAME core_bus_9
+#define RESIDENT_FEATURES (FEATURE_RECORD | FEATURE_DECIMAL)
+#include "resident.h"
+#endif
+#if LIBRE_6502_RECORD && LIBRE_6502_CYCLES
+#define RESIDENT_NAME core_bus_12
+#define RESIDENT_FEATURES (FEATURE_RECORD | FEATURE_CYCLES)
+#include "resident.h"
+#endif
+#if LIBRE_6502_RECORD && LIBRE_6502_DECIMAL && LIBRE_6502_CYCLES
+#define RESIDENT_NAME core_bus_13
+#define RESIDENT_FEATURES (FEATURE_RECORD | FEATURE_DECIMAL | FEATURE_CYCLES)
+#include "resident.h"
+#endif
+#undef RESIDENT_DECODE
+#undef RESIDENT_WRITE
+#undef RESIDENT_READ
+
+#define RESIDENT(n) { core_space_##n, core_bus_##n }
+#else
+#define RESIDENT(n) { NULL, NULL }
+#endif // LIBRE_6502_RESIDENT
+
+// Specialized cores, indexed by feature bitmask. Only the entries whose
+// features are all available in this build are ever used. The resident run
+// loop replaces the generic one for processors connected to address spaces.
+// Tracing cores stand in for the recording ones that would also trace
+static const struct {
+    void (*step)(Processor *proc);
+    uint32_t (*run)(Processor *proc, uint32_t count);
+    struct {
+        uint32_t (*space)(Processor *proc, uint32_t count);
+        uint32_t (*bus)(Processor *proc, uint32_t count);
+    } resident;
+} cores[16] = {
+    [0] = { core_step_0, core_run_0, RESIDENT(0) },
+#if LIBRE_6502_DECIMAL
+    [1] = { core_step_1, core_run_1, RESIDENT(1) },
+#endif
+#if LIBRE_6502_TRACE
+    [2] = { core_step_2, core_run_2, { NULL, NULL } },
+#endif
+#if LIBRE_6502_DECIMAL && LIBRE_6502_TRACE
+    [3] = { core_step_3, core_run_3, { NULL, NULL } },
+#endif
+#if LIBRE_6502_CYCLES
+    [4] = { core_step_4, core_run_4, RESIDENT(4) },
+#endif
+#if LIBRE_6502_DECIMAL && LIBRE_6502_CYCLES
+    [5] = { core_step_5, core_run_5, RESIDENT(5) },
+#endif
+#if LIBRE_6502_TRACE && LIBRE_6502_CYCLES
+    [6] = { core_step_6, core_run_6, { NULL, NULL } },
+#endif
+#if LIBRE_6502_DECIMAL && LIBRE_6502_TRACE && LIBRE_6502_CYCLES
+    [7] = { core_step_7, core_run_7, { NULL, NULL } },
+#endif
+#if LIBRE_6502_RECORD
+    [8] = { core_step_8, core_run_8, RESIDENT(8) },
+#endif
+#if LIBRE_6502_RECORD && LIBRE_6502_DECIMAL
+    [9] = { core_step_9, core_run_9, RESIDENT(9) },
+#endif
+#if LIBRE_6502_RECORD && LIBRE_6502_TRACE
+    [10] = { core_step_2, core_run_2, { NULL, NULL } },
+#endif
+#if LIBRE_6502_RECORD && LIBRE_6502_DECIMAL && LIBRE_6502_TRACE
+    [11] = { core_step_3, core_run_3, { NULL, NULL } },
+#endif
+#if LIBRE_6502_RECORD && LIBRE_6502_CYCLES
+    [12] = { core_step_12, core_run_12, RESIDENT(12) },
+#endif
+#if LIBRE_6502_RECORD && LIBRE_6502_DECIMAL && LIBRE_6502_CYCLES
+    [13] = { core_step_13, core_run_13, RESIDENT(13) },
+#endif
+#if LIBRE_6502_RECORD && LIBRE_6502_TRACE && LIBRE_6502_CYCLES
+    [14] = { core_step_6, core_run_6, { NULL, NULL } },
+#endif
+#if LIBRE_6502_RECORD && LIBRE_6502_DECIMAL && LIBRE_6502_TRACE \
+    && LIBRE_6502_CYCLES
+    [15] = { core_step_7, core_run_7, { NULL, NULL } },
+#endif
+};
+
+// Value of call_sp when no call from the host is in progress. It is above
+// any stack pointer, so the run loop never takes an RTS for the end of a call
+#define CALL_NONE 0x100
+
+// Initializes a new processor instance, connecting it to its address space
+void processor_init(Processor *proc, AddrReader read,
+        AddrWriter write, void *userdata) {
+    proc->read = read;
+    proc->write = write;
+    proc->u = userdata;
+    proc->trace = NULL;
+    proc->recorder = NULL;
+    proc->coverage = NULL;
+    proc->cycles = 0;
+    proc->opcode = 0;
+    proc->fusion = 0;
+    proc->call_pc = 0;
+    proc->call_sp = CALL_NONE;
+    // The core goes through the table of decoded opcodes, not the decoder
+    decode_tables_init();
+    processor_set_features(proc, FEATURES_DEFAULT);
+    processor_reset(proc);
 }
 
-#undef FROM_BCD
-#undef TO_BCD
+// Select the run loop of a processor. The resident one is used whenever it
+// is available for its features, unless fusion was asked for, in which case
+// the generic one is (fusion is only done by it, see processor_set_fusion)
+static void select_run(Processor *proc) {
+    uint8_t features = proc->features;
+    proc->run = cores[features].run;
+    if(proc->fusion != 0) return;
+    if(proc->read == space_read && proc->write == space_write) {
+        if(cores[features].resident.space != NULL)
+            proc->run = cores[features].resident.space;
+    } else if(cores[features].resident.bus != NULL)
+        proc->run = cores[features].resident.bus;
+}
+
+// Select the optional features of the processor, switching it to the core
+// that was specialized for them. Features that were left out of the build
+// are ignored, and so is recording without a recorder; the ones that actually
+// got enabled are returned
+uint8_t processor_set_features(Processor *proc, uint8_t features) {
+    features &= FEATURES_AVAILABLE;
+    if(proc->recorder == NULL) features &= ~FEATURE_RECORD;
+    proc->features = features;
+    proc->step = cores[features].step;
+    select_run(proc);
+    return features;
+}
+
+// Select the pairs of instructions that the run loop fuses together
+void processor_set_fusion(Processor *proc, uint32_t pairs) {
+    proc->fusion = pairs & FUSION_ALL;
+    select_run(proc);
+}
+
+// Run a single instruction as a discrete step (not cycle accurate)
+void processor_step(Processor *proc) {
+    proc->step(proc);
+}
+
+// Run the given number of instructions in a row; returns how many were run
+uint32_t processor_run(Processor *proc, uint32_t count) {
+    return proc->run(proc, count);
+}
+
+// Call a subroutine of the guest from the host. The current PC is pushed as
+// the return address, so that the RTS that matches the call is the one that
+// leaves the stack pointer where it was and jumps back to it. The run loop
+// only checks for that after an RTS, so it costs nothing to other code
+CallResult processor_call(Processor *proc, uint16_t addr, uint8_t a,
+        uint8_t x, uint8_t y, uint32_t budget) {
+    uint16_t outer_pc = proc->call_pc, outer_sp = proc->call_sp;
+    proc->call_pc = proc->pc;
+    proc->call_sp = proc->sp;
+    stack_push16(proc, proc->pc - 1);
+    proc->pc = addr;
+    proc->acc = a;
+    proc->x = x;
+    proc->y = y;
+
+    CallResult result;
+    result.count = proc->run(proc, budget);
+    result.returned = proc->sp == proc->call_sp && proc->pc == proc->call_pc;
+    result.acc = proc->acc;
+    result.x = proc->x;
+    result.y = proc->y;
+    result.status = proc->status;
+    proc->call_pc = outer_pc;
+    proc->call_sp = outer_sp;
+    return result;
+}
@@ -0,0 +1,101 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "recorder.h"
+#include "debug.h"
+#include "decoder.h"
+#include "processor.h"
+#include "definitions.h"
+
+// Initialize a recorder that keeps the given number of instructions
+bool recorder_init(Recorder *rec, size_t size) {
+    *rec = (Recorder) { 0 };
+    if(size == 0 || (size & (size - 1)) != 0) return false;
+    rec->ring = calloc(size, sizeof(uint64_t));
+    rec->mask = size - 1;
+    return rec->ring != NULL;
+}
+
+// Free the ring of a recorder
+void recorder_free(Recorder *rec) {
+    free(rec->ring);
+    rec->ring = NULL;
+}
+
+// Attach a recorder to a processor, enabling FEATURE_RECORD
+bool recorder_attach(Recorder *rec, Processor *proc) {
+    proc->recorder = rec;
+    uint8_t features = proc->features | FEATURE_RECORD;
+    if(processor_set_features(proc, features) == features) return true;
+    proc->recorder = NULL;
+    return false;
+}
+
+// Detach the recorder of a processor, disabling FEATURE_RECORD
+void recorder_detach(Processor *proc) {
+    processor_set_features(proc, proc->features & ~FEATURE_RECORD);
+    proc->recorder = NULL;
+}
+
+// Get the number of instructions in the ring
+size_t recorder_count(const Recorder *rec) {
+    return rec->head <= rec->mask ? rec->head : rec->mask + 1;
+}
+
+// Get an instruction from the ring, the oldest one being at index 0
+RecorderEntry recorder_get(const Recorder *rec, size_t index) {
+    uint64_t entry = rec->ring[(rec->head - recorder_count(rec) + index)
+        & rec->mask];
+    return (RecorderEntry) {
+        .pc = entry, .opcode = entry >> 16, .acc = entry >> 24,
+        .x = entry >> 32, .y = entry >> 40, .sp = entry >> 48,
+        .status = entry >> 56,
+    };
+}
+
+// Write the instructions in the ring to a file, oldest first
+void recorder_dump(const Recorder *rec, FILE *out) {
+    size_t count = recorder_count(rec);
+    fprintf(out, "last %zu instructions, oldest first:\n", count);
+    for(size_t i = 0; i < count; ++i) {
+        RecorderEntry entry = recorder_get(rec, i);
+        Instruction inst = decode(entry.opcode);
+        fprintf(out, "$%04X  %02X  %-3s %-12s  A=%02X X=%02X Y=%02X SP=%02X"
+                " P=%02X\n", entry.pc, entry.opcode,
+                inst.op == ERR ? "???" : operation_name(inst.op),
+                inst.mode == MODE_IMPLIED ? "" : mode_name(inst.mode),
+                entry.acc, entry.x, entry.y, entry.sp, entry.status);
+    }
+}
+
+// Mark the recorder of a processor as halted, dumping it the first time
+void recorder_halt(Processor *proc) {
+    Recorder *rec = proc->recorder;
+    if(rec->halted) return;
+    rec->halted = true;
+    if(rec->out == NULL) return;
+    fprintf(rec->out, "invalid opcode $%02X at $%04X\n", proc->opcode,
+            (uint16_t) (proc->pc - 1));
+    recorder_dump(rec, rec->out);
+}
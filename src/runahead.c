@@ -0,0 +1,106 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "runahead.h"
+#include "space.h"
+#include "processor.h"
+#include "cycles.h"
+
+// Set up run-ahead for a processor connected to an address space
+bool runahead_init(Runahead *ra, Processor *proc, AddressSpace *space,
+        uint64_t frame, uint32_t ahead, RunaheadHooks hooks, void *host) {
+    if(!(proc->features & FEATURE_CYCLES)) return false;
+    memset(ra, 0, sizeof(Runahead));
+    ra->proc = proc;
+    ra->space = space;
+    ra->frame = frame > 0 ? frame : 1;
+    ra->ahead = ahead;
+    ra->end = proc->cycles;
+    ra->hooks = hooks;
+    ra->host = host;
+    return true;
+}
+
+// Change the number of frames run ahead
+void runahead_set_ahead(Runahead *ra, uint32_t ahead) {
+    ra->ahead = ahead;
+}
+
+// Run the processor up to the end of the next frame, then let the host know.
+// Returns false if a call from the host returned first
+static bool run_frame(Runahead *ra, bool real, bool shown) {
+    Processor *proc = ra->proc;
+    ra->end += ra->frame;
+    while(proc->cycles < ra->end) {
+        uint64_t count = (ra->end - proc->cycles) / CYCLES_MAX;
+        if(count == 0) count = 1;
+        if(count > UINT32_MAX) count = UINT32_MAX;
+        if(processor_run(proc, count) == 0) return false;
+    }
+    if(ra->hooks.frame != NULL) ra->hooks.frame(ra->host, proc, real, shown);
+    return true;
+}
+
+// Snapshot the machine, devices included
+static void save(Runahead *ra) {
+    ra->saved = *ra->proc;
+    ra->saved_end = ra->end;
+    space_snapshot(ra->space, &ra->memory);
+    if(ra->hooks.save != NULL) ra->hooks.save(ra->host);
+}
+
+// Roll the machine back to the snapshot. Only the state of the processor is
+// restored, leaving its bus, hooks and features as the host last set them
+static void restore(Runahead *ra) {
+    Processor *proc = ra->proc;
+    const Processor *saved = &ra->saved;
+    proc->pc = saved->pc;
+    proc->x = saved->x;
+    proc->y = saved->y;
+    proc->acc = saved->acc;
+    proc->status = saved->status;
+    proc->sp = saved->sp;
+    proc->inst = saved->inst;
+    proc->opcode = saved->opcode;
+    proc->cycles = saved->cycles;
+    proc->call_pc = saved->call_pc;
+    proc->call_sp = saved->call_sp;
+    ra->end = ra->saved_end;
+    space_rollback(ra->space, &ra->memory);
+    if(ra->hooks.restore != NULL) ra->hooks.restore(ra->host);
+}
+
+// Run a real frame and then the frames ahead of it. The real frame is the
+// first one run ahead as well, as the input is the same for both
+bool runahead_frame(Runahead *ra) {
+    if(!run_frame(ra, true, ra->ahead == 0)) return false;
+    if(ra->ahead == 0) return true;
+    save(ra);
+    for(uint32_t i = 1; i <= ra->ahead; ++i)
+        if(!run_frame(ra, false, i == ra->ahead)) break;
+    restore(ra);
+    return true;
+}
+
+// Release the snapshot held by the run-ahead state
+void runahead_free(Runahead *ra) {
+    space_snapshot_free(&ra->memory);
+}
@@ -0,0 +1,148 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "savestate.h"
+#include "space.h"
+#include "processor.h"
+
+#define SAVESTATE_KINDS 36 // offset of the page kinds
+
+// Store a little-endian value of the given size, in bytes
+static void put(uint8_t *at, uint64_t value, int size) {
+    for(int i = 0; i < size; ++i) at[i] = value >> (8 * i);
+}
+
+// Load a little-endian value of the given size, in bytes
+static uint64_t get(const uint8_t *at, int size) {
+    uint64_t value = 0;
+    for(int i = 0; i < size; ++i) value |= (uint64_t) at[i] << (8 * i);
+    return value;
+}
+
+// Save the state of a processor and of its address space into a new file
+bool savestate_save(const char *path, const Processor *proc,
+        const AddressSpace *space) {
+    uint8_t header[SAVESTATE_MEMORY] = {0};
+    uint16_t pages = 0;
+    for(int i = 0; i < SPACE_PAGES; ++i) {
+        header[SAVESTATE_KINDS + i] = space->kind[i];
+        if(space->kind[i] != MAP_IO) ++pages;
+    }
+    memcpy(header, SAVESTATE_MAGIC, 8);
+    put(&header[8], SAVESTATE_VERSION, 4);
+    put(&header[12], pages, 2);
+    put(&header[14], proc->pc, 2);
+    header[16] = proc->acc;
+    header[17] = proc->x;
+    header[18] = proc->y;
+    header[19] = proc->sp;
+    header[20] = proc->status;
+    header[21] = proc->features;
+    put(&header[24], proc->cycles, 8);
+    put(&header[32], proc->fusion, 4);
+
+    FILE *file = fopen(path, "wb");
+    if(file == NULL) return false;
+    fwrite(header, sizeof(header), 1, file);
+    for(int i = 0; i < SPACE_PAGES; ++i)
+        if(space->kind[i] != MAP_IO)
+            fwrite(space->rmap[i], SPACE_PAGE_SIZE, 1, file);
+    bool ok = !ferror(file);
+    return fclose(file) == 0 && ok;
+}
+
+// Check that a mapped file is a savestate, holding all the memory it says
+static bool valid(const uint8_t *data, size_t size) {
+    if(size < SAVESTATE_MEMORY || memcmp(data, SAVESTATE_MAGIC, 8) != 0
+            || get(&data[8], 4) != SAVESTATE_VERSION) return false;
+    size_t pages = 0;
+    for(int i = 0; i < SPACE_PAGES; ++i) {
+        uint8_t kind = data[SAVESTATE_KINDS + i];
+        if(kind > MAP_RAM) return false;
+        if(kind != MAP_IO) ++pages;
+    }
+    return pages == get(&data[12], 2)
+        && size >= SAVESTATE_MEMORY + pages * SPACE_PAGE_SIZE;
+}
+
+// Open a savestate, mapping it into memory. Its pages are only read in from
+// disk as they are touched
+bool savestate_open(Savestate *state, const char *path) {
+    memset(state, 0, sizeof(Savestate));
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return false;
+    struct stat st;
+    void *map = MAP_FAILED;
+    if(fstat(fd, &st) == 0 && st.st_size >= SAVESTATE_MEMORY)
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) return false;
+    if(!valid(map, st.st_size)) {
+        munmap(map, st.st_size);
+        return false;
+    }
+    state->data = map;
+    state->size = st.st_size;
+    return true;
+}
+
+// Restore the state of a processor and the memory of its address space
+void savestate_load(const Savestate *state, Processor *proc,
+        AddressSpace *space) {
+    const uint8_t *data = state->data;
+    const uint8_t *page = data + SAVESTATE_MEMORY;
+    for(int i = 0; i < SPACE_PAGES; ++i) {
+        Map_kind kind = data[SAVESTATE_KINDS + i];
+        if(kind == MAP_IO) {
+            space_unmap(space, i, 1);
+            continue;
+        }
+        space_map_memory(space, i, page, 1, kind);
+        page += SPACE_PAGE_SIZE;
+    }
+
+    processor_set_features(proc, data[21]);
+    processor_set_fusion(proc, get(&data[32], 4));
+    proc->pc = get(&data[14], 2);
+    proc->acc = data[16];
+    proc->x = data[17];
+    proc->y = data[18];
+    proc->sp = data[19];
+    proc->status = data[20];
+    proc->cycles = get(&data[24], 8);
+    // Pending interrupts are raised now. The NMI goes last, so that its
+    // handler runs first, like it would on the real processor
+    if(data[22] & 1) processor_request(proc);
+    if(data[22] & 2) processor_interrupt(proc);
+}
+
+// Close a savestate, unmapping it from memory
+void savestate_close(Savestate *state) {
+    if(state->data != NULL) munmap((void *) state->data, state->size);
+    state->data = NULL;
+    state->size = 0;
+}
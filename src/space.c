@@ -0,0 +1,306 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "space.h"
+#include "processor.h"
+
+// Reference counted page of memory. The count is atomic because instances
+// that share pages may very well be running on different threads
+struct Page {
+    atomic_uint refs;
+    uint8_t data[SPACE_PAGE_SIZE];
+};
+
+// Get the page that contains the given page data
+static inline Page *page_of(const uint8_t *data) {
+    return (Page *) (data - offsetof(Page, data));
+}
+
+// Allocate a new page, with a single reference, and fill it with the given
+// data (or zeros, if it is NULL)
+static Page *page_create(const uint8_t *data, size_t size) {
+    Page *page = malloc(sizeof(Page));
+    if(page == NULL) return NULL;
+    atomic_init(&page->refs, 1);
+    memset(page->data, 0, SPACE_PAGE_SIZE);
+    if(data != NULL) memcpy(page->data, data, size);
+    return page;
+}
+
+// Take a new reference to a page
+static inline Page *page_share(Page *page) {
+    atomic_fetch_add_explicit(&page->refs, 1, memory_order_relaxed);
+    return page;
+}
+
+// Drop a reference to a page, freeing it if it was the last one
+static void page_release(Page *page) {
+    if(atomic_fetch_sub_explicit(&page->refs, 1, memory_order_acq_rel) == 1)
+        free(page);
+}
+
+// Create an image from the given data, which is copied into shared pages. The
+// last page is padded with zeros. Returns NULL on allocation failure
+Image *image_create(const uint8_t *data, size_t size) {
+    Image *image = malloc(sizeof(Image));
+    if(image == NULL) return NULL;
+    image->pages = (size + SPACE_PAGE_SIZE - 1) / SPACE_PAGE_SIZE;
+    image->page = calloc(image->pages ? image->pages : 1, sizeof(Page *));
+    if(image->page == NULL) {
+        free(image);
+        return NULL;
+    }
+    for(size_t i = 0; i < image->pages; ++i) {
+        size_t left = size - i * SPACE_PAGE_SIZE;
+        image->page[i] = page_create(data + i * SPACE_PAGE_SIZE,
+                left < SPACE_PAGE_SIZE ? left : SPACE_PAGE_SIZE);
+        if(image->page[i] == NULL) {
+            image_destroy(image);
+            return NULL;
+        }
+    }
+    return image;
+}
+
+// Destroy an image. Its pages live on for as long as they are mapped somewhere
+void image_destroy(Image *image) {
+    if(image == NULL) return;
+    for(size_t i = 0; i < image->pages; ++i)
+        if(image->page[i] != NULL) page_release(image->page[i]);
+    free(image->page);
+    free(image);
+}
+
+// Initialize an address space with all pages unmapped. Accesses to unmapped
+// pages are handled by the given callbacks, either of which may be NULL (in
+// which case reads return 0 and writes are ignored)
+void space_init(AddressSpace *space, AddrReader io_read, AddrWriter io_write,
+        void *io) {
+    memset(space, 0, sizeof(AddressSpace));
+    memset(space->dirty, 0xFF, sizeof(space->dirty)); // nothing seen yet
+    space->io_read = io_read;
+    space->io_write = io_write;
+    space->io = io;
+}
+
+// Unmap every page of an address space, releasing the memory it used
+void space_free(AddressSpace *space) {
+    space_unmap(space, 0, SPACE_PAGES);
+}
+
+// Mark a page as dirty
+static inline void mark_dirty(AddressSpace *space, uint8_t index) {
+    space->dirty[index >> 6] |= (uint64_t) 1 << (index & 63);
+}
+
+// Check whether a page is borrowed, rather than one of ours
+static inline bool borrowed(const AddressSpace *space, uint8_t index) {
+    return space->borrowed[index >> 6] & (uint64_t) 1 << (index & 63);
+}
+
+// Put a page in the given position of an address space, which takes over the
+// reference to it. RAM pages are only directly writable if not shared
+static void map(AddressSpace *space, uint8_t index, Page *page,
+        Map_kind kind) {
+    space_unmap(space, index, 1);
+    space->rmap[index] = page->data;
+    space->kind[index] = kind;
+    mark_dirty(space, index);
+    if(kind == MAP_RAM && atomic_load(&page->refs) == 1)
+        space->wmap[index] = page->data;
+}
+
+// Map fresh, zeroed and private RAM pages, starting at the given page.
+// Returns false on allocation failure
+bool space_map_ram(AddressSpace *space, uint8_t first, size_t count) {
+    for(size_t i = first; i < SPACE_PAGES && i < first + count; ++i) {
+        Page *page = page_create(NULL, 0);
+        if(page == NULL) return false;
+        map(space, i, page, MAP_RAM);
+    }
+    return true;
+}
+
+// Map the pages of an image, starting at the given page, as ROM or as RAM. In
+// the latter case, each page is copied on its first write
+void space_map_image(AddressSpace *space, const Image *image, uint8_t first,
+        Map_kind kind) {
+    for(size_t i = 0; i < image->pages && first + i < SPACE_PAGES; ++i)
+        map(space, first + i, page_share(image->page[i]), kind);
+}
+
+// Map memory that the space does not own, starting at the given page. It is
+// only ever read, so the write map is left empty
+void space_map_memory(AddressSpace *space, uint8_t first, const uint8_t *data,
+        size_t count, Map_kind kind) {
+    for(size_t i = 0; i < count && first + i < SPACE_PAGES; ++i) {
+        uint8_t index = first + i;
+        space_unmap(space, index, 1);
+        space->rmap[index] = data + i * SPACE_PAGE_SIZE;
+        space->kind[index] = kind;
+        space->borrowed[index >> 6] |= (uint64_t) 1 << (index & 63);
+        mark_dirty(space, index);
+    }
+}
+
+// Unmap pages, leaving them to the host callbacks
+void space_unmap(AddressSpace *space, uint8_t first, size_t count) {
+    for(size_t i = first; i < SPACE_PAGES && i < first + count; ++i) {
+        if(space->rmap[i] != NULL && !borrowed(space, i))
+            page_release(page_of(space->rmap[i]));
+        space->borrowed[i >> 6] &= ~((uint64_t) 1 << (i & 63));
+        space->rmap[i] = NULL;
+        space->wmap[i] = NULL;
+        space->kind[i] = MAP_IO;
+        mark_dirty(space, i);
+    }
+}
+
+// Mark a page as dirty. Writes through space_write do this by themselves, so
+// this is only needed when the host changes memory through the write map
+void space_mark_dirty(AddressSpace *space, uint8_t index) {
+    mark_dirty(space, index);
+}
+
+// Get the number of pages that are private to an address space (not shared)
+size_t space_private_pages(const AddressSpace *space) {
+    size_t count = 0;
+    for(size_t i = 0; i < SPACE_PAGES; ++i)
+        if(space->rmap[i] != NULL && !borrowed(space, i)
+            && atomic_load(&page_of(space->rmap[i])->refs) == 1) ++count;
+    return count;
+}
+
+// Check whether a page of a snapshot is borrowed
+static inline bool snapshot_borrowed(const SpaceSnapshot *snap, uint8_t index) {
+    return snap->borrowed[index >> 6] & (uint64_t) 1 << (index & 63);
+}
+
+// Take a snapshot of the memory of an address space. Every page gets a new
+// reference, so none of them is private anymore: the write map is cleared,
+// and the next write to each page copies it
+void space_snapshot(AddressSpace *space, SpaceSnapshot *snap) {
+    SpaceSnapshot old = *snap;
+    for(size_t i = 0; i < SPACE_PAGES; ++i) {
+        if(space->rmap[i] != NULL && !borrowed(space, i))
+            page_share(page_of(space->rmap[i]));
+        snap->rmap[i] = space->rmap[i];
+        snap->kind[i] = space->kind[i];
+        space->wmap[i] = NULL;
+    }
+    memcpy(snap->borrowed, space->borrowed, sizeof(snap->borrowed));
+    // Released last, as the old snapshot may share pages with the new one
+    space_snapshot_free(&old);
+}
+
+// Bring the memory of an address space back to a snapshot of it. A page that
+// was written to since was copied first, so pages that are still the same
+// ones have the same contents and are left alone
+void space_rollback(AddressSpace *space, const SpaceSnapshot *snap) {
+    for(size_t i = 0; i < SPACE_PAGES; ++i) {
+        if(space->rmap[i] == snap->rmap[i] && space->kind[i] == snap->kind[i]
+            && borrowed(space, i) == snapshot_borrowed(snap, i)) continue;
+        space_unmap(space, i, 1);
+        if(snap->rmap[i] == NULL) continue;
+        if(snapshot_borrowed(snap, i)) {
+            space->borrowed[i >> 6] |= (uint64_t) 1 << (i & 63);
+        } else {
+            // Shared with the snapshot, so not directly writable
+            page_share(page_of(snap->rmap[i]));
+        }
+        space->rmap[i] = snap->rmap[i];
+        space->kind[i] = snap->kind[i];
+    }
+}
+
+// Release the pages held by a snapshot, leaving it empty
+void space_snapshot_free(SpaceSnapshot *snap) {
+    for(size_t i = 0; i < SPACE_PAGES; ++i)
+        if(snap->rmap[i] != NULL && !snapshot_borrowed(snap, i))
+            page_release(page_of(snap->rmap[i]));
+    memset(snap, 0, sizeof(SpaceSnapshot));
+}
+
+// Read from an address space; suitable as an AddrReader
+uint8_t space_read(void *userdata, uint16_t addr) {
+    AddressSpace *space = userdata;
+    const uint8_t *data = space->rmap[PAGE_OF(addr)];
+    if(data != NULL) return data[OFFSET_OF(addr)];
+    return space->io_read != NULL ? space->io_read(space->io, addr) : 0;
+}
+
+// Make a RAM page private to an address space, copying it if it is shared
+// with others or borrowed (copy on write). Returns false on allocation failure
+static bool claim(AddressSpace *space, uint8_t index) {
+    if(borrowed(space, index)) {
+        Page *copy = page_create(space->rmap[index], SPACE_PAGE_SIZE);
+        if(copy == NULL) return false;
+        space->borrowed[index >> 6] &= ~((uint64_t) 1 << (index & 63));
+        space->rmap[index] = space->wmap[index] = copy->data;
+        return true;
+    }
+    Page *page = page_of(space->rmap[index]);
+    if(atomic_load_explicit(&page->refs, memory_order_acquire) > 1) {
+        // Somebody else may be looking at this page, make our own copy
+        Page *copy = page_create(page->data, SPACE_PAGE_SIZE);
+        if(copy == NULL) return false;
+        page_release(page);
+        page = copy;
+        space->rmap[index] = page->data;
+    }
+    space->wmap[index] = page->data;
+    return true;
+}
+
+// Write to an address space; suitable as an AddrWriter
+void space_write(void *userdata, uint16_t addr, uint8_t data) {
+    AddressSpace *space = userdata;
+    uint8_t index = PAGE_OF(addr);
+    uint8_t *page = space->wmap[index];
+    if(page != NULL) {
+        page[OFFSET_OF(addr)] = data;
+        mark_dirty(space, index);
+        return;
+    }
+    // Slow path: the page is either shared RAM, ROM or I/O
+    switch(space->kind[index]) {
+        case MAP_RAM:
+            if(!claim(space, index)) break;
+            space->wmap[index][OFFSET_OF(addr)] = data;
+            mark_dirty(space, index);
+            break;
+        case MAP_ROM:
+            // Writes to ROM are simply ignored
+            break;
+        case MAP_IO:
+            if(space->io_write != NULL) space->io_write(space->io, addr, data);
+            break;
+    }
+}
+
+// Initialize a processor connected to an address space
+void space_connect(AddressSpace *space, Processor *proc) {
+    processor_init(proc, space_read, space_write, space);
+}
@@ -0,0 +1,141 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "system.h"
+#include "space.h"
+#include "processor.h"
+#include "cycles.h"
+
+// Initialize a system with no processors
+void system_init(System *sys, uint32_t quantum, uint32_t tight) {
+    memset(sys, 0, sizeof(System));
+    sys->quantum = quantum > 0 ? quantum : 1;
+    sys->tight = tight > 0 && tight < sys->quantum ? tight : sys->quantum;
+    sys->window = sys->quantum;
+    sys->current = -1;
+}
+
+// Get the time of a processor of the system
+uint64_t system_time(const System *sys, int index) {
+    return sys->cpu[index].proc->cycles - sys->cpu[index].offset;
+}
+
+// Note an access to an address, tightening turns if it is shared
+static void touch(SystemCpu *cpu, uint16_t addr) {
+    System *sys = cpu->system;
+    uint8_t page = PAGE_OF(addr);
+    if(!(sys->shared[page >> 6] & (uint64_t) 1 << (page & 63))) return;
+    sys->touched = true;
+    sys->tight_until = system_time(sys, cpu - sys->cpu) + sys->window;
+}
+
+// Device reader of the processors: pass the access on to their devices
+static uint8_t cpu_read(void *userdata, uint16_t addr) {
+    SystemCpu *cpu = userdata;
+    touch(cpu, addr);
+    return cpu->io_read != NULL ? cpu->io_read(cpu->io, addr) : 0;
+}
+
+// Device writer of the processors: pass the access on to their devices
+static void cpu_write(void *userdata, uint16_t addr, uint8_t data) {
+    SystemCpu *cpu = userdata;
+    touch(cpu, addr);
+    if(cpu->io_write != NULL) cpu->io_write(cpu->io, addr, data);
+}
+
+// Add a processor, connected to an address space, to a system
+int system_add(System *sys, Processor *proc, AddressSpace *space) {
+    if(sys->count == SYSTEM_CPUS || !(proc->features & FEATURE_CYCLES))
+        return -1;
+    SystemCpu *cpu = &sys->cpu[sys->count];
+    cpu->system = sys;
+    cpu->proc = proc;
+    cpu->space = space;
+    cpu->offset = proc->cycles - sys->now;
+    cpu->io_read = space->io_read;
+    cpu->io_write = space->io_write;
+    cpu->io = space->io;
+    space->io_read = cpu_read;
+    space->io_write = cpu_write;
+    space->io = cpu;
+    return sys->count++;
+}
+
+// Mark pages as shared between the processors of a system
+void system_share(System *sys, uint8_t first, size_t count) {
+    for(size_t i = first; i < SPACE_PAGES && i < first + count; ++i)
+        sys->shared[i >> 6] |= (uint64_t) 1 << (i & 63);
+}
+
+// Give a processor its turn, running it up to the given time. When it
+// touches a shared region, its turn ends with the batch of instructions it
+// was running, and those of the processors after it in this round are cut
+// short; returns the time they run up to
+static uint64_t turn(System *sys, int index, uint64_t target) {
+    Processor *proc = sys->cpu[index].proc;
+    uint64_t time;
+    sys->current = index;
+    sys->touched = false;
+    while((time = system_time(sys, index)) < target) {
+        uint64_t count = (target - time) / CYCLES_MAX;
+        if(count == 0) count = 1;
+        if(count > UINT32_MAX) count = UINT32_MAX;
+        if(processor_run(proc, count) == 0) break; // a call returned
+        if(sys->touched && target > sys->now + sys->tight)
+            target = sys->now + sys->tight;
+    }
+    sys->current = -1;
+    return target;
+}
+
+// Run all processors for the given number of cycles
+uint64_t system_run(System *sys, uint64_t cycles) {
+    uint64_t end = sys->now + cycles;
+    if(sys->count == 0) return sys->now = end;
+    while(sys->now < end) {
+        uint64_t slice = sys->now < sys->tight_until
+            ? sys->tight : sys->quantum;
+        uint64_t target = sys->now + slice < end ? sys->now + slice : end;
+        for(int i = 0; i < sys->count; ++i) target = turn(sys, i, target);
+        uint64_t now = system_time(sys, 0);
+        for(int i = 1; i < sys->count; ++i) {
+            uint64_t time = system_time(sys, i);
+            if(time < now) now = time;
+        }
+        ++sys->rounds;
+        if(now == sys->now) break; // stuck in a call from the host
+        sys->now = now;
+    }
+    return sys->now;
+}
+
+// Remove all processors from a system, giving the devices back
+void system_free(System *sys) {
+    for(int i = 0; i < sys->count; ++i) {
+        SystemCpu *cpu = &sys->cpu[i];
+        cpu->space->io_read = cpu->io_read;
+        cpu->space->io_write = cpu->io_write;
+        cpu->space->io = cpu->io;
+    }
+    sys->count = 0;
+}
@@ -0,0 +1,186 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <time.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "thread.h"
+#include "processor.h"
+
+// How long the CPU thread sleeps between command checks while paused
+#define PAUSE_SLEEP_NS 100000
+
+// Publish a snapshot of the processor (CPU thread only)
+static void publish(CpuThread *thread) {
+    const Processor *proc = thread->proc;
+    uint64_t regs = (uint64_t) proc->pc << 48 | (uint64_t) proc->x << 40
+        | (uint64_t) proc->y << 32 | (uint64_t) proc->acc << 24
+        | (uint64_t) proc->status << 16 | (uint64_t) proc->sp << 8
+        | thread->paused;
+    // Being the only writer, the version can be bumped without a RMW
+    uint_fast32_t version = atomic_load_explicit(&thread->version,
+            memory_order_relaxed);
+    atomic_store_explicit(&thread->version, version + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&thread->words[0], regs, memory_order_relaxed);
+    atomic_store_explicit(&thread->words[1], proc->cycles,
+            memory_order_relaxed);
+    atomic_store_explicit(&thread->words[2], thread->instructions,
+            memory_order_relaxed);
+    atomic_store_explicit(&thread->version, version + 2, memory_order_release);
+}
+
+// Take the next command out of the queue, if any (CPU thread only)
+static bool receive(CpuThread *thread, Command *command) {
+    uint32_t slot = thread->head & (COMMAND_QUEUE_SIZE - 1);
+    uint_fast32_t seq = atomic_load_explicit(&thread->queue[slot].seq,
+            memory_order_acquire);
+    if(seq != thread->head + 1) return false; // empty
+    *command = thread->queue[slot].command;
+    // Free the slot for the producer that comes one lap later
+    atomic_store_explicit(&thread->queue[slot].seq,
+            thread->head + COMMAND_QUEUE_SIZE, memory_order_release);
+    ++thread->head;
+    return true;
+}
+
+// Carry out a command (CPU thread only)
+static void execute(CpuThread *thread, const Command *command) {
+    Processor *proc = thread->proc;
+    switch(command->kind) {
+        case COMMAND_IRQ:
+            processor_request(proc);
+            break;
+        case COMMAND_NMI:
+            processor_interrupt(proc);
+            break;
+        case COMMAND_POKE:
+            proc->write(proc->u, command->addr, command->data);
+            break;
+        case COMMAND_PAUSE:
+            thread->paused = true;
+            break;
+        case COMMAND_RESUME:
+            thread->paused = false;
+            break;
+        case COMMAND_SNAPSHOT:
+            publish(thread);
+            break;
+    }
+}
+
+// Main loop of the CPU thread
+static void *cpu_thread_main(void *arg) {
+    CpuThread *thread = arg;
+    const struct timespec nap = { .tv_sec = 0, .tv_nsec = PAUSE_SLEEP_NS };
+    while(!atomic_load_explicit(&thread->stop, memory_order_relaxed)) {
+        Command command;
+        bool any = false;
+        while(receive(thread, &command)) {
+            execute(thread, &command);
+            any = true;
+        }
+        if(thread->paused) {
+            if(any) publish(thread);
+            nanosleep(&nap, NULL);
+            continue;
+        }
+        thread->instructions += processor_run(thread->proc, thread->batch);
+        publish(thread);
+    }
+    return NULL;
+}
+
+// Start running a processor on a new thread, in batches of the given number
+// of instructions. The processor must not be touched until the thread is
+// stopped. Returns false if the thread could not be created
+bool cpu_thread_start(CpuThread *thread, Processor *proc, uint32_t batch) {
+    thread->proc = proc;
+    thread->batch = batch ? batch : 1;
+    for(uint32_t i = 0; i < COMMAND_QUEUE_SIZE; ++i)
+        atomic_init(&thread->queue[i].seq, i);
+    atomic_init(&thread->tail, 0);
+    thread->head = 0;
+    atomic_init(&thread->version, 0);
+    for(int i = 0; i < 3; ++i) atomic_init(&thread->words[i], 0);
+    atomic_init(&thread->stop, false);
+    thread->paused = false;
+    thread->instructions = 0;
+    publish(thread);
+    return pthread_create(&thread->thread, NULL, cpu_thread_main, thread) == 0;
+}
+
+// Stop the CPU thread and wait for it to finish. Commands still in the queue
+// are discarded
+void cpu_thread_stop(CpuThread *thread) {
+    atomic_store_explicit(&thread->stop, true, memory_order_relaxed);
+    pthread_join(thread->thread, NULL);
+}
+
+// Send a command to the CPU thread; safe to call from any number of threads.
+// Returns false if the queue is full
+bool cpu_thread_send(CpuThread *thread, Command command) {
+    uint_fast32_t tail = atomic_load_explicit(&thread->tail,
+            memory_order_relaxed);
+    for(;;) {
+        uint32_t slot = tail & (COMMAND_QUEUE_SIZE - 1);
+        uint_fast32_t seq = atomic_load_explicit(&thread->queue[slot].seq,
+                memory_order_acquire);
+        int32_t diff = (int32_t) (seq - tail);
+        if(diff < 0) return false; // full, the consumer is a lap behind
+        if(diff == 0 && atomic_compare_exchange_weak_explicit(&thread->tail,
+                &tail, tail + 1, memory_order_relaxed, memory_order_relaxed)) {
+            thread->queue[slot].command = command;
+            atomic_store_explicit(&thread->queue[slot].seq, tail + 1,
+                    memory_order_release);
+            return true;
+        }
+        // Another producer got there first; try again with the new tail
+        if(diff > 0) tail = atomic_load_explicit(&thread->tail,
+                memory_order_relaxed);
+    }
+}
+
+// Read the latest snapshot published by the CPU thread; safe to call from any
+// number of threads
+void cpu_thread_snapshot(CpuThread *thread, Snapshot *snapshot) {
+    uint_fast32_t before, after;
+    uint64_t words[3];
+    do {
+        before = atomic_load_explicit(&thread->version, memory_order_acquire);
+        for(int i = 0; i < 3; ++i)
+            words[i] = atomic_load_explicit(&thread->words[i],
+                    memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&thread->version, memory_order_relaxed);
+    } while(before != after || (before & 1));
+    snapshot->pc = words[0] >> 48;
+    snapshot->x = words[0] >> 40;
+    snapshot->y = words[0] >> 32;
+    snapshot->acc = words[0] >> 24;
+    snapshot->status = words[0] >> 16;
+    snapshot->sp = words[0] >> 8;
+    snapshot->paused = words[0] & 1;
+    snapshot->cycles = words[1];
+    snapshot->instructions = words[2];
+    // Each publication bumps the version twice
+    snapshot->sequence = before >> 1;
+}
@@ -0,0 +1,668 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "timing.h"
+#include "cycles.h"
+#include "decoder.h"
+#include "addressing.h"
+#include "definitions.h"
+
+#define ADDRESSES 0x10000
+#define NONE      (-1)
+#define RETURN    (-2)       // successor of the blocks that end the routine
+#define UNKNOWN   UINT64_MAX // distance to a block not reached yet
+
+// Bounds of a subroutine, kept so that it is only analyzed once
+typedef struct {
+    enum : uint8_t { ROUTINE_NEW = 0, ROUTINE_ACTIVE, ROUTINE_DONE } state;
+    uint64_t best, worst;
+} Routine;
+
+// State shared by the analysis of a routine and of all of its subroutines
+typedef struct {
+    const uint8_t *memory;
+    const TimingBound *bounds;
+    size_t count;
+    Routine *routines; // by entry point
+    Timing_error error;
+    uint16_t at;
+} Analysis;
+
+// Basic block: instructions that run in a row, only entered through the first
+// and only left through the last
+typedef struct {
+    uint16_t address, last;
+    uint64_t best, worst;      // taken by its instructions, including calls
+    int32_t next[2];           // successors, not taken and taken for branches
+    uint8_t extra[2];          // cycles taken by the branch to each of them
+    int32_t loop;              // innermost loop it is in
+    int32_t heads;             // loop it is the header of, if any
+    uint32_t order;            // position in reverse postorder
+    int32_t idom;              // immediate dominator
+    uint64_t best_to, worst_to; // distance from the start of its region
+    int32_t pred;              // block before it on the longest path there
+    uint64_t count, cycles;    // on the critical path
+} Block;
+
+// Way out of a loop (or back to its header), with the distance to it from
+// the header and the block or inner loop it is taken from
+typedef struct {
+    int32_t target, source;
+    uint64_t best, worst;
+} Exit;
+
+// Loop, or the routine itself as the outermost region, which is left only
+// through its returns
+typedef struct {
+    int32_t header, parent;
+    uint32_t min, max;
+    Exit iteration;
+    Exit *exits;
+    size_t count, capacity;
+} Loop;
+
+typedef struct {
+    Analysis *an;
+    uint64_t *seen, *leader; // bitmaps of the address space
+    uint16_t *code;          // addresses of the instructions found
+    size_t code_count, code_capacity;
+    uint16_t *starts;        // addresses of the blocks, sorted
+    Block *blocks;
+    size_t count;
+    int32_t *rpo;            // blocks in reverse postorder
+    int32_t *preds;          // predecessors of each block, pred_first apart
+    uint32_t *pred_first;
+    Loop *loops;             // innermost first, then the routine itself
+    size_t loop_count;
+    int32_t top;             // index of the routine among the loops
+} Graph;
+
+static bool fail(Analysis *an, Timing_error error, uint16_t at) {
+    if(an->error == TIMING_OK) {
+        an->error = error;
+        an->at = at;
+    }
+    return false;
+}
+
+#define TEST(map, addr) ((map)[(addr) >> 6] >> ((addr) & 63) & 1)
+#define MARK(map, addr) ((map)[(addr) >> 6] |= (uint64_t) 1 << ((addr) & 63))
+
+static inline uint16_t operand(const uint8_t *memory, uint16_t pc) {
+    return memory[(uint16_t) (pc + 1)]
+        | memory[(uint16_t) (pc + 2)] << 8;
+}
+
+static inline bool is_branch(Operation op) {
+    return op >= BEQ && op <= BVC;
+}
+
+// Target of the branch at the given address
+static inline uint16_t branch_target(const uint8_t *memory, uint16_t pc) {
+    return pc + 2 + (int8_t) memory[(uint16_t) (pc + 1)];
+}
+
+// Whether an instruction may take an extra cycle by crossing a page
+static bool may_cross(const uint8_t *memory, uint16_t pc, Instruction inst) {
+    switch(inst.op) {
+        case LDA: case LDX: case LDY: case AND: case EOR: case ORA:
+        case ADC: case SBC: case CMP:
+            break;
+        default:
+            return false;
+    }
+    switch(inst.mode) {
+        case MODE_ABSOLUTE_X:
+        case MODE_ABSOLUTE_Y:
+            // An index added to the start of a page stays in it
+            return (operand(memory, pc) & 0xFF) != 0;
+        case MODE_INDIRECT_Y:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool analyze(Analysis *an, uint16_t entry, Timing *timing);
+
+// Get the bounds of a subroutine, analyzing it the first time
+static bool call(Analysis *an, uint16_t entry, uint16_t pc,
+        uint64_t *best, uint64_t *worst) {
+    Routine *r = &an->routines[entry];
+    if(r->state == ROUTINE_ACTIVE) return fail(an, TIMING_RECURSIVE, pc);
+    if(r->state == ROUTINE_NEW && !analyze(an, entry, NULL)) return false;
+    *best += r->best;
+    *worst += r->worst;
+    return true;
+}
+
+static bool visit(Graph *g, uint16_t addr) {
+    if(TEST(g->seen, addr)) return true;
+    MARK(g->seen, addr);
+    if(g->code_count == g->code_capacity) {
+        size_t capacity = g->code_capacity ? 2 * g->code_capacity : 256;
+        uint16_t *grown = realloc(g->code, capacity * sizeof(uint16_t));
+        if(grown == NULL) return fail(g->an, TIMING_NO_MEMORY, addr);
+        g->code = grown;
+        g->code_capacity = capacity;
+    }
+    g->code[g->code_count++] = addr;
+    return true;
+}
+
+// Find the instructions of the routine, following the flow of control from
+// its entry point, and the ones that start blocks
+static bool discover(Graph *g, uint16_t entry) {
+    const uint8_t *memory = g->an->memory;
+    MARK(g->leader, entry);
+    if(!visit(g, entry)) return false;
+    // The instructions found so far double as the list of those to follow
+    for(size_t i = 0; i < g->code_count; ++i) {
+        uint16_t pc = g->code[i];
+        Instruction inst = decode(memory[pc]);
+        uint16_t next = pc + 1 + get_inc(inst.mode);
+        bool ok = true;
+        switch(inst.op) {
+            case ERR: case BRK:
+                return fail(g->an, TIMING_INVALID, pc);
+            case RTS: case RTI:
+                break;
+            case JMP:
+                if(inst.mode == MODE_INDIRECT)
+                    return fail(g->an, TIMING_INDIRECT, pc);
+                MARK(g->leader, operand(memory, pc));
+                ok = visit(g, operand(memory, pc));
+                break;
+            default:
+                if(is_branch(inst.op)) {
+                    uint16_t target = branch_target(memory, pc);
+                    MARK(g->leader, target);
+                    MARK(g->leader, next);
+                    ok = visit(g, target);
+                }
+                ok = ok && visit(g, next);
+                break;
+        }
+        if(!ok) return false;
+    }
+    return true;
+}
+
+static int compare_addresses(const void *a, const void *b) {
+    return *(const uint16_t *) a - *(const uint16_t *) b;
+}
+
+// Get the block that starts at the given address
+static int32_t block_at(const Graph *g, uint16_t addr) {
+    size_t low = 0, high = g->count;
+    while(low < high) {
+        size_t mid = (low + high) / 2;
+        if(g->starts[mid] < addr) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+// Split the instructions found into blocks, and cost them
+static bool build(Graph *g) {
+    Analysis *an = g->an;
+    const uint8_t *memory = an->memory;
+    qsort(g->code, g->code_count, sizeof(uint16_t), compare_addresses);
+    g->starts = malloc(g->code_count * sizeof(uint16_t));
+    g->blocks = calloc(g->code_count, sizeof(Block));
+    if(g->starts == NULL || g->blocks == NULL)
+        return fail(an, TIMING_NO_MEMORY, g->code[0]);
+    for(size_t i = 0; i < g->code_count; ++i)
+        if(TEST(g->leader, g->code[i])) g->starts[g->count++] = g->code[i];
+
+    for(size_t i = 0; i < g->count; ++i) {
+        Block *b = &g->blocks[i];
+        b->address = g->starts[i];
+        b->next[0] = b->next[1] = NONE;
+        b->loop = b->heads = b->pred = NONE;
+        uint16_t pc = b->address;
+        for(;;) {
+            Instruction inst = decode(memory[pc]);
+            uint16_t next = pc + 1 + get_inc(inst.mode);
+            b->best += cycle_table[memory[pc]];
+            b->worst += cycle_table[memory[pc]] + may_cross(memory, pc, inst);
+            b->last = pc;
+            if(inst.op == JSR
+                    && !call(an, operand(memory, pc), pc, &b->best, &b->worst))
+                return false;
+            if(inst.op == RTS || inst.op == RTI) {
+                b->next[0] = RETURN;
+                break;
+            }
+            if(inst.op == JMP) {
+                b->next[0] = block_at(g, operand(memory, pc));
+                break;
+            }
+            if(is_branch(inst.op)) {
+                uint16_t target = branch_target(memory, pc);
+                b->next[0] = block_at(g, next);
+                b->next[1] = block_at(g, target);
+                b->extra[1] = (target ^ next) & 0xFF00 ? 2 : 1;
+                break;
+            }
+            if(TEST(g->leader, next)) {
+                b->next[0] = block_at(g, next);
+                break;
+            }
+            pc = next;
+        }
+    }
+    return true;
+}
+
+// Order the blocks in reverse postorder, and find their predecessors
+static bool order(Graph *g) {
+    g->rpo = malloc(g->count * sizeof(int32_t));
+    g->preds = malloc(2 * g->count * sizeof(int32_t));
+    g->pred_first = calloc(g->count + 1, sizeof(uint32_t));
+    int32_t *stack = malloc(g->count * sizeof(int32_t));
+    uint8_t *state = calloc(g->count, 1); // successors pushed so far, plus 1
+    bool ok = g->rpo && g->preds && g->pred_first && stack && state;
+    if(!ok) {
+        free(stack);
+        free(state);
+        return fail(g->an, TIMING_NO_MEMORY, g->blocks[0].address);
+    }
+
+    size_t top = 0, done = g->count;
+    stack[top++] = 0;
+    state[0] = 1;
+    while(top > 0) {
+        int32_t n = stack[top - 1];
+        Block *b = &g->blocks[n];
+        if(state[n] == 3) {
+            g->rpo[--done] = n;
+            --top;
+            continue;
+        }
+        int32_t s = b->next[state[n]++ - 1];
+        if(s >= 0 && state[s] == 0) {
+            state[s] = 1;
+            stack[top++] = s;
+        }
+    }
+    for(size_t i = 0; i < g->count; ++i) g->blocks[g->rpo[i]].order = i;
+
+    for(size_t n = 0; n < g->count; ++n)
+        for(int k = 0; k < 2; ++k)
+            if(g->blocks[n].next[k] >= 0) ++g->pred_first[g->blocks[n].next[k]];
+    for(size_t n = 0; n < g->count; ++n)
+        g->pred_first[n + 1] += g->pred_first[n];
+    for(size_t n = 0; n < g->count; ++n)
+        for(int k = 0; k < 2; ++k)
+            if(g->blocks[n].next[k] >= 0)
+                g->preds[--g->pred_first[g->blocks[n].next[k]]] = n;
+    free(stack);
+    free(state);
+    return true;
+}
+
+// Find the immediate dominator of each block
+static void dominate(Graph *g) {
+    Block *blocks = g->blocks;
+    for(size_t n = 0; n < g->count; ++n) blocks[n].idom = NONE;
+    blocks[0].idom = 0;
+    bool changed = true;
+    while(changed) {
+        changed = false;
+        for(size_t i = 1; i < g->count; ++i) {
+            int32_t n = g->rpo[i], idom = NONE;
+            for(uint32_t j = g->pred_first[n]; j < g->pred_first[n + 1]; ++j) {
+                int32_t p = g->preds[j];
+                if(blocks[p].idom == NONE) continue;
+                if(idom == NONE) {
+                    idom = p;
+                    continue;
+                }
+                while(p != idom) {
+                    while(blocks[p].order > blocks[idom].order)
+                        p = blocks[p].idom;
+                    while(blocks[idom].order > blocks[p].order)
+                        idom = blocks[idom].idom;
+                }
+            }
+            if(blocks[n].idom != idom) {
+                blocks[n].idom = idom;
+                changed = true;
+            }
+        }
+    }
+}
+
+static bool dominates(const Graph *g, int32_t d, int32_t n) {
+    while(n != d && n != 0) n = g->blocks[n].idom;
+    return n == d;
+}
+
+// Outermost loop the given block is in so far, found while nesting them
+static int32_t outermost(const Graph *g, int32_t n) {
+    int32_t loop = g->blocks[n].loop;
+    if(loop != NONE)
+        while(g->loops[loop].parent != NONE) loop = g->loops[loop].parent;
+    return loop;
+}
+
+// Find the loops, and which blocks are in each of them. Headers come later in
+// reverse postorder than those of the loops they are nested in, so going
+// backwards finds inner loops first
+static bool nest(Graph *g) {
+    Analysis *an = g->an;
+    Block *blocks = g->blocks;
+    g->loops = calloc(g->count + 1, sizeof(Loop));
+    int32_t *pending = malloc(2 * g->count * sizeof(int32_t)); // per edge
+    if(g->loops == NULL || pending == NULL) {
+        free(pending);
+        return fail(an, TIMING_NO_MEMORY, blocks[0].address);
+    }
+    for(size_t i = g->count; i-- > 0;) {
+        int32_t h = g->rpo[i];
+        size_t top = 0;
+        for(uint32_t j = g->pred_first[h]; j < g->pred_first[h + 1]; ++j) {
+            int32_t p = g->preds[j];
+            if(blocks[p].order < blocks[h].order) continue;
+            if(!dominates(g, h, p)) {
+                free(pending);
+                return fail(an, TIMING_IRREDUCIBLE, blocks[h].address);
+            }
+            pending[top++] = p;
+        }
+        if(top == 0) continue;
+
+        int32_t loop = g->loop_count++;
+        Loop *l = &g->loops[loop];
+        *l = (Loop) { .header = h, .parent = NONE };
+        size_t b;
+        for(b = 0; b < an->count; ++b)
+            if(an->bounds[b].address == blocks[h].address) break;
+        if(b == an->count || an->bounds[b].max == 0) {
+            free(pending);
+            return fail(an, TIMING_UNBOUNDED, blocks[h].address);
+        }
+        l->max = an->bounds[b].max;
+        l->min = an->bounds[b].min == 0 ? 1 : an->bounds[b].min;
+        if(l->min > l->max) l->min = l->max;
+        blocks[h].loop = blocks[h].heads = loop;
+
+        while(top > 0) {
+            int32_t n = pending[--top], inner = outermost(g, n);
+            if(inner == loop) continue;
+            if(inner == NONE) {
+                blocks[n].loop = loop;
+            } else {
+                // Take in the whole inner loop, through its header
+                g->loops[inner].parent = loop;
+                n = g->loops[inner].header;
+            }
+            for(uint32_t j = g->pred_first[n]; j < g->pred_first[n + 1]; ++j)
+                if(outermost(g, g->preds[j]) != loop)
+                    pending[top++] = g->preds[j];
+        }
+    }
+    free(pending);
+
+    g->top = g->loop_count;
+    g->loops[g->top] = (Loop) { .header = NONE, .parent = NONE };
+    for(size_t i = 0; i < g->loop_count; ++i)
+        if(g->loops[i].parent == NONE) g->loops[i].parent = g->top;
+    for(size_t n = 0; n < g->count; ++n)
+        if(blocks[n].loop == NONE) blocks[n].loop = g->top;
+    return true;
+}
+
+// Whether a block is in a loop (or in a loop nested in it)
+static bool inside(const Graph *g, int32_t loop, int32_t n) {
+    for(int32_t l = g->blocks[n].loop; l != g->top; l = g->loops[l].parent)
+        if(l == loop) return true;
+    return loop == g->top;
+}
+
+// Take the given distances to a successor of a block (or inner loop) of a
+// loop, which is either a way out of it, back to its header or within it
+static bool reach(Graph *g, int32_t loop, int32_t source, int32_t target,
+        uint64_t best, uint64_t worst) {
+    Loop *l = &g->loops[loop];
+    Exit *e = NULL;
+    if(target == l->header) {
+        e = &l->iteration;
+    } else if(target == RETURN || !inside(g, loop, target)) {
+        for(size_t i = 0; i < l->count && e == NULL; ++i)
+            if(l->exits[i].target == target) e = &l->exits[i];
+        if(e == NULL) {
+            if(l->count == l->capacity) {
+                size_t capacity = l->capacity ? 2 * l->capacity : 4;
+                Exit *grown = realloc(l->exits, capacity * sizeof(Exit));
+                if(grown == NULL)
+                    return fail(g->an, TIMING_NO_MEMORY,
+                            g->blocks[source].address);
+                l->exits = grown;
+                l->capacity = capacity;
+            }
+            e = &l->exits[l->count++];
+            *e = (Exit) { target, NONE, UNKNOWN, 0 };
+        }
+    } else {
+        Block *b = &g->blocks[target];
+        if(b->worst_to == UNKNOWN || worst > b->worst_to) {
+            b->worst_to = worst;
+            b->pred = source;
+        }
+        if(best < b->best_to) b->best_to = best;
+        return true;
+    }
+    if(e->source == NONE || worst > e->worst) {
+        e->worst = worst;
+        e->source = source;
+    }
+    if(best < e->best) e->best = best;
+    return true;
+}
+
+// Find the longest and shortest paths from the header of a loop to the ways
+// out of it, through one iteration at most, with the loops nested in it
+// already reduced to their own ways out. Then account for the iterations
+static bool reduce(Graph *g, int32_t loop) {
+    Loop *l = &g->loops[loop];
+    int32_t start = loop == g->top ? 0 : l->header;
+    for(size_t n = 0; n < g->count; ++n)
+        g->blocks[n].best_to = g->blocks[n].worst_to = UNKNOWN;
+    g->blocks[start].best_to = g->blocks[start].worst_to = 0;
+    l->iteration = (Exit) { l->header, NONE, UNKNOWN, 0 };
+
+    for(size_t i = g->blocks[start].order; i < g->count; ++i) {
+        int32_t n = g->rpo[i];
+        Block *b = &g->blocks[n];
+        if(b->worst_to == UNKNOWN) continue;
+        int32_t inner = b->heads;
+        if(inner != NONE && inner != loop && g->loops[inner].parent == loop) {
+            Loop *in = &g->loops[inner];
+            for(size_t j = 0; j < in->count; ++j) {
+                Exit *e = &in->exits[j];
+                if(!reach(g, loop, n, e->target,
+                            b->best_to + e->best, b->worst_to + e->worst))
+                    return false;
+            }
+        } else if(b->loop == loop) {
+            for(int k = 0; k < 2; ++k) {
+                if(b->next[k] == NONE) continue;
+                if(!reach(g, loop, n, b->next[k],
+                            b->best_to + b->best + b->extra[k],
+                            b->worst_to + b->worst + b->extra[k]))
+                    return false;
+            }
+        }
+    }
+
+    if(loop == g->top) return true;
+    uint64_t best = l->iteration.source == NONE ? 0 : l->iteration.best;
+    uint64_t worst = l->iteration.source == NONE ? 0 : l->iteration.worst;
+    for(size_t j = 0; j < l->count; ++j) {
+        l->exits[j].best += (l->min - 1) * best;
+        l->exits[j].worst += (l->max - 1) * worst;
+    }
+    return true;
+}
+
+static void expand(Graph *g, int32_t loop, int32_t target, uint64_t times);
+
+// Cycles taken by a block on the way to the given successor
+static uint64_t cost_to(const Block *b, int32_t target) {
+    uint8_t extra = 0;
+    for(int k = 0; k < 2; ++k)
+        if(b->next[k] == target && b->extra[k] > extra) extra = b->extra[k];
+    return b->worst + extra;
+}
+
+// Walk back the longest path within a loop, from the given block (or inner
+// loop) and on to the given target, counting it the given number of times
+static void walk(Graph *g, int32_t loop, int32_t n, int32_t target,
+        uint64_t times) {
+    int32_t start = loop == g->top ? 0 : g->loops[loop].header;
+    for(;;) {
+        Block *b = &g->blocks[n];
+        int32_t inner = b->heads;
+        if(inner != NONE && inner != loop && g->loops[inner].parent == loop) {
+            expand(g, inner, target, times);
+        } else {
+            b->count += times;
+            b->cycles += times * cost_to(b, target);
+        }
+        if(n == start) break;
+        target = n;
+        n = b->pred;
+    }
+}
+
+// Count the longest path through a loop to the given way out of it: all but
+// the last iteration go back to the header
+static void expand(Graph *g, int32_t loop, int32_t target, uint64_t times) {
+    Loop *l = &g->loops[loop];
+    for(size_t j = 0; j < l->count; ++j)
+        if(l->exits[j].target == target)
+            walk(g, loop, l->exits[j].source, target, times);
+    if(l->max > 1 && l->iteration.source != NONE)
+        walk(g, loop, l->iteration.source, l->header, times * (l->max - 1));
+}
+
+// Write down the critical path of the routine
+static bool trace(Graph *g, Timing *timing) {
+    walk(g, g->top, g->loops[g->top].exits[0].source, RETURN, 1);
+    size_t length = 0;
+    for(size_t n = 0; n < g->count; ++n) length += g->blocks[n].count > 0;
+    timing->path = malloc(length * sizeof(TimingStep));
+    if(timing->path == NULL)
+        return fail(g->an, TIMING_NO_MEMORY, g->blocks[0].address);
+    for(size_t i = 0; i < g->count; ++i) {
+        Block *b = &g->blocks[g->rpo[i]];
+        if(b->count == 0) continue;
+        timing->path[timing->length++] = (TimingStep) {
+            b->address, b->last, b->count, b->cycles,
+        };
+    }
+    return true;
+}
+
+static void graph_free(Graph *g) {
+    free(g->seen);
+    free(g->leader);
+    free(g->code);
+    free(g->starts);
+    free(g->blocks);
+    free(g->rpo);
+    free(g->preds);
+    free(g->pred_first);
+    if(g->loops != NULL)
+        for(size_t i = 0; i <= g->loop_count; ++i) free(g->loops[i].exits);
+    free(g->loops);
+}
+
+// Analyze a routine, filling in its critical path if a result is given
+static bool analyze(Analysis *an, uint16_t entry, Timing *timing) {
+    Routine *r = &an->routines[entry];
+    r->state = ROUTINE_ACTIVE;
+    Graph g = { .an = an };
+    g.seen = calloc(ADDRESSES / 64, sizeof(uint64_t));
+    g.leader = calloc(ADDRESSES / 64, sizeof(uint64_t));
+    bool ok = g.seen != NULL && g.leader != NULL
+        ? discover(&g, entry) && build(&g) && order(&g)
+        : fail(an, TIMING_NO_MEMORY, entry);
+    if(ok) {
+        dominate(&g);
+        ok = nest(&g);
+    }
+    for(size_t i = 0; ok && i <= g.loop_count; ++i) ok = reduce(&g, i);
+    if(ok && g.loops[g.top].count == 0) ok = fail(an, TIMING_NO_RETURN, entry);
+    if(ok) {
+        r->best = g.loops[g.top].exits[0].best;
+        r->worst = g.loops[g.top].exits[0].worst;
+        r->state = ROUTINE_DONE;
+        if(timing != NULL) ok = trace(&g, timing);
+    }
+    graph_free(&g);
+    return ok;
+}
+
+// Analyze the routine at the given entry point of a memory image
+bool timing_analyze(Timing *timing, const uint8_t *memory, uint16_t entry,
+        const TimingBound *bounds, size_t count) {
+    *timing = (Timing) { 0 };
+    Analysis an = { .memory = memory, .bounds = bounds, .count = count };
+    an.routines = calloc(ADDRESSES, sizeof(Routine));
+    bool ok = an.routines != NULL
+        ? analyze(&an, entry, timing)
+        : fail(&an, TIMING_NO_MEMORY, entry);
+    if(ok) {
+        timing->best = an.routines[entry].best;
+        timing->worst = an.routines[entry].worst;
+    }
+    timing->error = an.error;
+    timing->at = an.at;
+    free(an.routines);
+    return ok;
+}
+
+// Free the critical path of an analysis
+void timing_free(Timing *timing) {
+    free(timing->path);
+    timing->path = NULL;
+    timing->length = 0;
+}
+
+// Get a description of an error
+const char *timing_error_name(Timing_error error) {
+    switch(error) {
+        case TIMING_OK:          return "no error";
+        case TIMING_UNBOUNDED:   return "loop without bounds";
+        case TIMING_IRREDUCIBLE: return "loop entered past its header";
+        case TIMING_INDIRECT:    return "indirect jump";
+        case TIMING_INVALID:     return "invalid opcode or BRK";
+        case TIMING_RECURSIVE:   return "recursive subroutine";
+        case TIMING_NO_RETURN:   return "routine that never returns";
+        case TIMING_NO_MEMORY:   return "out of memory";
+    }
+    return "unknown error";
+}
@@ -0,0 +1,363 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "vectors.h"
+#include "processor.h"
+
+// Sparse memory of a vector being generated or run, with a log of the bus
+// accesses. Cells hold the current value of each byte in their after field
+typedef struct {
+    enum { BUS_IDLE, BUS_GENERATE, BUS_CHECK } mode;
+    VectorCell cell[VECTOR_CELLS];
+    VectorAccess access[VECTOR_ACCESSES];
+    uint8_t cells, accesses;
+    bool overflow; // more cells or accesses than fit in a vector
+    bool stray;    // access to memory that is not part of the vector
+    uint64_t *seed;
+} Bus;
+
+// Pseudo-random byte (xorshift64*)
+static uint8_t random_byte(uint64_t *seed) {
+    if(*seed == 0) *seed = 0x9E3779B97F4A7C15ULL;
+    *seed ^= *seed >> 12;
+    *seed ^= *seed << 25;
+    *seed ^= *seed >> 27;
+    return (*seed * 0x2545F4914F6CDD1DULL) >> 56;
+}
+
+// Find the cell for an address. When generating, memory that was not touched
+// yet gets a random value; when checking, touching it is a failure
+static VectorCell *cell_at(Bus *bus, uint16_t addr) {
+    for(uint8_t i = 0; i < bus->cells; ++i)
+        if(bus->cell[i].addr == addr) return &bus->cell[i];
+    if(bus->mode != BUS_GENERATE) {
+        bus->stray = true;
+        return NULL;
+    }
+    if(bus->cells == VECTOR_CELLS) {
+        bus->overflow = true;
+        return NULL;
+    }
+    VectorCell *cell = &bus->cell[bus->cells++];
+    cell->addr = addr;
+    cell->before = cell->after = random_byte(bus->seed);
+    return cell;
+}
+
+// Record an access to the bus
+static void log_access(Bus *bus, uint16_t addr, uint8_t data,
+        Access_kind kind) {
+    if(bus->accesses == VECTOR_ACCESSES) {
+        bus->overflow = true;
+        return;
+    }
+    bus->access[bus->accesses++] = (VectorAccess) { addr, data, kind };
+}
+
+static uint8_t bus_read(void *userdata, uint16_t addr) {
+    Bus *bus = userdata;
+    if(bus->mode == BUS_IDLE) return 0;
+    VectorCell *cell = cell_at(bus, addr);
+    uint8_t data = cell != NULL ? cell->after : 0;
+    log_access(bus, addr, data, ACCESS_READ);
+    return data;
+}
+
+static void bus_write(void *userdata, uint16_t addr, uint8_t data) {
+    Bus *bus = userdata;
+    if(bus->mode == BUS_IDLE) return;
+    VectorCell *cell = cell_at(bus, addr);
+    if(cell != NULL) cell->after = data;
+    log_access(bus, addr, data, ACCESS_WRITE);
+}
+
+// Get and set the registers of a processor
+static VectorRegisters get_registers(const Processor *proc) {
+    return (VectorRegisters) { proc->pc, proc->acc, proc->x, proc->y,
+        proc->sp, proc->status };
+}
+
+static void set_registers(Processor *proc, const VectorRegisters *regs) {
+    proc->pc = regs->pc;
+    proc->acc = regs->acc;
+    proc->x = regs->x;
+    proc->y = regs->y;
+    proc->sp = regs->sp;
+    proc->status = regs->status;
+}
+
+static bool same_registers(const VectorRegisters *a,
+        const VectorRegisters *b) {
+    return a->pc == b->pc && a->acc == b->acc && a->x == b->x
+        && a->y == b->y && a->sp == b->sp && a->status == b->status;
+}
+
+// Generate a vector for an opcode, by running it on the reference core
+bool vector_generate(Vector *vector, uint8_t opcode, uint64_t *seed) {
+    Bus bus = { .mode = BUS_IDLE, .seed = seed };
+    Processor proc;
+    processor_init(&proc, bus_read, bus_write, &bus);
+
+    // Random registers; the break and nil bits of the status register are
+    // always set, as they are after a reset
+    memset(vector, 0, sizeof(Vector));
+    vector->initial.pc = random_byte(seed) | random_byte(seed) << 8;
+    vector->initial.acc = random_byte(seed);
+    vector->initial.x = random_byte(seed);
+    vector->initial.y = random_byte(seed);
+    vector->initial.sp = random_byte(seed);
+    vector->initial.status = random_byte(seed) | FLAG_BREAK | FLAG_NIL;
+    set_registers(&proc, &vector->initial);
+    bus.mode = BUS_GENERATE;
+    bus.cells = 1;
+    bus.cell[0] = (VectorCell) { vector->initial.pc, opcode, opcode };
+
+    processor_step(&proc);
+    if(bus.overflow) return false;
+    vector->final = get_registers(&proc);
+    vector->cycles = proc.cycles;
+    vector->cells = bus.cells;
+    vector->accesses = bus.accesses;
+    memcpy(vector->cell, bus.cell, sizeof(bus.cell));
+    memcpy(vector->access, bus.access, sizeof(bus.access));
+    return true;
+}
+
+// Run a vector on a processor, leaving what happened in the bus
+static void run(const Vector *vector, Processor *proc, Bus *bus) {
+    memset(bus, 0, sizeof(Bus));
+    bus->mode = BUS_CHECK;
+    bus->cells = vector->cells;
+    for(uint8_t i = 0; i < vector->cells; ++i) {
+        bus->cell[i] = vector->cell[i];
+        bus->cell[i].after = bus->cell[i].before;
+    }
+    proc->read = bus_read;
+    proc->write = bus_write;
+    proc->u = bus;
+    // Switch to the run loop for this bus, keeping the features as they are
+    processor_set_features(proc, proc->features);
+    proc->cycles = 0;
+    set_registers(proc, &vector->initial);
+    processor_run(proc, 1);
+}
+
+// Check the outcome of running a vector
+static bool passes(const Vector *vector, const Processor *proc,
+        const Bus *bus, uint8_t checks) {
+    VectorRegisters final = get_registers(proc);
+    if(bus->stray || bus->overflow) return false;
+    if(!same_registers(&final, &vector->final)) return false;
+    for(uint8_t i = 0; i < vector->cells; ++i)
+        if(bus->cell[i].after != vector->cell[i].after) return false;
+    if((checks & CHECK_CYCLES) && (proc->features & FEATURE_CYCLES)
+            && proc->cycles != vector->cycles) return false;
+    if(checks & CHECK_BUS) {
+        if(bus->accesses != vector->accesses) return false;
+        for(uint8_t i = 0; i < bus->accesses; ++i) {
+            const VectorAccess *a = &bus->access[i], *b = &vector->access[i];
+            if(a->addr != b->addr || a->data != b->data || a->kind != b->kind)
+                return false;
+        }
+    }
+    return true;
+}
+
+// Run a vector on a processor. Returns true if the vector passes
+bool vector_run(const Vector *vector, Processor *proc, uint8_t checks) {
+    Bus bus;
+    run(vector, proc, &bus);
+    return passes(vector, proc, &bus, checks);
+}
+
+static void print_registers(FILE *out, const char *label,
+        const VectorRegisters *regs, uint64_t cycles) {
+    fprintf(out, "  %-9s pc=%04X a=%02X x=%02X y=%02X sp=%02X p=%02X"
+            " cycles=%llu\n", label, regs->pc, regs->acc, regs->x, regs->y,
+            regs->sp, regs->status, (unsigned long long) cycles);
+}
+
+static void print_bus(FILE *out, const char *label, const VectorCell *cell,
+        uint8_t cells, const VectorAccess *access, uint8_t accesses) {
+    fprintf(out, "  %-9s memory:", label);
+    for(uint8_t i = 0; i < cells; ++i)
+        fprintf(out, " %04X=%02X", cell[i].addr, cell[i].after);
+    fprintf(out, "\n  %-9s bus:   ", "");
+    for(uint8_t i = 0; i < accesses; ++i)
+        fprintf(out, " %c%04X=%02X", access[i].kind == ACCESS_READ ? 'r' : 'w',
+                access[i].addr, access[i].data);
+    fprintf(out, "\n");
+}
+
+// Run a vector, printing what it expects and what the processor did instead
+void vector_explain(FILE *out, const Vector *vector, Processor *proc) {
+    Bus bus;
+    run(vector, proc, &bus);
+    VectorRegisters final = get_registers(proc);
+    fprintf(out, "opcode %02X at %04X\n", vector->cell[0].before,
+            vector->initial.pc);
+    print_registers(out, "initial:", &vector->initial, 0);
+    print_registers(out, "expected:", &vector->final, vector->cycles);
+    print_bus(out, "", vector->cell, vector->cells, vector->access,
+            vector->accesses);
+    print_registers(out, "got:", &final, proc->cycles);
+    print_bus(out, "", bus.cell, bus.cells, bus.access, bus.accesses);
+    if(bus.stray) fprintf(out, "  memory outside of the vector was touched\n");
+    if(bus.overflow) fprintf(out, "  too many bus accesses\n");
+}
+
+// Little-endian helpers for the binary format
+static inline void put16(uint8_t *p, uint16_t w) {
+    p[0] = w & 0xFF;
+    p[1] = w >> 8;
+}
+
+static inline uint16_t get16(const uint8_t *p) {
+    return p[0] | p[1] << 8;
+}
+
+static inline void put32(uint8_t *p, uint32_t w) {
+    put16(p, w & 0xFFFF);
+    put16(p + 2, w >> 16);
+}
+
+static inline uint32_t get32(const uint8_t *p) {
+    return get16(p) | (uint32_t) get16(p + 2) << 16;
+}
+
+static void encode_registers(const VectorRegisters *regs, uint8_t *p) {
+    put16(p, regs->pc);
+    p[2] = regs->acc;
+    p[3] = regs->x;
+    p[4] = regs->y;
+    p[5] = regs->sp;
+    p[6] = regs->status;
+    p[7] = 0;
+}
+
+static void decode_registers(VectorRegisters *regs, const uint8_t *p) {
+    regs->pc = get16(p);
+    regs->acc = p[2];
+    regs->x = p[3];
+    regs->y = p[4];
+    regs->sp = p[5];
+    regs->status = p[6];
+}
+
+// Serialize a vector into a record
+void vector_encode(const Vector *vector, uint8_t record[VECTOR_SIZE]) {
+    memset(record, 0, VECTOR_SIZE);
+    encode_registers(&vector->initial, record);
+    encode_registers(&vector->final, record + 8);
+    put16(record + 16, vector->cycles);
+    record[18] = vector->cells;
+    record[19] = vector->accesses;
+    uint8_t *p = record + 20;
+    for(uint8_t i = 0; i < vector->cells; ++i, p += 4) {
+        put16(p, vector->cell[i].addr);
+        p[2] = vector->cell[i].before;
+        p[3] = vector->cell[i].after;
+    }
+    p = record + 20 + 4 * VECTOR_CELLS;
+    for(uint8_t i = 0; i < vector->accesses; ++i, p += 4) {
+        put16(p, vector->access[i].addr);
+        p[2] = vector->access[i].data;
+        p[3] = vector->access[i].kind;
+    }
+}
+
+// Deserialize a vector from a record. Counts that are out of range are
+// clamped, so that corrupted records just fail to pass
+void vector_decode(Vector *vector, const uint8_t record[VECTOR_SIZE]) {
+    decode_registers(&vector->initial, record);
+    decode_registers(&vector->final, record + 8);
+    vector->cycles = get16(record + 16);
+    vector->cells = record[18] <= VECTOR_CELLS ? record[18] : VECTOR_CELLS;
+    vector->accesses = record[19] <= VECTOR_ACCESSES ? record[19]
+        : VECTOR_ACCESSES;
+    const uint8_t *p = record + 20;
+    for(uint8_t i = 0; i < VECTOR_CELLS; ++i, p += 4)
+        vector->cell[i] = (VectorCell) { get16(p), p[2], p[3] };
+    p = record + 20 + 4 * VECTOR_CELLS;
+    for(uint8_t i = 0; i < VECTOR_ACCESSES; ++i, p += 4)
+        vector->access[i] = (VectorAccess) { get16(p), p[2], p[3] };
+}
+
+// Open a file of vectors, checking its header
+bool vector_file_open(VectorFile *file, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return false;
+    struct stat st;
+    void *map = MAP_FAILED;
+    if(fstat(fd, &st) == 0 && st.st_size >= VECTOR_HEADER_SIZE)
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) return false;
+
+    const uint8_t *header = map;
+    size_t count = get32(header + 12);
+    if(memcmp(header, VECTOR_MAGIC, 8) != 0
+            || get32(header + 8) != VECTOR_VERSION
+            || (size_t) st.st_size - VECTOR_HEADER_SIZE
+                < count * VECTOR_SIZE) {
+        munmap(map, st.st_size);
+        return false;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    file->data = header + VECTOR_HEADER_SIZE;
+    file->count = count;
+    file->map = map;
+    file->size = st.st_size;
+    return true;
+}
+
+// Close a file of vectors
+void vector_file_close(VectorFile *file) {
+    munmap(file->map, file->size);
+}
+
+// Get a vector from a file
+void vector_file_get(const VectorFile *file, size_t index, Vector *vector) {
+    vector_decode(vector, file->data + index * VECTOR_SIZE);
+}
+
+// Write vectors to a file
+bool vector_file_write(const char *path, const Vector *vectors, size_t count) {
+    FILE *out = fopen(path, "wb");
+    if(out == NULL) return false;
+    uint8_t header[VECTOR_HEADER_SIZE];
+    memcpy(header, VECTOR_MAGIC, 8);
+    put32(header + 8, VECTOR_VERSION);
+    put32(header + 12, count);
+    bool ok = fwrite(header, VECTOR_HEADER_SIZE, 1, out) == 1;
+    for(size_t i = 0; ok && i < count; ++i) {
+        uint8_t record[VECTOR_SIZE];
+        vector_encode(&vectors[i], record);
+        ok = fwrite(record, VECTOR_SIZE, 1, out) == 1;
+    }
+    return fclose(out) == 0 && ok;
+}
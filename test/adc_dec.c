@@ -16,6 +16,11 @@ int main() {
         0x69, 0x17, // ADC #23  ; acc = $02, CARRY flag set
         0x18,       // CLC      ; clear carry
         0x69, 0x98, // ADC #$98 ; acc = 0, CARRY and ZERO set
+
+        // Invalid BCD operand, behaves like the NMOS 6502
+        0x18,       // CLC      ; clear carry
+        0xA9, 0x0F, // LDA #$0F ; acc = $0F (invalid BCD)
+        0x69, 0x01, // ADC #01  ; acc = $16
     };
 
     Fake f = {0};
@@ -25,6 +30,7 @@ int main() {
 
     Processor proc;
     processor_init(&proc, read, write, &f);
+    if(!(proc.features & FEATURE_DECIMAL)) return TEST_SKIP; // not built
     REPEAT(3) processor_step(&proc); // skip setup
 
     // Basic BCD arithmetic correctness
@@ -46,5 +52,10 @@ int main() {
     assert(proc.acc == 0x00);
     assert_flag_set(proc, FLAG_ZERO);
 
+    // Invalid BCD is adjusted just like the original hardware would
+    REPEAT(3) processor_step(&proc);
+    assert(proc.acc == 0x16);
+    assert_flag_clear(proc, FLAG_CARRY);
+
     return TEST_OK;
 }
@@ -0,0 +1,45 @@
+#include <stdint.h>
+#include <assert.h>
+
+#include "arena.h"
+#include "processor.h"
+#include "utils.h"
+
+#define INSTANCES 10000
+
+int main() {
+    uint8_t code[] = {
+        0xA5, 0x00, // LDA V0 ; acc = V0
+        0x69, 0x01, // ADC #1 ; acc = V0 + 1
+        0x85, 0x01, // STA V1 ; V1 = V0 + 1
+    };
+
+    // The RAM of each instance is exactly what the test address space needs
+    Arena *arena = arena_create(INSTANCES, sizeof(Fake));
+    assert(arena != NULL);
+    assert(arena_count(arena) == INSTANCES);
+    for(size_t i = 0; i < INSTANCES; ++i) {
+        Fake *f = (Fake *) arena_memory(arena, i);
+        load_code(f, code, sizeof(code));
+        write(f, 0x00, i & 0xFF); // V0 is different for each instance
+    }
+    arena_init(arena, read, write);
+
+    for(size_t i = 0; i < INSTANCES; ++i) {
+        Processor *proc = arena_processor(arena, i);
+        // CRITICAL Processors and their RAM are aligned to cache lines
+        assert((uintptr_t) proc % ARENA_ALIGN == 0);
+        assert((uintptr_t) arena_memory(arena, i) % ARENA_ALIGN == 0);
+        processor_run(proc, 3);
+    }
+
+    // Instances do not step on each other's memory
+    for(size_t i = 0; i < INSTANCES; ++i) {
+        Fake *f = (Fake *) arena_memory(arena, i);
+        assert(read(f, 0x01) == ((i + 1) & 0xFF));
+        assert(arena_processor(arena, i)->pc == CODE_START + sizeof(code));
+    }
+
+    arena_destroy(arena);
+    return TEST_OK;
+}
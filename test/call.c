@@ -0,0 +1,76 @@
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "fusion.h"
+#include "processor.h"
+#include "utils.h"
+
+#define CHECKSUM  0x0200
+#define RECURSIVE 0x0250
+
+int main() {
+    uint8_t checksum[] = {
+        0xA9, 0x00,       // LDA #0
+        0x20, 0x40, 0x02, // JSR $0240  ; add one byte
+        0xCA,             // DEX
+        0xD0, 0xFA,       // BNE $0202
+        0x60,             // RTS
+    };
+    uint8_t add[] = {
+        0x18,             // CLC
+        0x7D, 0xFF, 0x02, // ADC $02FF,X
+        0x60,             // RTS
+    };
+    uint8_t recursive[] = {
+        0xCA,             // DEX
+        0xF0, 0x03,       // BEQ $0256
+        0x20, 0x50, 0x02, // JSR $0250
+        0xC8,             // INY
+        0x60,             // RTS
+    };
+
+    Fake f = {0};
+    memcpy(&f.ram[CHECKSUM], checksum, sizeof(checksum));
+    memcpy(&f.ram[0x0240], add, sizeof(add));
+    memcpy(&f.ram[RECURSIVE], recursive, sizeof(recursive));
+    for(int i = 0; i < 0x20; ++i) f.ram[0x0300 + i] = 3 * i + 1;
+    load_code(&f, (uint8_t[]) { 0xEA }, 1);
+
+    for(int fused = 0; fused < 2; ++fused) {
+        Processor proc;
+        processor_init(&proc, read, write, &f);
+        processor_set_fusion(&proc, fused ? FUSION_ALL : 0);
+
+        // The call returns the registers and leaves the PC and stack as
+        // they were, so it can be repeated as often as needed
+        for(int n = 1; n <= 0x20; ++n) {
+            CallResult r = processor_call(&proc, CHECKSUM, 0, n, 0, 10000);
+            uint8_t sum = 0;
+            for(int i = 0; i < n; ++i) sum += 3 * i + 1;
+            assert(r.returned);
+            assert(r.acc == sum && r.x == 0);
+            assert(r.count == (uint32_t) (2 + 6 * n));
+            assert(proc.pc == CODE_START && proc.sp == 0xFD);
+        }
+
+        // CRITICAL Inner returns to the same address do not end the call,
+        // only the one that leaves the stack where it was
+        proc.pc = RECURSIVE + 6;
+        CallResult r = processor_call(&proc, RECURSIVE, 0, 5, 0, 10000);
+        assert(r.returned && r.y == 5);
+        assert(proc.pc == RECURSIVE + 6 && proc.sp == 0xFD);
+
+        // Running out of budget leaves the processor inside the subroutine
+        proc.pc = CODE_START;
+        r = processor_call(&proc, CHECKSUM, 0, 4, 0, 3);
+        assert(!r.returned && r.count == 3);
+        assert(proc.pc == 0x0241 && proc.sp == 0xF9);
+
+        // Outside of calls, RTS is just RTS
+        processor_reset(&proc);
+        proc.pc = 0x0244;
+        assert(processor_run(&proc, 1) == 1);
+    }
+    return TEST_OK;
+}
@@ -0,0 +1,104 @@
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "vectors.h"
+#include "space.h"
+#include "processor.h"
+#include "utils.h"
+
+// Run a single instruction at CODE_START, with the given registers
+static void run(Fake *f, Processor *proc, uint8_t code[], size_t length,
+        uint8_t acc, uint8_t status) {
+    load_code(f, code, length);
+    processor_init(proc, read, write, f);
+    proc->acc = acc;
+    proc->status = status | FLAG_BREAK | FLAG_NIL;
+    processor_step(proc);
+}
+
+int main() {
+    Fake f = {0};
+    Processor proc;
+
+    // CRITICAL JSR pushes the address of its last byte, high byte first, and
+    // RTS returns to the instruction after it
+    uint8_t call[] = { 0x20, 0x10, 0x01 }; // JSR $0110
+    load_code(&f, call, sizeof(call));
+    f.ram[0x110] = 0x60; // RTS
+    processor_init(&proc, read, write, &f);
+    processor_step(&proc);
+    assert(proc.pc == 0x0110 && proc.sp == 0xFB);
+    assert(f.ram[0x1FD] == 0x01 && f.ram[0x1FC] == 0x02);
+    processor_step(&proc);
+    assert(proc.pc == CODE_START + 3 && proc.sp == 0xFD);
+
+    // JMP lands on its target
+    uint8_t jump[] = { 0x4C, 0x34, 0x02 }; // JMP $0234
+    run(&f, &proc, jump, sizeof(jump), 0, 0);
+    assert(proc.pc == 0x0234);
+
+    // CMP sets the negative flag from the difference, not from the order
+    uint8_t cmp[] = { 0xC9, 0x01 }; // CMP #$01
+    run(&f, &proc, cmp, sizeof(cmp), 0x90, 0);
+    assert_flag_set(proc, FLAG_NEGATIVE);
+    assert_flag_set(proc, FLAG_CARRY);
+    run(&f, &proc, cmp, sizeof(cmp), 0x00, 0);
+    assert_flag_set(proc, FLAG_NEGATIVE);
+    assert_flag_clear(proc, FLAG_CARRY);
+
+    // BIT copies bits 7 and 6 of the data into N and V
+    uint8_t bit[] = { 0x24, 0x80 }; // BIT $80
+    f.ram[0x80] = 0xC0;
+    run(&f, &proc, bit, sizeof(bit), 0x01, 0);
+    assert_flag_set(proc, FLAG_NEGATIVE);
+    assert_flag_set(proc, FLAG_OVERFLOW);
+    assert_flag_set(proc, FLAG_ZERO);
+
+    // DEC sets the flags from the decremented value
+    uint8_t dec[] = { 0xC6, 0x80 }; // DEC $80
+    f.ram[0x80] = 0x01;
+    run(&f, &proc, dec, sizeof(dec), 0, 0);
+    assert(f.ram[0x80] == 0x00);
+    assert_flag_set(proc, FLAG_ZERO);
+
+    // SBC with the carry clear subtracts one more
+    uint8_t sbc[] = { 0xE9, 0x03 }; // SBC #$03
+    run(&f, &proc, sbc, sizeof(sbc), 0x05, 0);
+    assert(proc.acc == 0x01);
+    assert_flag_set(proc, FLAG_CARRY);
+
+    // BRK works even with interrupts disabled, skips a byte and pushes the
+    // status with the break flag set
+    uint8_t brk[] = { 0x00, 0xFF }; // BRK
+    f.ram[IRQ_VECTOR & 0x3FF] = 0x00;
+    f.ram[(IRQ_VECTOR + 1) & 0x3FF] = 0x03;
+    run(&f, &proc, brk, sizeof(brk), 0, FLAG_IRQ_DIS);
+    assert(proc.pc == 0x0300);
+    assert(f.ram[0x1FD] == 0x01 && f.ram[0x1FC] == 0x02);
+    assert(f.ram[0x1FB] & FLAG_BREAK);
+
+    // Vectors survive being serialized
+    uint64_t seed = 1;
+    for(int opcode = 0; opcode < 256; ++opcode) {
+        Vector vector, copy;
+        uint8_t record[VECTOR_SIZE];
+        assert(vector_generate(&vector, opcode, &seed));
+        vector_encode(&vector, record);
+        vector_decode(&copy, record);
+        assert(vector_run(&copy, &proc, CHECK_CYCLES | CHECK_BUS));
+    }
+
+    // A processor connected to an address space leaves its run loop for the
+    // bus of the vector
+    AddressSpace space;
+    space_init(&space, NULL, NULL, NULL);
+    space_connect(&space, &proc);
+    for(int opcode = 0; opcode < 256; ++opcode) {
+        Vector vector;
+        assert(vector_generate(&vector, opcode, &seed));
+        assert(vector_run(&vector, &proc, CHECK_CYCLES | CHECK_BUS));
+    }
+    space_free(&space);
+    return TEST_OK;
+}
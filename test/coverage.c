@@ -0,0 +1,137 @@
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "coverage.h"
+#include "space.h"
+#include "processor.h"
+#include "utils.h"
+
+// Calls a subroutine that counts X down from 3, then loops back forever
+static uint8_t code[] = {
+    0x20, 0x06, 0x01, // JSR $0106
+    0x4C, 0x00, 0x01, // JMP $0100
+    0xA2, 0x03,       // LDX #$03
+    0xCA,             // DEX
+    0xD0, 0xFD,       // BNE $0108
+    0x60,             // RTS
+};
+
+// Copies a page, in a loop that the run loop would otherwise do at once
+static uint8_t copy[] = {
+    0xA2, 0x00,       // LDX #$00
+    0xBD, 0x00, 0x03, // LDA $0300,X
+    0x9D, 0x00, 0x04, // STA $0400,X
+    0xE8,             // INX
+    0xD0, 0xF7,       // BNE $0202
+    0x4C, 0x0B, 0x02, // JMP $020B
+};
+
+#define STEPS 200
+
+// Run the code, covering it, through discrete steps or the run loop
+static void run(Coverage *cov, AddressSpace *space, Processor *proc,
+        bool step) {
+    space_init(space, NULL, NULL, NULL);
+    assert(space_map_ram(space, 0x00, 2));
+    assert(space_map_ram(space, 0xFF, 1));
+    for(size_t i = 0; i < sizeof(code); ++i)
+        space_write(space, CODE_START + i, code[i]);
+    space_write(space, RESET_VECTOR, CODE_START & 0xFF);
+    space_write(space, RESET_VECTOR + 1, CODE_START >> 8);
+    space_write(space, IRQ_VECTOR, 0x0B); // the RTS, as an IRQ handler
+    space_write(space, IRQ_VECTOR + 1, 0x01);
+    space_connect(space, proc);
+    coverage_attach(cov, proc);
+    if(step) for(int i = 0; i < STEPS; ++i) processor_step(proc);
+    else processor_run(proc, STEPS);
+}
+
+// Run the copy loop to its end, covering it, through discrete steps or the
+// run loop
+static void run_copy(Coverage *cov, AddressSpace *space, Processor *proc,
+        bool step) {
+    space_init(space, NULL, NULL, NULL);
+    assert(space_map_ram(space, 0x00, 5));
+    assert(space_map_ram(space, 0xFF, 1));
+    for(size_t i = 0; i < sizeof(copy); ++i)
+        space_write(space, 0x0200 + i, copy[i]);
+    for(int i = 0; i < 256; ++i) space_write(space, 0x0300 + i, i);
+    space_write(space, RESET_VECTOR, 0x00);
+    space_write(space, RESET_VECTOR + 1, 0x02);
+    space_connect(space, proc);
+    coverage_attach(cov, proc);
+    int steps = 1 + 256 * 4 + 1;
+    if(step) for(int i = 0; i < steps; ++i) processor_step(proc);
+    else processor_run(proc, steps);
+    assert(proc->pc == 0x020B);
+    assert(space_read(space, 0x04FF) == 0xFF);
+}
+
+int main() {
+    Coverage a, b;
+    assert(!coverage_init(&a, NULL, 1000)); // not a power of two
+    assert(coverage_init(&a, NULL, COVERAGE_SIZE));
+    assert(coverage_init(&b, NULL, COVERAGE_SIZE));
+    AddressSpace space;
+    Processor proc;
+
+    // CRITICAL Each distinct edge gets its own counter: the first JSR (from
+    // the start), the BNE taken from the subroutine entry and from itself,
+    // the BNE not taken, the RTS, the JMP and the JSR from then on
+    run(&a, &space, &proc, true);
+    uint16_t flow[] = { 0x0106, 0x0108, 0x0108, 0x010B, 0x0103, 0x0100,
+        0x0106 };
+    uint32_t prev = 0;
+    for(int i = 0; i < 7; ++i) {
+        uint32_t location = COVERAGE_LOCATION(flow[i]);
+        assert(a.map[(location ^ prev) & a.mask] > 0);
+        prev = location >> 1;
+    }
+    assert(coverage_count(&a) == 7);
+    assert(a.map[COVERAGE_LOCATION(0x0106)] == 1); // from the start, once
+    space_free(&space);
+
+    // The run loop counts the very same edges, the very same number of times
+    run(&b, &space, &proc, false);
+    assert(memcmp(a.map, b.map, COVERAGE_SIZE) == 0);
+
+    // Interrupts are edges too
+    coverage_reset(&b);
+    assert(coverage_count(&b) == 0 && b.prev == 0);
+    proc.status &= ~FLAG_IRQ_DIS;
+    processor_request(&proc);
+    assert(coverage_count(&b) == 1);
+    assert(b.map[COVERAGE_LOCATION(0x010B) & b.mask] == 1);
+    space_free(&space);
+
+    // Copy loops are run one iteration at a time, so that their back edge is
+    // counted on each of them
+    coverage_reset(&a);
+    coverage_reset(&b);
+    run_copy(&a, &space, &proc, true);
+    space_free(&space);
+    run_copy(&b, &space, &proc, false);
+    assert(memcmp(a.map, b.map, COVERAGE_SIZE) == 0);
+    uint32_t loop = COVERAGE_LOCATION(0x0202);
+    assert(b.map[(loop ^ loop >> 1) & b.mask] == 254);
+    space_free(&space);
+
+    // Detached, nothing is counted
+    coverage_reset(&a);
+    coverage_attach(NULL, &proc);
+    processor_run(&proc, STEPS);
+    assert(coverage_count(&a) == 0);
+
+    // A bitmap of the host's own, smaller than usual
+    static uint8_t map[256];
+    coverage_free(&a);
+    assert(coverage_init(&a, map, sizeof(map)));
+    run(&a, &space, &proc, false);
+    assert(coverage_count(&a) > 0);
+    space_free(&space);
+
+    coverage_free(&a);
+    coverage_free(&b);
+    return TEST_OK;
+}
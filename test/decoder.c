@@ -0,0 +1,47 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "decoder.h"
+#include "addressing.h"
+#include "utils.h"
+
+#define SIZE 4099 // not a multiple of anything in particular
+
+int main() {
+    static uint8_t code[SIZE], lengths[SIZE], starts[SIZE];
+    static Instruction out[SIZE];
+
+    // CRITICAL Bulk decoding agrees with decode, for every opcode
+    for(int i = 0; i < SIZE; ++i) code[i] = i < 256 ? i : rand();
+    decode_buffer(code, SIZE, out, lengths);
+    for(int i = 0; i < SIZE; ++i) {
+        Instruction inst = decode(code[i]);
+        assert(out[i].op == inst.op && out[i].mode == inst.mode);
+        assert(lengths[i] == 1 + get_inc(inst.mode));
+    }
+
+    // Either output can be left out
+    memset(lengths, 0, SIZE);
+    decode_buffer(code, SIZE, NULL, lengths);
+    assert(lengths[0x20] == 3 && lengths[0xA9] == 2 && lengths[0xEA] == 1);
+    decode_buffer(code + 1, 0, out, NULL);
+
+    // A linear sweep steps over the operands
+    uint8_t program[] = {
+        0xA9, 0x01,       // LDA #1
+        0x8D, 0x00, 0x02, // STA $0200
+        0xEA,             // NOP
+        0x4C, 0x00, 0x01, // JMP $0100
+        0x02,             // invalid, one byte long
+        0x20, 0x00,       // JSR, cut short
+    };
+    memset(starts, 0xFF, sizeof(program));
+    assert(decode_sweep(program, sizeof(program), starts) == 6);
+    uint8_t expected[] = { 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0 };
+    assert(memcmp(starts, expected, sizeof(expected)) == 0);
+    assert(decode_sweep(program, 0, starts) == 0);
+
+    return TEST_OK;
+}
@@ -0,0 +1,79 @@
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "space.h"
+#include "processor.h"
+#include "utils.h"
+
+#define OAM_PORT 0x2004
+
+// Sprite memory behind an I/O port, as in the NES
+typedef struct {
+    uint8_t oam[256];
+    uint8_t addr;
+} Ppu;
+
+static void ppu_write(void *userdata, uint16_t addr, uint8_t data) {
+    Ppu *ppu = userdata;
+    if(addr == OAM_PORT) ppu->oam[ppu->addr++] = data;
+}
+
+int main() {
+    Ppu ppu = {0};
+    AddressSpace space;
+    Processor proc;
+    space_init(&space, NULL, ppu_write, &ppu);
+    space_map_ram(&space, 0x00, 0x08);
+    space_map_ram(&space, 0xFF, 1);
+    space_connect(&space, &proc);
+    if(!(proc.features & FEATURE_CYCLES)) {
+        space_free(&space);
+        return TEST_SKIP; // built without cycle counting
+    }
+    for(int i = 0; i < 256; ++i) space_write(&space, 0x0200 + i, i ^ 0xA5);
+
+    // CRITICAL Sprite DMA stalls for 513 cycles, or 514 when it starts on
+    // an odd cycle, and writes every byte to the port in order
+    proc.cycles = 100;
+    assert(processor_dma(&proc, 0x0200, OAM_PORT, 256, DMA_FIXED) == 513);
+    assert(proc.cycles == 613);
+    assert(processor_dma(&proc, 0x0200, OAM_PORT, 256, DMA_FIXED) == 514);
+    assert(proc.cycles == 1127);
+    for(int i = 0; i < 256; ++i) assert(ppu.oam[i] == (i ^ 0xA5));
+
+    // Copies between directly mapped pages, crossing pages unaligned
+    processor_dma(&proc, 0x0280, 0x0510, 0x100, DMA_INCREMENT);
+    for(int i = 0; i < 0x100; ++i)
+        assert(space_read(&space, 0x0510 + i)
+                == space_read(&space, 0x0280 + i));
+
+    // An overlapping copy just ahead of the source smears it, byte by byte
+    processor_dma(&proc, 0x0200, 0x0201, 0x10, DMA_INCREMENT);
+    for(int i = 0; i <= 0x10; ++i)
+        assert(space_read(&space, 0x0200 + i) == 0xA5);
+
+    // One just behind the source copies it as it was, within a page and
+    // across pages
+    for(int i = 0; i < 0x30; ++i) space_write(&space, 0x0600 + i, i);
+    processor_dma(&proc, 0x0610, 0x0600, 0x20, DMA_INCREMENT);
+    for(int i = 0; i < 0x20; ++i)
+        assert(space_read(&space, 0x0600 + i) == i + 0x10);
+    for(int i = 0; i < 0x28; ++i) space_write(&space, 0x06F0 + i, i);
+    processor_dma(&proc, 0x06F8, 0x06F0, 0x20, DMA_INCREMENT);
+    for(int i = 0; i < 0x20; ++i)
+        assert(space_read(&space, 0x06F0 + i) == i + 8);
+
+    // The same transfers on a plain bus go through the callbacks
+    Fake f = {0};
+    for(int i = 0; i < 0x20; ++i) f.ram[0x200 + i] = i;
+    Processor plain;
+    processor_init(&plain, read, write, &f);
+    processor_dma(&plain, 0x0200, 0x0300, 0x20, DMA_INCREMENT);
+    assert(memcmp(&f.ram[0x200], &f.ram[0x300], 0x20) == 0);
+    processor_dma(&plain, 0x0200, 0x0010, 0x20, DMA_FIXED);
+    assert(f.ram[0x10] == 0x1F);
+
+    space_free(&space);
+    return TEST_OK;
+}
@@ -0,0 +1,75 @@
+#include <stdint.h>
+#include <assert.h>
+
+#include "debug.h"
+#include "processor.h"
+#include "utils.h"
+
+// Trace hook which counts the instructions it sees
+static int traced = 0;
+static void count(void *userdata, const Processor *proc) {
+    (void) userdata;
+    (void) proc;
+    ++traced;
+}
+
+int main() {
+    uint8_t code[] = {
+        0xA2, 0xFF,       // LDX #$FF    ; 2 cycles
+        0xBD, 0x01, 0x00, // LDA $0001,X ; 5 cycles, page crossed
+        0xBD, 0x00, 0x00, // LDA $0000,X ; 4 cycles
+        0xF8,             // SED         ; enable decimal mode
+        0x18,             // CLC         ; clear carry
+        0xA9, 0x09,       // LDA #09     ; acc = $09
+        0x69, 0x01,       // ADC #01     ; acc = $10, or $0A without BCD
+        0xD0, 0x00,       // BNE *+2     ; 3 cycles, branch taken
+    };
+
+    Fake f = {0};
+    load_code(&f, code, sizeof(code));
+    disassemble(stdout, &f, read, CODE_START, sizeof(code));
+
+    Processor proc;
+    processor_init(&proc, read, write, &f);
+    uint8_t all = FEATURE_DECIMAL | FEATURE_TRACE | FEATURE_CYCLES;
+    if(processor_set_features(&proc, all) != all) return TEST_SKIP;
+    processor_set_features(&proc, FEATURE_DECIMAL | FEATURE_CYCLES);
+
+    // CRITICAL Indexed reads take an extra cycle when crossing a page
+    processor_step(&proc);
+    assert(proc.cycles == 2);
+    processor_step(&proc);
+    assert(proc.cycles == 7);
+    processor_step(&proc);
+    assert(proc.cycles == 11);
+
+    // Taken branches take an extra cycle
+    processor_run(&proc, 4);
+    assert(proc.acc == 0x10);
+    assert(proc.cycles == 19);
+    processor_step(&proc);
+    assert(proc.cycles == 22);
+    assert(proc.pc == CODE_START + sizeof(code));
+
+    // Without decimal mode (as in the 2A03) the decimal flag is ignored
+    processor_init(&proc, read, write, &f);
+    processor_set_features(&proc, FEATURE_CYCLES);
+    processor_run(&proc, 7);
+    assert_flag_set(proc, FLAG_DECIMAL);
+    assert(proc.acc == 0x0A);
+
+    // Trace hooks get called before each instruction, but cost nothing if
+    // the feature is not enabled
+    processor_init(&proc, read, write, &f);
+    proc.trace = count;
+    processor_run(&proc, 8);
+    assert(traced == 0);
+    processor_init(&proc, read, write, &f);
+    proc.trace = count;
+    processor_set_features(&proc, FEATURE_TRACE);
+    processor_run(&proc, 8);
+    assert(traced == 8);
+    assert(proc.cycles == 0);
+
+    return TEST_OK;
+}
@@ -0,0 +1,65 @@
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <stdlib.h>
+
+#include "fusion.h"
+#include "processor.h"
+#include "utils.h"
+
+#define INSTRUCTIONS 84 // instructions taken by the program below
+
+int main() {
+    uint8_t code[] = {
+        0xA2, 0x00,       // LDX #$00
+        0xBD, 0x00, 0x03, // LDA $0300,X ; loop
+        0x9D, 0x00, 0x02, // STA $0200,X
+        0xE8,             // INX
+        0xE0, 0x10,       // CPX #$10
+        0xD0, 0xF5,       // BNE loop
+        0x18,             // CLC
+        0x69, 0x05,       // ADC #$05
+        0x85, 0x10,       // STA $10
+    };
+
+    Fake f = {0}, g;
+    load_code(&f, code, sizeof(code));
+    for(int i = 0; i < 0x10; ++i) f.ram[0x300 + i] = i + 1;
+    memcpy(&g, &f, sizeof(Fake));
+
+    // The profile picks the pairs that make up the copy loop
+    FusionProfile *profile = malloc(sizeof(FusionProfile));
+    assert(profile != NULL);
+    fusion_profile_init(profile);
+    Processor proc;
+    processor_init(&proc, read, write, &f);
+    fusion_profile(profile, &proc, INSTRUCTIONS);
+    assert(profile->total == INSTRUCTIONS - 1);
+    assert(profile->count[0xE0][0xD0] == 0x10);
+    uint32_t pairs = fusion_select(profile, 0.1);
+    assert(pairs & FUSION_BIT(FUSE_LDA_STA_ABX));
+    assert(pairs & FUSION_BIT(FUSE_STA_ABX_INX));
+    assert(pairs & FUSION_BIT(FUSE_CPX_IMM_BNE));
+    assert(!(pairs & FUSION_BIT(FUSE_CLC_ADC)));
+    free(profile);
+
+    // CRITICAL Fused execution has exactly the same results as the unfused
+    // one, including the cycle count
+    Processor fused;
+    processor_init(&fused, read, write, &g);
+    processor_set_fusion(&fused, FUSION_ALL);
+    assert(processor_run(&fused, INSTRUCTIONS) == INSTRUCTIONS);
+    assert(fused.pc == CODE_START + sizeof(code));
+    assert(fused.acc == proc.acc && fused.x == proc.x);
+    assert(fused.status == proc.status);
+    assert(fused.cycles == proc.cycles);
+    assert(memcmp(&f, &g, sizeof(Fake)) == 0);
+    assert(g.ram[0x20F] == 0x10 && g.ram[0x10] == 0x15);
+
+    // Chains of fused pairs never go past the number of instructions asked
+    processor_init(&fused, read, write, &g);
+    processor_set_fusion(&fused, FUSION_ALL);
+    processor_run(&fused, 3);
+    assert(fused.pc == CODE_START + 8);
+    return TEST_OK;
+}
@@ -0,0 +1,62 @@
+#include <stdint.h>
+#include <assert.h>
+
+#include "hash.h"
+#include "space.h"
+#include "processor.h"
+#include "utils.h"
+
+int main() {
+    uint8_t program[0x100] = {
+        0xA9, 0x07,       // LDA #7
+        0x85, 0x10,       // STA $10
+        0xE6, 0x10,       // INC $10
+        0x8D, 0x00, 0x30, // STA $3000
+    };
+    program[OFFSET_OF(RESET_VECTOR)] = 0x00;
+    program[OFFSET_OF(RESET_VECTOR) + 1] = 0xFF;
+    Image *image = image_create(program, sizeof(program));
+
+    AddressSpace a, b;
+    Processor pa, pb;
+    StateHash ha, hb;
+    AddressSpace *spaces[] = { &a, &b };
+    for(int i = 0; i < 2; ++i) {
+        space_init(spaces[i], NULL, NULL, NULL);
+        space_map_ram(spaces[i], 0x00, 0x40);
+        space_map_image(spaces[i], image, 0xFF, MAP_ROM);
+    }
+    space_connect(&a, &pa);
+    space_connect(&b, &pb);
+    state_hash_init(&ha, &a);
+    state_hash_init(&hb, &b);
+
+    // Machines in the same state have the same digest
+    assert(state_hash(&ha, &a, &pa) == state_hash(&hb, &b, &pb));
+    processor_run(&pa, 4);
+    processor_run(&pb, 4);
+    uint64_t digest = state_hash(&ha, &a, &pa);
+    assert(digest == state_hash(&hb, &b, &pb));
+
+    // CRITICAL Diverging memory is detected, even if only dirty pages are
+    // hashed again; going back to the same state gives back the same digest
+    space_write(&b, 0x3FFF, 0x01);
+    assert(state_hash(&hb, &b, &pb) != digest);
+    space_write(&b, 0x3FFF, 0x00);
+    assert(state_hash(&hb, &b, &pb) == digest);
+
+    // Diverging registers are detected as well
+    pb.x = 1;
+    assert(state_hash(&hb, &b, &pb) != digest);
+    pb.x = 0;
+
+    // The running hash matches one computed from scratch
+    StateHash fresh;
+    state_hash_init(&fresh, &a);
+    assert(state_hash(&fresh, &a, &pa) == digest);
+
+    space_free(&a);
+    space_free(&b);
+    image_destroy(image);
+    return TEST_OK;
+}
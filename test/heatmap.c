@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "heatmap.h"
+#include "space.h"
+#include "processor.h"
+#include "utils.h"
+
+static size_t device_reads, hooked;
+static AddressSpace space;
+
+// Device at $2000-$20FF
+static uint8_t device_read(void *userdata, uint16_t addr) {
+    (void) userdata;
+    ++device_reads;
+    return addr & 0xFF;
+}
+
+// Trace hook that was set before the heatmap, and reads memory on its own
+static void hook(void *userdata, const Processor *proc) {
+    assert(userdata == &space && proc->u == &space);
+    proc->read(proc->u, 0x0300);
+    ++hooked;
+}
+
+int main() {
+    uint8_t code[] = {
+        0xAD, 0x02, 0x20, // LDA $2002
+        0x2C, 0x02, 0x20, // BIT $2002
+        0x85, 0x10,       // STA $10
+        0xB1, 0x12,       // LDA ($12),Y
+        0x4C, 0x00, 0x02, // JMP $0200
+    };
+    space_init(&space, device_read, NULL, NULL);
+    assert(space_map_ram(&space, 0x00, 4));
+    assert(space_map_ram(&space, 0xFF, 1));
+    for(size_t i = 0; i < sizeof(code); ++i)
+        space_write(&space, 0x0200 + i, code[i]);
+    space_write(&space, 0x12, 0x00); // pointer to $2000
+    space_write(&space, 0x13, 0x20);
+    space_write(&space, RESET_VECTOR, 0x00);
+    space_write(&space, RESET_VECTOR + 1, 0x02);
+    Processor proc;
+    space_connect(&space, &proc);
+    proc.trace = hook;
+
+    Heatmap map;
+    assert(!heatmap_init(&map, 9));
+    assert(heatmap_init(&map, 0));
+    if(!heatmap_attach(&map, &proc)) {
+        heatmap_free(&map);
+        space_free(&space);
+        return TEST_SKIP; // built without instrumentation
+    }
+
+    // CRITICAL Every access is counted by kind and mode, ten times over
+    assert(processor_run(&proc, 50) == 50);
+    assert(hooked == 50 && device_reads == 30);
+    assert(heatmap_get(&map, 0x0200, HEATMAP_FETCH, MODE_ABSOLUTE) == 10);
+    assert(heatmap_get(&map, 0x0202, HEATMAP_FETCH, MODE_ABSOLUTE) == 10);
+    assert(heatmap_get(&map, 0x0209, HEATMAP_FETCH, MODE_INDIRECT_Y) == 10);
+    assert(heatmap_total(&map, 0x0209, HEATMAP_READ) == 0);
+    assert(heatmap_get(&map, 0x2002, HEATMAP_READ, MODE_ABSOLUTE) == 20);
+    assert(heatmap_get(&map, 0x0010, HEATMAP_WRITE, MODE_ZEROPAGE) == 10);
+    assert(heatmap_get(&map, 0x0012, HEATMAP_READ, MODE_INDIRECT_Y) == 10);
+    assert(heatmap_get(&map, 0x0013, HEATMAP_READ, MODE_INDIRECT_Y) == 10);
+    assert(heatmap_get(&map, 0x2000, HEATMAP_READ, MODE_INDIRECT_Y) == 10);
+    assert(heatmap_total(&map, 0x0300, HEATMAP_READ) == 0); // by the hook
+
+    // The hottest I/O address comes first, and memory is left out
+    FILE *out = tmpfile();
+    heatmap_write_report(&map, out, 10);
+    rewind(out);
+    char line[256];
+    assert(fgets(line, sizeof(line), out) && strstr(line, "$2002"));
+    assert(strstr(line, "20 reads") && strstr(line, "mostly absolute"));
+    assert(fgets(line, sizeof(line), out) && strstr(line, "$2000"));
+    assert(fgets(line, sizeof(line), out) == NULL);
+    fclose(out);
+
+    // The CSV has a row per counter that is not zero
+    out = tmpfile();
+    heatmap_write_csv(&map, out);
+    rewind(out);
+    size_t rows = 0;
+    bool found = false;
+    while(fgets(line, sizeof(line), out)) {
+        found = found || strcmp(line, "$2002,read,\"absolute\",20\n") == 0;
+        ++rows;
+    }
+    assert(found && rows == 1 + 13 + 5); // header, code, data
+    fclose(out);
+
+    // Detaching gives the processor its bus and hook back
+    heatmap_detach(&map);
+    assert(proc.read == space_read && proc.u == &space && proc.trace == hook);
+    assert(!(proc.features & FEATURE_TRACE));
+    heatmap_reset(&map);
+    processor_run(&proc, 50);
+    assert(heatmap_total(&map, 0x2002, HEATMAP_READ) == 0);
+    heatmap_free(&map);
+
+    // Whole pages at once
+    assert(heatmap_init(&map, 8));
+    assert(heatmap_attach(&map, &proc));
+    processor_run(&proc, 50);
+    assert(heatmap_total(&map, 0x2000, HEATMAP_READ) == 30);
+    assert(heatmap_total(&map, 0x02FF, HEATMAP_FETCH) == 130);
+    heatmap_detach(&map);
+    heatmap_free(&map);
+
+    space_free(&space);
+    return TEST_OK;
+}
@@ -0,0 +1,102 @@
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "space.h"
+#include "processor.h"
+#include "utils.h"
+
+#define PROGRAM 0x0200
+#define STEPS   4000 // enough to run the whole program below
+
+// Set up a machine with the program below in RAM
+static void setup(AddressSpace *space, Processor *proc, const uint8_t *code,
+        size_t size) {
+    space_init(space, NULL, NULL, NULL);
+    assert(space_map_ram(space, 0x00, 0x80));
+    assert(space_map_ram(space, 0xFF, 1));
+    for(size_t i = 0; i < size; ++i) space_write(space, PROGRAM + i, code[i]);
+    for(int i = 0; i < 0x200; ++i) space_write(space, 0x3000 + i, i ^ 0x5A);
+    space_write(space, RESET_VECTOR, PROGRAM & 0xFF);
+    space_write(space, RESET_VECTOR + 1, PROGRAM >> 8);
+    space_write(space, 0x10, 0x00); // ($10) = $5000
+    space_write(space, 0x11, 0x50);
+    space_write(space, 0x12, 0xF0); // ($12) = $30F0
+    space_write(space, 0x13, 0x30);
+    space_connect(space, proc);
+}
+
+// Check that two machines are in exactly the same state
+static void check(const AddressSpace *a, const Processor *pa,
+        const AddressSpace *b, const Processor *pb) {
+    assert(pa->pc == pb->pc && pa->acc == pb->acc);
+    assert(pa->x == pb->x && pa->y == pb->y && pa->sp == pb->sp);
+    assert(pa->status == pb->status);
+    assert(pa->cycles == pb->cycles);
+    for(int page = 0; page < 0x80; ++page)
+        assert(memcmp(a->rmap[page], b->rmap[page], SPACE_PAGE_SIZE) == 0);
+}
+
+int main() {
+    uint8_t code[] = {
+        0xA2, 0x00,       // LDX #$00
+        0xBD, 0xF0, 0x30, // LDA $30F0,X ; copy, crossing a page
+        0x9D, 0x00, 0x40, // STA $4000,X
+        0xE8,             // INX
+        0xD0, 0xF7,       // BNE *-9
+        0xA0, 0x00,       // LDY #$00
+        0xA9, 0xAA,       // LDA #$AA
+        0x91, 0x10,       // STA ($10),Y ; fill
+        0xC8,             // INY
+        0xD0, 0xFB,       // BNE *-5
+        0xA0, 0x80,       // LDY #$80
+        0xB1, 0x12,       // LDA ($12),Y ; copy through pointers
+        0x91, 0x10,       // STA ($10),Y
+        0xC8,             // INY
+        0xD0, 0xF9,       // BNE *-7
+        0xA2, 0x00,       // LDX #$00
+        0xBD, 0x00, 0x40, // LDA $4000,X ; overlapping copy, left alone
+        0x9D, 0x01, 0x40, // STA $4001,X
+        0xE8,             // INX
+        0xD0, 0xF7,       // BNE *-9
+        0xA2, 0x00,       // LDX #$00
+        0x9D, 0x00, 0x02, // STA $0200,X ; fill over its own code, left alone
+        0xE8,             // INX
+        0xD0, 0xFA,       // BNE *-6
+    };
+
+    // Reference: the program run one instruction at a time, set up anew
+    // along with each machine below
+    AddressSpace ref_space;
+    Processor ref;
+
+    // CRITICAL Loops run natively end exactly where the iterative execution
+    // does, however the instructions are split between calls
+    uint32_t splits[] = { STEPS, 1000, 7, 3, 1 };
+    for(size_t s = 0; s < sizeof(splits) / sizeof(splits[0]); ++s) {
+        AddressSpace space;
+        Processor proc;
+        setup(&space, &proc, code, sizeof(code));
+        setup(&ref_space, &ref, code, sizeof(code));
+        for(uint32_t done = 0; done < STEPS; done += splits[s]) {
+            uint32_t count = splits[s];
+            if(count > STEPS - done) count = STEPS - done;
+            for(uint32_t i = 0; i < count; ++i) processor_step(&ref);
+            assert(processor_run(&proc, count) == count);
+            check(&ref_space, &ref, &space, &proc);
+        }
+        space_free(&space);
+        space_free(&ref_space);
+    }
+
+    // The loops did what they are supposed to
+    setup(&ref_space, &ref, code, sizeof(code));
+    processor_run(&ref, 1 + 4 * 256);
+    assert(space_read(&ref_space, 0x40FF) == (0xEF ^ 0x5A));
+    assert(ref.acc == (0xEF ^ 0x5A) && ref.x == 0);
+    assert_flag_set(ref, FLAG_ZERO);
+    processor_run(&ref, 2 + 3 * 256);
+    assert(space_read(&ref_space, 0x50FF) == 0xAA);
+    space_free(&ref_space);
+    return TEST_OK;
+}
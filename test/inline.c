@@ -0,0 +1,70 @@
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "processor.h"
+#include "utils.h"
+
+#define SEEDS 32
+#define INSTRUCTIONS 20000
+
+// Flat 64KiB of RAM, which the compiler sees through
+typedef struct { uint8_t mem[0x10000]; } Memory;
+
+static inline uint8_t memory_read(void *userdata, uint16_t addr) {
+    return ((Memory *) userdata)->mem[addr];
+}
+
+static inline void memory_write(void *userdata, uint16_t addr, uint8_t data) {
+    ((Memory *) userdata)->mem[addr] = data;
+}
+
+// The same, through function pointers, for the reference
+static uint8_t pointer_read(void *userdata, uint16_t addr) {
+    return memory_read(userdata, addr);
+}
+
+static void pointer_write(void *userdata, uint16_t addr, uint8_t data) {
+    memory_write(userdata, addr, data);
+}
+
+#define RESIDENT_NAME run_inline
+#define RESIDENT_FEATURES (FEATURE_DECIMAL | FEATURE_CYCLES)
+#define RESIDENT_READ memory_read
+#define RESIDENT_WRITE memory_write
+#include "resident.h"
+
+int main() {
+    static Memory memory, ref_memory;
+    Processor proc, ref;
+    for(uint64_t seed = 1; seed <= SEEDS; ++seed) {
+        uint64_t state = seed;
+        for(uint32_t addr = 0; addr < 0x10000; ++addr)
+            memory.mem[addr] = next_random(&state) >> 56;
+        memcpy(&ref_memory, &memory, sizeof(Memory));
+        processor_init(&proc, pointer_read, pointer_write, &memory);
+        processor_init(&ref, pointer_read, pointer_write, &ref_memory);
+        uint8_t features = FEATURE_DECIMAL | FEATURE_CYCLES;
+        if(processor_set_features(&ref, features) != features)
+            return TEST_SKIP;
+        processor_set_features(&proc, features);
+        proc.run = run_inline;
+
+        // CRITICAL A core with the bus inlined into it behaves just like the
+        // library's, instruction by instruction
+        for(uint32_t done = 0; done < INSTRUCTIONS;) {
+            uint32_t batch = 1 + (next_random(&state) >> 59);
+            assert(processor_run(&proc, batch) == batch);
+            for(uint32_t i = 0; i < batch; ++i) processor_step(&ref);
+            assert(proc.pc == ref.pc && proc.acc == ref.acc);
+            assert(proc.x == ref.x && proc.y == ref.y);
+            assert(proc.sp == ref.sp && proc.status == ref.status);
+            assert(proc.cycles == ref.cycles);
+            assert(proc.opcode == ref.opcode);
+            assert(proc.inst.op == ref.inst.op);
+            done += batch;
+        }
+        assert(memcmp(&memory, &ref_memory, sizeof(Memory)) == 0);
+    }
+    return TEST_OK;
+}
@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "journal.h"
+#include "space.h"
+#include "processor.h"
+#include "utils.h"
+
+#define BATCHES 2000
+
+// Device whose reads never repeat, so that replaying the wrong values would
+// show in memory
+static uint8_t device_read(void *userdata, uint16_t addr) {
+    uint32_t *lfsr = userdata;
+    *lfsr = (*lfsr >> 1) ^ (-(*lfsr & 1) & 0xEDB88320u);
+    return *lfsr ^ addr;
+}
+
+// Machine with RAM at $0000-$03FF, the program at $8000, its interrupt
+// handler at $9000 and a device at $4000
+static void machine(AddressSpace *space, Processor *proc, bool reads_index,
+        uint32_t *lfsr) {
+    uint8_t main[] = {
+        0x58,             // CLI
+        0xAD, 0x00, 0x40, // LDA $4000
+        0x18,             // CLC
+        0x65, 0x12,       // ADC $12
+        0x85, 0x12,       // STA $12
+        0xAE, 0x02, 0x40, // LDX $4002
+        0x9D, 0x00, 0x03, // STA $0300,X
+        0x4C, 0x01, 0x80, // JMP $8001
+    };
+    if(!reads_index) memcpy(&main[9], (uint8_t[]) { 0xA2, 0x02, 0xEA }, 3);
+    uint8_t handler[] = {
+        0xAD, 0x01, 0x40, // LDA $4001
+        0x45, 0x10,       // EOR $10
+        0x85, 0x10,       // STA $10
+        0xE6, 0x11,       // INC $11
+        0x40,             // RTI
+    };
+    load_machine(space, proc, lfsr ? device_read : NULL, NULL, lfsr, main,
+            sizeof(main), 0x8000);
+    assert(space_map_ram(space, 0x90, 1));
+    for(size_t i = 0; i < sizeof(handler); ++i)
+        space_write(space, 0x9000 + i, handler[i]);
+    uint16_t vectors[] = { NMI_VECTOR, IRQ_VECTOR };
+    for(int i = 0; i < 2; ++i) {
+        space_write(space, vectors[i], 0x00);
+        space_write(space, vectors[i] + 1, 0x90);
+    }
+}
+
+// The host: runs uneven batches, raising interrupts between some of them
+static void host(Journal *journal, Processor *proc) {
+    for(int i = 0; i < BATCHES; ++i) {
+        journal_run(journal, proc, 1 + i % 53);
+        if(i % 7 == 0) journal_request(journal, proc);
+        if(i % 101 == 0) journal_interrupt(journal, proc);
+    }
+}
+
+int main() {
+    char path[] = "/tmp/libre-6502-journal-XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    fclose(fdopen(fd, "wb"));
+
+    // Record a run with the device attached
+    uint32_t lfsr = 1;
+    AddressSpace recorded, replayed;
+    Processor rec, rep;
+    machine(&recorded, &rec, true, &lfsr);
+    Journal journal;
+    assert(journal_record(&journal, path, &recorded));
+    host(&journal, &rec);
+    assert(journal_close(&journal));
+    assert(recorded.io_read == device_read);
+    assert(journal.reads > 0);
+    assert(space_read(&recorded, 0x11) > 0); // interrupts were handled
+
+    // CRITICAL Replaying it without the device ends up in the very same state
+    machine(&replayed, &rep, true, NULL);
+    assert(journal_replay(&journal, path, &replayed));
+    host(&journal, &rep);
+    assert(!journal.diverged);
+    assert(journal_close(&journal));
+    assert(rep.pc == rec.pc && rep.acc == rec.acc && rep.x == rec.x);
+    assert(rep.sp == rec.sp && rep.status == rec.status);
+    assert(rep.cycles == rec.cycles);
+    for(uint16_t addr = 0; addr < 0x400; ++addr)
+        assert(space_read(&replayed, addr) == space_read(&recorded, addr));
+    space_free(&replayed);
+
+    // A different program does not read the same way, which is noticed
+    machine(&replayed, &rep, false, NULL);
+    assert(journal_replay(&journal, path, &replayed));
+    host(&journal, &rep);
+    assert(journal.diverged);
+    assert(journal_close(&journal));
+    space_free(&replayed);
+
+    space_free(&recorded);
+    remove(path);
+    return TEST_OK;
+}
@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "recorder.h"
+#include "space.h"
+#include "processor.h"
+#include "utils.h"
+
+// Counts X down from 3, storing each value, then runs into an invalid opcode
+static uint8_t code[] = {
+    0xA2, 0x03,       // LDX #$03
+    0x8A,             // TXA
+    0x95, 0x10,       // STA $10,X
+    0xCA,             // DEX
+    0xD0, 0xFA,       // BNE $0102
+    0x02,             // invalid opcode
+    0xEA,             // NOP
+};
+
+// Run the code with a recorder attached, in the given way. Returns false if
+// recording was left out of the build
+static bool run(Processor *proc, Recorder *rec, bool step) {
+    assert(recorder_init(rec, 8));
+    rec->out = tmpfile();
+    assert(rec->out != NULL);
+    if(!recorder_attach(rec, proc)) {
+        fclose(rec->out);
+        recorder_free(rec);
+        return false;
+    }
+    for(int i = 0; i < 15; ++i) {
+        if(step) processor_step(proc);
+        else processor_run(proc, 1);
+    }
+    return true;
+}
+
+// Check what the recorder saw: the last 8 of the 15 instructions run
+static void check(const Recorder *rec) {
+    assert(rec->head == 15);
+    assert(recorder_count(rec) == 8);
+    uint16_t pcs[] = { 0x0105, 0x0106, 0x0102, 0x0103, 0x0105, 0x0106,
+        0x0108, 0x0109 };
+    for(int i = 0; i < 8; ++i) assert(recorder_get(rec, i).pc == pcs[i]);
+    // Registers are as they were before each instruction
+    RecorderEntry dex = recorder_get(rec, 4);
+    assert(dex.opcode == 0xCA && dex.x == 1 && dex.acc == 1);
+    assert(dex.sp == 0xFD);
+    RecorderEntry invalid = recorder_get(rec, 6);
+    assert(invalid.opcode == 0x02 && invalid.x == 0);
+    assert(invalid.status & FLAG_ZERO);
+
+    // CRITICAL The invalid opcode dumped the ring, once
+    assert(rec->halted);
+    char text[2048] = {0};
+    rewind(rec->out);
+    assert(fread(text, 1, sizeof(text) - 1, rec->out) > 0);
+    assert(strstr(text, "invalid opcode $02 at $0108") != NULL);
+    assert(strstr(text, "$0103  95  sta zeropage,x") != NULL);
+    assert(strstr(text, "$0109") == NULL); // dumped before the NOP
+    assert(strstr(strstr(text, "invalid") + 1, "invalid") == NULL);
+}
+
+int main() {
+    Recorder rec;
+    assert(!recorder_init(&rec, 12)); // not a power of two
+
+    // Recording needs a recorder
+    Fake f = {0};
+    load_code(&f, code, sizeof(code));
+    Processor proc;
+    processor_init(&proc, read, write, &f);
+    uint8_t features = proc.features | FEATURE_RECORD;
+    if(processor_set_features(&proc, features) != proc.features)
+        return TEST_FAIL;
+    if(proc.features & FEATURE_RECORD) return TEST_FAIL;
+
+    // Through discrete steps (the generic core)
+    if(!run(&proc, &rec, true)) return TEST_SKIP; // not built
+    check(&rec);
+    fclose(rec.out);
+    recorder_free(&rec);
+
+    // Through the run loop, on the read and write functions
+    Fake g = {0};
+    load_code(&g, code, sizeof(code));
+    processor_init(&proc, read, write, &g);
+    run(&proc, &rec, false);
+    check(&rec);
+    fclose(rec.out);
+    recorder_detach(&proc);
+    assert(!(proc.features & FEATURE_RECORD) && proc.recorder == NULL);
+    processor_run(&proc, 4);
+    assert(rec.head == 15); // no longer recording
+    recorder_free(&rec);
+
+    // Through the run loop, on an address space
+    AddressSpace space;
+    space_init(&space, NULL, NULL, NULL);
+    assert(space_map_ram(&space, 0x00, 2));
+    assert(space_map_ram(&space, 0xFF, 1));
+    for(size_t i = 0; i < sizeof(code); ++i)
+        space_write(&space, CODE_START + i, code[i]);
+    space_write(&space, RESET_VECTOR, CODE_START & 0xFF);
+    space_write(&space, RESET_VECTOR + 1, CODE_START >> 8);
+    space_connect(&space, &proc);
+    run(&proc, &rec, false);
+    check(&rec);
+    fclose(rec.out);
+    recorder_free(&rec);
+
+    // Copy loops are recorded one instruction at a time, rather than being
+    // run natively (see idiom.h)
+    uint8_t copy[] = {
+        0xA2, 0x00,       // LDX #$00
+        0xBD, 0x00, 0x01, // LDA $0100,X
+        0x9D, 0x80, 0x01, // STA $0180,X
+        0xE8,             // INX
+        0xD0, 0xF7,       // BNE $0102
+    };
+    for(size_t i = 0; i < sizeof(copy); ++i)
+        space_write(&space, CODE_START + i, copy[i]);
+    processor_reset(&proc);
+    assert(recorder_init(&rec, 8));
+    assert(recorder_attach(&rec, &proc));
+    assert(processor_run(&proc, 1 + 10 * 4) == 41);
+    assert(rec.head == 41 && proc.x == 10);
+    assert(recorder_get(&rec, 7).pc == 0x0109);
+    recorder_free(&rec);
+    space_free(&space);
+
+    // Along with tracing, which the tracing cores do
+    Fake h = {0};
+    load_code(&h, code, sizeof(code));
+    processor_init(&proc, read, write, &h);
+    if(processor_set_features(&proc, proc.features | FEATURE_TRACE)
+            & FEATURE_TRACE) {
+        run(&proc, &rec, false);
+        check(&rec);
+        fclose(rec.out);
+        recorder_free(&rec);
+    }
+    return TEST_OK;
+}
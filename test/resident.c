@@ -0,0 +1,87 @@
+#include <stdint.h>
+#include <assert.h>
+
+#include "space.h"
+#include "processor.h"
+#include "utils.h"
+
+#define SEEDS 64
+#define INSTRUCTIONS 20000
+
+// Same bus as an address space, but through different functions, so that
+// the processor runs on the generic core
+static uint8_t plain_read(void *userdata, uint16_t addr) {
+    return space_read(userdata, addr);
+}
+
+static void plain_write(void *userdata, uint16_t addr, uint8_t data) {
+    space_write(userdata, addr, data);
+}
+
+// Device which reports the x register of the processor reading from it
+static uint8_t device_read(void *userdata, uint16_t addr) {
+    (void) addr;
+    const Processor *proc = userdata;
+    return proc->x;
+}
+
+int main() {
+    static AddressSpace space, ref_space;
+    Processor proc, ref;
+    for(uint64_t seed = 1; seed <= SEEDS; ++seed) {
+        // Random memory, all of it RAM but for a page of I/O
+        uint64_t state = seed;
+        space_init(&space, device_read, NULL, &proc);
+        space_init(&ref_space, device_read, NULL, &ref);
+        assert(space_map_ram(&space, 0x00, 0x40));
+        assert(space_map_ram(&space, 0x41, 0xBF));
+        assert(space_map_ram(&ref_space, 0x00, 0x40));
+        assert(space_map_ram(&ref_space, 0x41, 0xBF));
+        for(uint32_t addr = 0; addr < 0x10000; ++addr) {
+            uint8_t data = next_random(&state) >> 56;
+            space_write(&space, addr, data);
+            space_write(&ref_space, addr, data);
+        }
+        space_connect(&space, &proc);
+        processor_init(&ref, plain_read, plain_write, &ref_space);
+        assert(proc.run != ref.run);
+        if(seed & 1) {
+            processor_set_features(&proc, proc.features & ~FEATURE_DECIMAL);
+            processor_set_features(&ref, ref.features & ~FEATURE_DECIMAL);
+        }
+
+        // CRITICAL The resident run loop does exactly what the generic one
+        // does, in batches of any size
+        for(uint32_t done = 0; done < INSTRUCTIONS;) {
+            uint32_t batch = 1 + (next_random(&state) >> 59);
+            assert(processor_run(&proc, batch) == batch);
+            processor_run(&ref, batch);
+            assert(proc.pc == ref.pc && proc.acc == ref.acc);
+            assert(proc.x == ref.x && proc.y == ref.y);
+            assert(proc.sp == ref.sp && proc.status == ref.status);
+            assert(proc.cycles == ref.cycles);
+            assert(proc.opcode == ref.opcode);
+            done += batch;
+        }
+        for(uint32_t addr = 0; addr < 0x10000; ++addr)
+            assert(space_read(&space, addr) == space_read(&ref_space, addr));
+        space_free(&space);
+        space_free(&ref_space);
+    }
+
+    // A bus put on the processor by the host after connecting it to a space
+    // is the one used from then on
+    Fake f = {0};
+    uint8_t code[] = { 0xA9, 0x42, 0x85, 0x10 }; // LDA #$42; STA $10
+    load_code(&f, code, sizeof(code));
+    space_init(&space, NULL, NULL, NULL);
+    space_connect(&space, &proc);
+    proc.read = read;
+    proc.write = write;
+    proc.u = &f;
+    proc.pc = CODE_START;
+    assert(processor_run(&proc, 2) == 2);
+    assert(f.ram[0x10] == 0x42);
+    space_free(&space);
+    return TEST_OK;
+}
@@ -0,0 +1,132 @@
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "runahead.h"
+#include "space.h"
+#include "processor.h"
+#include "utils.h"
+
+#define FRAME  100 // cycles
+#define AHEAD  2   // frames
+#define FRAMES 6   // real frames run
+
+static uint8_t input;
+static size_t saves, restores, frames, real_frames;
+static uint8_t shown_counter, shown_input;
+
+// Input device at $4000
+static uint8_t device_read(void *userdata, uint16_t addr) {
+    (void) userdata;
+    (void) addr;
+    return input;
+}
+
+static void save(void *host) {
+    (void) host;
+    ++saves;
+}
+
+static void restore(void *host) {
+    (void) host;
+    ++restores;
+}
+
+// Take the output of the frame to be presented, which the guest keeps at $10
+static void frame(void *host, Processor *proc, bool real, bool shown) {
+    AddressSpace *space = host;
+    assert(proc->u == space);
+    ++frames;
+    if(real) ++real_frames;
+    if(!shown) return;
+    shown_counter = space_read(space, 0x10);
+    shown_input = space_read(space, 0x11);
+}
+
+// Set up a machine that counts loops and copies the input into memory
+static void machine(AddressSpace *space, Processor *proc) {
+    uint8_t code[] = {
+        0xE6, 0x10,       // INC $10
+        0xAD, 0x00, 0x40, // LDA $4000
+        0x85, 0x11,       // STA $11
+        0x4C, 0x00, 0x02, // JMP $0200
+    };
+    load_machine(space, proc, device_read, NULL, NULL, code, sizeof(code),
+            0x0200);
+}
+
+// Run a machine up to the given cycle count
+static void run_to(Processor *proc, uint64_t end) {
+    while(proc->cycles < end) processor_run(proc, 1);
+}
+
+int main() {
+    AddressSpace space, reference, future;
+    Processor proc, ref, lead;
+    machine(&space, &proc);
+    machine(&reference, &ref);
+    machine(&future, &lead);
+    if(!(proc.features & FEATURE_CYCLES)) return TEST_SKIP;
+
+    Runahead ra;
+    RunaheadHooks hooks = { save, restore, frame };
+    uint8_t features = proc.features;
+    processor_set_features(&proc, features & ~FEATURE_CYCLES);
+    assert(!runahead_init(&ra, &proc, &space, FRAME, AHEAD, hooks, &space));
+    processor_set_features(&proc, features);
+    assert(runahead_init(&ra, &proc, &space, FRAME, AHEAD, hooks, &space));
+
+    // CRITICAL The machine only moves on by the real frame, while the output
+    // presented is the one from frames ahead with the same input
+    uint64_t start = proc.cycles;
+    const uint8_t *code_page = space.rmap[2];
+    for(int i = 1; i <= FRAMES; ++i) {
+        input = i * 3;
+        assert(runahead_frame(&ra));
+        run_to(&ref, start + (uint64_t) i * FRAME);
+        assert(proc.pc == ref.pc && proc.acc == ref.acc);
+        assert(proc.cycles == ref.cycles);
+        for(uint16_t addr = 0; addr < 0x0400; ++addr)
+            assert(space_read(&space, addr) == space_read(&reference, addr));
+        assert(space_read(&space, 0x11) == input);
+        assert(shown_input == input);
+        run_to(&lead, start + (uint64_t) (i + AHEAD) * FRAME);
+        assert(shown_counter == space_read(&future, 0x10));
+    }
+    assert(saves == FRAMES && restores == FRAMES);
+    assert(frames == FRAMES * (AHEAD + 1) && real_frames == FRAMES);
+
+    // Pages that were never written to were never copied, and the ones that
+    // were are shared with the snapshot again
+    assert(space.rmap[2] == code_page);
+    assert(space_private_pages(&space) == 0);
+
+    // Without frames ahead, the real frame is presented
+    runahead_set_ahead(&ra, 0);
+    input = 0x55;
+    assert(runahead_frame(&ra));
+    run_to(&ref, start + (FRAMES + 1) * FRAME);
+    assert(saves == FRAMES && frames == FRAMES * (AHEAD + 1) + 1);
+    assert(shown_counter == space_read(&reference, 0x10));
+    assert(shown_input == 0x55);
+
+    // Snapshots can be rolled back to any number of times
+    SpaceSnapshot snap = {0};
+    space_snapshot(&space, &snap);
+    uint8_t before = space_read(&space, 0x10);
+    for(int i = 0; i < 2; ++i) {
+        space_write(&space, 0x10, before + 1);
+        space_write(&space, 0x0300, 0xAA);
+        space_rollback(&space, &snap);
+        assert(space_read(&space, 0x10) == before);
+        assert(space_read(&space, 0x0300) == 0);
+    }
+    space_snapshot_free(&snap);
+    assert(space_private_pages(&space) == 1); // the rest is still shared
+
+    runahead_free(&ra);
+    space_free(&space);
+    space_free(&reference);
+    space_free(&future);
+    return TEST_OK;
+}
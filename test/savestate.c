@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "savestate.h"
+#include "space.h"
+#include "processor.h"
+#include "utils.h"
+
+// Device that counts how many times it was read
+static uint8_t device_read(void *userdata, uint16_t addr) {
+    (void) addr;
+    uint8_t *count = userdata;
+    return ++*count;
+}
+
+// Program that keeps filling a page of RAM with a running sum of the values
+// read from the device, at $8000, in ROM
+static const uint8_t program[] = {
+    0xA2, 0x00,       // LDX #$00
+    0x18,             // CLC
+    0x6D, 0x00, 0x40, // ADC $4000
+    0x9D, 0x00, 0x02, // STA $0200,X
+    0xE6, 0x10,       // INC $10
+    0xE8,             // INX
+    0xD0, 0xF4,       // BNE $8002
+    0xF0, 0xF0,       // BEQ $8000
+};
+
+// Machine with RAM at $0000-$03FF and $FF00-$FFFF, the program in ROM and a
+// device at $4000
+static void machine(AddressSpace *space, Processor *proc, Image *image,
+        uint8_t *device) {
+    load_machine(space, proc, device_read, NULL, device, NULL, 0, 0x8000);
+    space_map_image(space, image, 0x80, MAP_ROM);
+}
+
+// Check that two machines are in the very same state
+static void same(const Processor *a, const AddressSpace *sa,
+        const Processor *b, const AddressSpace *sb) {
+    assert(a->pc == b->pc && a->acc == b->acc && a->x == b->x);
+    assert(a->y == b->y && a->sp == b->sp && a->status == b->status);
+    assert(a->cycles == b->cycles && a->features == b->features);
+    for(int i = 0; i < SPACE_PAGES; ++i) assert(sa->kind[i] == sb->kind[i]);
+    for(uint32_t addr = 0; addr < 0x10000; ++addr)
+        if(sa->kind[PAGE_OF(addr)] != MAP_IO)
+            assert(space_read((void *) sa, addr) == space_read((void *) sb, addr));
+}
+
+int main() {
+    char path[] = "/tmp/libre-6502-savestate-XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    fclose(fdopen(fd, "wb"));
+
+    Image *image = image_create(program, sizeof(program));
+    assert(image != NULL);
+    uint8_t device = 0;
+    AddressSpace space;
+    Processor proc;
+    machine(&space, &proc, image, &device);
+    processor_run(&proc, 1000);
+    assert(savestate_save(path, &proc, &space));
+    uint8_t saved_device = device;
+
+    // Carry on with the original, for reference
+    processor_run(&proc, 5000);
+
+    // CRITICAL Loading the savestate and running just as much gets there too
+    Savestate state;
+    assert(savestate_open(&state, path));
+    assert(state.size == SAVESTATE_MEMORY + 6 * SPACE_PAGE_SIZE);
+    uint8_t loaded_device = saved_device;
+    AddressSpace loaded;
+    Processor lproc;
+    machine(&loaded, &lproc, image, &loaded_device);
+    space_write(&loaded, 0x0300, 0xAA); // replaced by the savestate
+    savestate_load(&state, &lproc, &loaded);
+    assert(space_private_pages(&loaded) == 0); // nothing was copied
+    assert(space_read(&loaded, 0x0300) == 0);
+    processor_run(&lproc, 5000);
+    same(&proc, &space, &lproc, &loaded);
+    assert(loaded_device == device);
+
+    // Only the pages written to were copied, and the file was left alone
+    assert(space_private_pages(&loaded) == 2); // zero page and $0200
+    AddressSpace other;
+    Processor oproc;
+    space_init(&other, NULL, NULL, NULL);
+    space_connect(&other, &oproc);
+    savestate_load(&state, &oproc, &other);
+    assert(space_read(&other, 0x10) != space_read(&loaded, 0x10));
+    assert(oproc.pc != lproc.pc || oproc.cycles != lproc.cycles);
+    space_write(&other, 0x8000, 0x00); // ROM stays ROM
+    assert(space_read(&other, 0x8000) == program[0]);
+    space_free(&other);
+    space_free(&loaded);
+    savestate_close(&state);
+
+    // Anything but a savestate is turned down
+    FILE *file = fopen(path, "r+b");
+    assert(file != NULL);
+    fputc('X', file);
+    fclose(file);
+    assert(!savestate_open(&state, path));
+    assert(state.data == NULL);
+    assert(!savestate_open(&state, "/nonexistent/savestate"));
+
+    space_free(&space);
+    image_destroy(image);
+    remove(path);
+    return TEST_OK;
+}
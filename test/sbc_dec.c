@@ -22,6 +22,7 @@ int main() {
 
     Processor proc;
     processor_init(&proc, read, write, &f);
+    if(!(proc.features & FEATURE_DECIMAL)) return TEST_SKIP; // not built
     REPEAT(3) processor_step(&proc); // skip setup
 
     // Basic BCD arithmetic correctness
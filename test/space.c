@@ -0,0 +1,71 @@
+#include <stdint.h>
+#include <assert.h>
+
+#include "space.h"
+#include "processor.h"
+#include "utils.h"
+
+#define INSTANCES 64
+
+// I/O handler which remembers the last value written to it
+static void io_write(void *userdata, uint16_t addr, uint8_t data) {
+    (void) addr;
+    *(uint8_t *) userdata = data;
+}
+
+int main() {
+    // Program and its data; the program increments its counter (in a data
+    // page, next to it) and reports it to an I/O port
+    uint8_t program[0x200] = {
+        0xEE, 0x00, 0x81, // INC $8100 ; increment counter
+        0xAD, 0x00, 0x81, // LDA $8100 ; acc = counter
+        0x8D, 0x00, 0x40, // STA $4000 ; report it to I/O
+        0x8D, 0x00, 0xF0, // STA $F000 ; write to ROM (ignored)
+    };
+    program[0x100] = 0x41; // counter, initially $41
+    uint8_t vectors[SPACE_PAGE_SIZE] = {0};
+    vectors[OFFSET_OF(RESET_VECTOR)] = 0x00;
+    vectors[OFFSET_OF(RESET_VECTOR) + 1] = 0x80;
+
+    Image *image = image_create(program, sizeof(program));
+    Image *rom = image_create(vectors, sizeof(vectors));
+    assert(image != NULL && rom != NULL);
+
+    static AddressSpace spaces[INSTANCES];
+    static Processor procs[INSTANCES];
+    uint8_t port[INSTANCES] = {0};
+    for(int i = 0; i < INSTANCES; ++i) {
+        space_init(&spaces[i], NULL, io_write, &port[i]);
+        assert(space_map_ram(&spaces[i], 0x00, 2)); // zero page and stack
+        space_map_image(&spaces[i], image, 0x80, MAP_RAM);
+        space_map_image(&spaces[i], rom, 0xFF, MAP_ROM);
+        space_map_image(&spaces[i], image, 0xF0, MAP_ROM);
+        assert(space_private_pages(&spaces[i]) == 2);
+        space_connect(&spaces[i], &procs[i]);
+    }
+    // Images can go away while their pages are still in use
+    image_destroy(image);
+    image_destroy(rom);
+
+    // Only the first instance runs. CRITICAL the shared data page gets
+    // copied, so the other instances do not see its write
+    processor_run(&procs[0], 4);
+    assert(port[0] == 0x42);
+    assert(space_read(&spaces[0], 0x8100) == 0x42);
+    assert(space_private_pages(&spaces[0]) == 3);
+    for(int i = 1; i < INSTANCES; ++i) {
+        assert(space_read(&spaces[i], 0x8100) == 0x41);
+        assert(space_private_pages(&spaces[i]) == 2);
+    }
+
+    // Writes to ROM pages are ignored
+    assert(space_read(&spaces[0], 0xF000) == 0xEE);
+
+    // Every instance has its own copy of the data once they have all run
+    for(int i = 1; i < INSTANCES; ++i) processor_run(&procs[i], 4);
+    for(int i = 0; i < INSTANCES; ++i) {
+        assert(port[i] == 0x42);
+        space_free(&spaces[i]);
+    }
+    return TEST_OK;
+}
@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "system.h"
+#include "space.h"
+#include "processor.h"
+#include "utils.h"
+
+#define QUANTUM 1000
+#define TIGHT   10
+#define RUN     100000
+#define LOGGED  4096
+
+// Mailbox shared by the processors at $4000, which logs who accessed it and
+// when, and a private register at $5000, whose reads are logged too if asked
+typedef struct {
+    System *sys;
+    uint8_t box[SPACE_PAGE_SIZE];
+    bool all; // log reads of the private register as well
+    size_t count;
+    struct { int cpu; uint64_t time; bool shared; } log[LOGGED];
+} Mailbox;
+
+static void note(Mailbox *mailbox, bool shared) {
+    if(mailbox->count == LOGGED) return;
+    int cpu = mailbox->sys->current;
+    assert(cpu >= 0);
+    mailbox->log[mailbox->count].cpu = cpu;
+    mailbox->log[mailbox->count].shared = shared;
+    mailbox->log[mailbox->count++].time = system_time(mailbox->sys, cpu);
+}
+
+static uint8_t mailbox_read(void *userdata, uint16_t addr) {
+    Mailbox *mailbox = userdata;
+    if(PAGE_OF(addr) != 0x40) {
+        if(mailbox->all) note(mailbox, false);
+        return 0x5A;
+    }
+    note(mailbox, true);
+    return mailbox->box[OFFSET_OF(addr)];
+}
+
+static void mailbox_write(void *userdata, uint16_t addr, uint8_t data) {
+    Mailbox *mailbox = userdata;
+    if(PAGE_OF(addr) != 0x40) return;
+    note(mailbox, true);
+    mailbox->box[OFFSET_OF(addr)] = data;
+}
+
+// The sender counts up into the mailbox; the receiver copies what it finds
+// there into its memory, and keeps reading its private register
+static const uint8_t sender[] = {
+    0xE6, 0x10,       // INC $10
+    0xA5, 0x10,       // LDA $10
+    0x8D, 0x00, 0x40, // STA $4000
+    0xA2, 0x13,       // LDX #$13
+    0xCA,             // DEX
+    0xD0, 0xFD,       // BNE $8009
+    0x4C, 0x00, 0x80, // JMP $8000
+};
+static const uint8_t receiver[] = {
+    0xAD, 0x00, 0x40, // LDA $4000
+    0x99, 0x00, 0x02, // STA $0200,Y
+    0xC8,             // INY
+    0xA2, 0x0B,       // LDX #$0B
+    0xAD, 0x00, 0x50, // LDA $5000
+    0xCA,             // DEX
+    0xD0, 0xFA,       // BNE $8009
+    0x4C, 0x00, 0x80, // JMP $8000
+};
+
+// The quiet one keeps to its private register for several quanta before
+// writing to the mailbox once; the busy one only reads its private register
+static const uint8_t quiet[] = {
+    0xA0, 0x04,       // LDY #$04
+    0xA2, 0x00,       // LDX #$00
+    0xAD, 0x00, 0x50, // LDA $5000
+    0xCA,             // DEX
+    0xD0, 0xFA,       // BNE $8004
+    0x88,             // DEY
+    0xD0, 0xF5,       // BNE $8002
+    0x8D, 0x00, 0x40, // STA $4000
+    0x4C, 0x00, 0x80, // JMP $8000
+};
+static const uint8_t busy[] = {
+    0xAD, 0x00, 0x50, // LDA $5000
+    0xA2, 0x04,       // LDX #$04
+    0xCA,             // DEX
+    0xD0, 0xFD,       // BNE $8005
+    0x4C, 0x00, 0x80, // JMP $8000
+};
+
+// Run both programs for a while, sharing the mailbox or not
+static void run(System *sys, Mailbox *mailbox, AddressSpace space[2],
+        Processor proc[2], bool share) {
+    memset(mailbox, 0, sizeof(Mailbox));
+    mailbox->sys = sys;
+    system_init(sys, QUANTUM, TIGHT);
+    load_machine(&space[0], &proc[0], mailbox_read, mailbox_write, mailbox,
+            sender, sizeof(sender), 0x8000);
+    load_machine(&space[1], &proc[1], mailbox_read, mailbox_write, mailbox,
+            receiver, sizeof(receiver), 0x8000);
+    assert(system_add(sys, &proc[0], &space[0]) == 0);
+    assert(system_add(sys, &proc[1], &space[1]) == 1);
+    if(share) system_share(sys, 0x40, 1);
+    assert(system_run(sys, RUN) >= RUN);
+    for(int i = 0; i < 2; ++i) {
+        assert(system_time(sys, i) >= RUN);
+        assert(system_time(sys, i) < sys->now + QUANTUM);
+    }
+}
+
+int main() {
+    static System sys;
+    static Mailbox mailbox, again;
+    AddressSpace space[2], other[2];
+    Processor procs[2], others[2];
+
+    // Processors are scheduled by their cycle counts
+    Fake f = {0};
+    processor_init(&procs[0], read, write, &f);
+    if(!(procs[0].features & FEATURE_CYCLES)) return TEST_SKIP; // not built
+
+    // Without shared regions, the processors take turns a quantum at a time
+    run(&sys, &mailbox, space, procs, false);
+    assert(sys.rounds <= RUN / QUANTUM);
+    system_free(&sys);
+    assert(space[0].io_read == mailbox_read && space[0].io == &mailbox);
+    for(int i = 0; i < 2; ++i) space_free(&space[i]);
+
+    // CRITICAL Around accesses to shared regions, they interleave finely
+    run(&sys, &mailbox, space, procs, true);
+    assert(sys.rounds > 10 * (RUN / QUANTUM));
+    assert(mailbox.count > 100);
+    size_t settled = 0; // accesses from the first round may be a quantum off
+    while(mailbox.log[settled].time < QUANTUM) ++settled;
+    for(size_t i = settled + 1; i < mailbox.count; ++i)
+        assert(mailbox.log[i].time + TIGHT + 7 >= mailbox.log[i - 1].time);
+    uint8_t seen = space_read(&space[1], 0x0210);
+    assert(seen > 0); // the receiver got messages
+
+    // Runs are deterministic
+    static System sys2;
+    run(&sys2, &again, other, others, true);
+    assert(again.count == mailbox.count);
+    for(size_t i = 0; i < mailbox.count; ++i) {
+        assert(again.log[i].cpu == mailbox.log[i].cpu);
+        assert(again.log[i].time == mailbox.log[i].time);
+    }
+    for(uint16_t addr = 0; addr < 0x400; ++addr)
+        assert(space_read(&other[1], addr) == space_read(&space[1], addr));
+    system_free(&sys2);
+    system_free(&sys);
+    for(int i = 0; i < 2; ++i) {
+        space_free(&space[i]);
+        space_free(&other[i]);
+    }
+
+    // The first access after a quiet period is only noticed at the end of
+    // the batch of instructions it was made in, which may be up to a quantum
+    // later; the turns that follow are tight, and the other processor
+    // catches up before the quiet one runs again
+    memset(&mailbox, 0, sizeof(Mailbox));
+    mailbox.sys = &sys;
+    mailbox.all = true;
+    system_init(&sys, QUANTUM, TIGHT);
+    load_machine(&space[0], &procs[0], mailbox_read, mailbox_write, &mailbox,
+            quiet, sizeof(quiet), 0x8000);
+    load_machine(&space[1], &procs[1], mailbox_read, mailbox_write, &mailbox,
+            busy, sizeof(busy), 0x8000);
+    assert(system_add(&sys, &procs[0], &space[0]) == 0);
+    assert(system_add(&sys, &procs[1], &space[1]) == 1);
+    system_share(&sys, 0x40, 1);
+    system_run(&sys, 12 * QUANTUM);
+    size_t first = 0;
+    while(first < mailbox.count && !mailbox.log[first].shared) ++first;
+    assert(first < mailbox.count && mailbox.log[first].cpu == 0);
+    uint64_t touched = mailbox.log[first].time;
+    assert(touched > 8 * QUANTUM); // after a quiet period indeed
+    size_t caught = first + 1;
+    while(mailbox.log[caught].cpu == 0) ++caught;
+    assert(mailbox.log[caught - 1].time <= touched + QUANTUM + 7);
+    uint64_t ahead = mailbox.log[caught - 1].time;
+    size_t resumed = caught + 1;
+    for(; mailbox.log[resumed].cpu == 1; ++resumed)
+        assert(mailbox.log[resumed].time > mailbox.log[resumed - 1].time);
+    assert(mailbox.log[resumed - 1].time + TIGHT + 7 >= ahead);
+    system_free(&sys);
+    for(int i = 0; i < 2; ++i) space_free(&space[i]);
+
+    // Processors that do not count cycles cannot keep time
+    Processor proc;
+    AddressSpace alone;
+    space_init(&alone, NULL, NULL, NULL);
+    space_connect(&alone, &proc);
+    processor_set_features(&proc, 0);
+    system_init(&sys, QUANTUM, TIGHT);
+    assert(system_add(&sys, &proc, &alone) == -1);
+    return TEST_OK;
+}
@@ -0,0 +1,59 @@
+#include <stdint.h>
+#include <assert.h>
+#include <sched.h>
+
+#include "thread.h"
+#include "processor.h"
+#include "utils.h"
+
+// Wait until the CPU thread publishes a snapshot satisfying a condition
+#define WAIT_FOR(thread, snap, cond) \
+    do { sched_yield(); cpu_thread_snapshot(thread, snap); } while(!(cond))
+
+int main() {
+    uint8_t code[] = {
+        0xE8,       // INX      ; x = x + 1
+        0xD0, 0xFD, // BNE $FD  ; loop until x wraps around
+        0xE6, 0x00, // INC V0   ; count full loops
+        0xB8,       // CLV      ; clear overflow
+        0x50, 0xF8, // BVC $F8  ; start all over again
+    };
+
+    Fake f = {0};
+    load_code(&f, code, sizeof(code));
+    Processor proc;
+    processor_init(&proc, read, write, &f);
+
+    static CpuThread thread;
+    Snapshot snap;
+    assert(cpu_thread_start(&thread, &proc, 64));
+
+    // The processor runs on its own
+    WAIT_FOR(&thread, &snap, snap.instructions > 10000);
+
+    // Commands are carried out between batches; once paused, the processor
+    // does not move anymore
+    Command poke = { .kind = COMMAND_POKE, .addr = 0x10, .data = 0xAB };
+    assert(cpu_thread_send(&thread, poke));
+    assert(cpu_thread_send(&thread, (Command) { .kind = COMMAND_PAUSE }));
+    WAIT_FOR(&thread, &snap, snap.paused);
+    uint64_t instructions = snap.instructions;
+
+    // Snapshots are published on request, even while paused: wait for one
+    // published after the request, rather than the one from the pause
+    uint32_t sequence = snap.sequence;
+    assert(cpu_thread_send(&thread, (Command) { .kind = COMMAND_SNAPSHOT }));
+    WAIT_FOR(&thread, &snap, snap.sequence != sequence);
+    assert(snap.paused && snap.instructions == instructions);
+    assert(snap.pc >= CODE_START && snap.pc < CODE_START + sizeof(code));
+
+    assert(cpu_thread_send(&thread, (Command) { .kind = COMMAND_RESUME }));
+    WAIT_FOR(&thread, &snap, snap.instructions > instructions);
+    cpu_thread_stop(&thread);
+
+    // Now that the thread is gone, the processor can be inspected freely
+    assert(read(&f, 0x10) == 0xAB);
+    assert(read(&f, 0x00) > 0);
+    assert(proc.cycles >= snap.cycles);
+    return TEST_OK;
+}
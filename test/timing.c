@@ -0,0 +1,179 @@
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "timing.h"
+#include "processor.h"
+#include "utils.h"
+
+#define COUNTDOWN 0x0200
+#define DELAY     0x0240
+#define DIAMOND   0x0260
+#define CROSSING  0x02FC
+#define INDIRECT  0x0310
+#define FOREVER   0x0320
+#define TANGLED   0x0330
+#define NESTED    0x0350
+
+static uint8_t memory[0x10000];
+
+// Copy the RAM of the fake address space into a full memory image
+static void image(const Fake *f) {
+    for(size_t i = 0; i < sizeof(memory); ++i) memory[i] = f->ram[i & 1023];
+}
+
+// Cycles taken by a call to the routine at the given address
+static uint64_t measure(Processor *proc, uint16_t addr, uint8_t y) {
+    uint64_t before = proc->cycles;
+    CallResult r = processor_call(proc, addr, 0, 0, y, 10000);
+    assert(r.returned);
+    return proc->cycles - before;
+}
+
+int main() {
+    uint8_t countdown[] = {
+        0xA2, 0x03,       // LDX #3
+        0x20, 0x40, 0x02, // JSR $0240  ; loop header
+        0xCA,             // DEX
+        0xD0, 0xFA,       // BNE $0202
+        0x60,             // RTS
+    };
+    uint8_t delay[] = {
+        0xA0, 0x02,       // LDY #2
+        0x88,             // DEY        ; loop header
+        0xD0, 0xFD,       // BNE $0242
+        0x60,             // RTS
+    };
+    uint8_t diamond[] = {
+        0xA5, 0x00,       // LDA $00
+        0xF0, 0x06,       // BEQ $026A
+        0xB1, 0x10,       // LDA ($10),Y
+        0x7D, 0x00, 0x00, // ADC $0000,X
+        0x60,             // RTS
+        0x60,             // RTS
+    };
+    uint8_t crossing[] = {
+        0xA2, 0x03,       // LDX #3
+        0xCA,             // DEX        ; loop header, at $02FE
+        0xD0, 0xFD,       // BNE $02FE  ; taken to the previous page
+        0x60,             // RTS
+    };
+    uint8_t nested[] = {
+        0xA2, 0x03,       // LDX #3
+        0xA0, 0x04,       // LDY #4     ; outer loop header
+        0x88,             // DEY        ; inner loop header
+        0xD0, 0xFD,       // BNE $0354
+        0xCA,             // DEX
+        0xD0, 0xF8,       // BNE $0352
+        0x60,             // RTS
+    };
+    uint8_t indirect[] = { 0x6C, 0x00, 0x00 }; // JMP ($0000)
+    uint8_t forever[] = { 0x4C, 0x20, 0x03 };  // JMP $0320
+    uint8_t tangled[] = {
+        0xA5, 0x00,       // LDA $00
+        0xF0, 0x03,       // BEQ $0337  ; into the middle of the loop
+        0xCA,             // DEX
+        0xF0, 0x03,       // BEQ $033A
+        0x88,             // DEY
+        0xD0, 0xFA,       // BNE $0334
+        0x60,             // RTS
+    };
+
+    Fake f = {0};
+    memcpy(&f.ram[COUNTDOWN], countdown, sizeof(countdown));
+    memcpy(&f.ram[DELAY], delay, sizeof(delay));
+    memcpy(&f.ram[DIAMOND], diamond, sizeof(diamond));
+    memcpy(&f.ram[CROSSING], crossing, sizeof(crossing));
+    memcpy(&f.ram[NESTED], nested, sizeof(nested));
+    memcpy(&f.ram[INDIRECT], indirect, sizeof(indirect));
+    memcpy(&f.ram[FOREVER], forever, sizeof(forever));
+    memcpy(&f.ram[TANGLED], tangled, sizeof(tangled));
+    f.ram[0x10] = 0xF0; // pointer to $02F0
+    f.ram[0x11] = 0x02;
+    load_code(&f, (uint8_t[]) { 0xEA }, 1);
+    image(&f);
+    Processor proc;
+    processor_init(&proc, read, write, &f);
+    uint8_t features = proc.features | FEATURE_CYCLES;
+    if(processor_set_features(&proc, features) != features)
+        return TEST_SKIP; // results are checked against counted cycles
+    Timing t;
+
+    // CRITICAL Exact bounds give the exact number of cycles, calls included
+    TimingBound bounds[] = { { 0x0202, 3, 3 }, { 0x0242, 2, 2 } };
+    assert(timing_analyze(&t, memory, COUNTDOWN, bounds, 2));
+    assert(t.best == 91 && t.worst == 91);
+    assert(measure(&proc, COUNTDOWN, 0) == 91);
+
+    // The critical path goes around the loop three times
+    assert(t.length == 3);
+    assert(t.path[0].address == 0x0200 && t.path[0].count == 1);
+    assert(t.path[1].address == 0x0202 && t.path[1].last == 0x0206);
+    assert(t.path[1].count == 3);
+    assert(t.path[2].address == 0x0208 && t.path[2].count == 1);
+    uint64_t sum = 0;
+    for(size_t i = 0; i < t.length; ++i) sum += t.path[i].cycles;
+    assert(sum == t.worst);
+    timing_free(&t);
+
+    // Looser bounds only change the best case
+    bounds[0].min = 1;
+    assert(timing_analyze(&t, memory, COUNTDOWN, bounds, 2));
+    assert(t.best == 35 && t.worst == 91);
+    timing_free(&t);
+
+    // The worst case takes the longer way, crossing a page with (ptr),Y but
+    // not with an index from the start of a page
+    assert(timing_analyze(&t, memory, DIAMOND, NULL, 0));
+    assert(t.best == 12 && t.worst == 21);
+    assert(t.length == 2 && t.path[1].address == 0x0264);
+    assert(t.path[1].last == 0x0269 && t.path[1].cycles == 16);
+    timing_free(&t);
+    f.ram[0x00] = 0;
+    assert(measure(&proc, DIAMOND, 0x00) == 12);
+    f.ram[0x00] = 1;
+    assert(measure(&proc, DIAMOND, 0x20) == 21);
+
+    // Branches back to the previous page take two extra cycles, and routines
+    // may start with a loop
+    bounds[0] = (TimingBound) { 0x02FE, 3, 3 };
+    assert(timing_analyze(&t, memory, CROSSING, bounds, 1));
+    assert(t.best == 24 && t.worst == 24);
+    assert(measure(&proc, CROSSING, 0) == 24);
+    timing_free(&t);
+    assert(timing_analyze(&t, memory, 0x02FE, bounds, 1));
+    assert(t.worst == 22 && t.length == 2);
+    timing_free(&t);
+
+    // Nested loops are bounded per entry
+    TimingBound nesting[] = { { 0x0352, 3, 3 }, { 0x0354, 4, 4 } };
+    assert(timing_analyze(&t, memory, NESTED, nesting, 2));
+    assert(t.worst == 85 && measure(&proc, NESTED, 0) == 85);
+    assert(t.length == 5 && t.path[2].count == 12);
+    timing_free(&t);
+
+    // What cannot be analyzed is reported, along with where it is, such as
+    // the loop of the subroutine here
+    assert(!timing_analyze(&t, memory, COUNTDOWN, bounds, 1));
+    assert(t.error == TIMING_UNBOUNDED && t.at == 0x0242);
+    timing_free(&t);
+    assert(!timing_analyze(&t, memory, INDIRECT, NULL, 0));
+    assert(t.error == TIMING_INDIRECT && t.at == INDIRECT);
+    timing_free(&t);
+    bounds[0] = (TimingBound) { FOREVER, 1, 10 };
+    assert(!timing_analyze(&t, memory, FOREVER, bounds, 1));
+    assert(t.error == TIMING_NO_RETURN);
+    timing_free(&t);
+    assert(!timing_analyze(&t, memory, TANGLED, NULL, 0));
+    assert(t.error == TIMING_IRREDUCIBLE);
+    timing_free(&t);
+    f.ram[DELAY + 2] = 0x20; // JSR $0240, calling itself
+    f.ram[DELAY + 3] = 0x40;
+    f.ram[DELAY + 4] = 0x02;
+    image(&f);
+    assert(!timing_analyze(&t, memory, DELAY, NULL, 0));
+    assert(t.error == TIMING_RECURSIVE && t.at == DELAY + 2);
+    timing_free(&t);
+
+    return TEST_OK;
+}
@@ -21,3 +21,30 @@ void load_code(Fake *f, uint8_t code[], size_t code_length) {
     write(f, 0xFFFC, CODE_START & 0xFF);
     write(f, 0xFFFD, CODE_START >> 8);
 }
+
+// Set up a machine on an address space and connect the processor to it
+void load_machine(AddressSpace *space, Processor *proc, AddrReader io_read,
+        AddrWriter io_write, void *io, const uint8_t *code, size_t code_length,
+        uint16_t origin) {
+    space_init(space, io_read, io_write, io);
+    assert(space_map_ram(space, 0x00, 4));
+    assert(space_map_ram(space, 0xFF, 1));
+    if(code_length > 0) {
+        uint8_t first = origin >> 8;
+        uint8_t last = (origin + code_length - 1) >> 8;
+        assert(space_map_ram(space, first, last - first + 1));
+    }
+    for(size_t i = 0; i < code_length; ++i)
+        space_write(space, origin + i, code[i]);
+    space_write(space, RESET_VECTOR, origin & 0xFF);
+    space_write(space, RESET_VECTOR + 1, origin >> 8);
+    space_connect(space, proc);
+}
+
+// Get the next number of a xorshift64* sequence
+uint64_t next_random(uint64_t *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
@@ -5,6 +5,9 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#include "space.h"
+#include "processor.h"
+
 // Exit codes recognized by meson's testing system; can be used to signal the
 // status of any particular test to the tester
 
@@ -31,4 +34,15 @@ uint8_t read(void *ptr, uint16_t addr); // reads from given address
 
 void write(void *ptr, uint16_t addr, uint8_t data); // writes to given address
 
+// Machine built on an address space, with RAM at $0000-$03FF and $FF00-$FFFF,
+// devices handled by the given callbacks and the program loaded into fresh
+// RAM at the given origin, which the reset vector points to. The processor is
+// connected to the space last, so that it starts at the program
+
+void load_machine(AddressSpace *space, Processor *proc, AddrReader io_read,
+        AddrWriter io_write, void *io, const uint8_t *code, size_t code_length,
+        uint16_t origin);
+
+uint64_t next_random(uint64_t *state); // xorshift64* pseudorandom numbers
+
 #endif // LIBRE_6502_TEST_UTILS_H
@@ -0,0 +1,448 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Analysis of a corpus of 6502 binaries, such as ROM images. Every file found
+// under the given paths (directories are scanned recursively) is mapped into
+// memory and analyzed, sharded across all the cores of the host:
+//
+//     corpus [-j THREADS] [-f csv|json] PATH...
+//
+// Each image is placed at the top of the address space, so that it ends at
+// $FFFF along with the interrupt vectors, as ROMs do; of images larger than
+// 64KiB, only the last 64KiB are seen. Code is then found by following the
+// flow of control from the vectors (recursive descent): both ways of a
+// branch, jumps and subroutine calls, stopping at indirect jumps, returns,
+// invalid opcodes and addresses outside of the image. The statistics, which
+// are written to the standard output, are:
+//
+//     - opcode, operation and addressing mode histograms of the code reached
+//     - invalid opcodes, both reached and over all of the bytes of the images
+//     - the vector targets and the amount of code reached, for each image
+//
+// As CSV, there is a row per statistic, with the columns scope (total,
+// opcode, operation, mode or the path of an image), key and value.
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "debug.h"
+#include "decoder.h"
+#include "processor.h"
+#include "definitions.h"
+
+#define MAX_THREADS 256
+#define ADDRESSES   0x10000
+
+// What was found in an image
+typedef struct {
+    const char *path;
+    bool failed;                 // it could not be read
+    size_t size;
+    uint16_t nmi, reset, irq;    // vector targets
+    size_t reached;              // instructions reached from the vectors
+    size_t reached_invalid;      // invalid opcodes among them
+    size_t invalid;              // bytes that are invalid opcodes
+} Result;
+
+// Statistics gathered by a thread, over all of the images it analyzed
+typedef struct {
+    size_t opcodes[256];         // of the instructions reached
+    size_t invalid;              // bytes that are invalid opcodes
+} Totals;
+
+// Work shared by all threads: images are handed out one at a time
+typedef struct {
+    Result *results;
+    size_t count;
+    atomic_size_t next;
+} Work;
+
+typedef struct {
+    Work *work;
+    Totals totals;
+    uint8_t *seen;               // instructions already visited
+    uint16_t *pending;           // addresses left to visit
+} Worker;
+
+// Follow the flow of control from the vectors of an image, which is mapped
+// at the given base address (its last byte is at $FFFF)
+static void reach(Worker *worker, Result *result, const uint8_t *image,
+        uint32_t base) {
+    uint8_t *seen = worker->seen;
+    uint16_t *pending = worker->pending;
+    size_t top = 0;
+    memset(seen, 0, ADDRESSES / 8);
+    #define PEEK(addr) image[(addr) - base]
+    #define VECTOR(addr) (PEEK(addr) | PEEK((addr) + 1) << 8)
+    #define VISIT(addr) do { \
+        uint32_t a_ = (addr); \
+        if(a_ >= base && !(seen[a_ >> 3] & 1 << (a_ & 7))) { \
+            seen[a_ >> 3] |= 1 << (a_ & 7); \
+            pending[top++] = a_; \
+        } \
+    } while(0)
+
+    if(base > NMI_VECTOR) return; // the image does not reach the vectors
+    result->nmi = VECTOR(NMI_VECTOR);
+    result->reset = VECTOR(RESET_VECTOR);
+    result->irq = VECTOR(IRQ_VECTOR);
+    VISIT(result->reset);
+    VISIT(result->nmi);
+    VISIT(result->irq);
+    while(top > 0) {
+        uint32_t pc = pending[--top];
+        uint8_t opcode = PEEK(pc);
+        ++worker->totals.opcodes[opcode];
+        ++result->reached;
+        Instruction inst = decode_table[opcode];
+        uint8_t length = decode_length[opcode];
+        uint32_t next = pc + length;
+        if(next > ADDRESSES) continue; // operand past the end of the image
+        uint16_t arg = length == 3 ? VECTOR(pc + 1)
+            : length == 2 ? PEEK(pc + 1) : 0;
+        switch(inst.op) {
+            case ERR:
+                ++result->reached_invalid;
+                break;
+            case BRK: case RTS: case RTI:
+                break;
+            case JMP:
+                if(inst.mode == MODE_ABSOLUTE) VISIT(arg);
+                break;
+            case JSR:
+                VISIT(arg);
+                if(next < ADDRESSES) VISIT(next);
+                break;
+            case BEQ: case BNE: case BCS: case BCC:
+            case BMI: case BPL: case BVS: case BVC:
+                VISIT((uint16_t) (next + (int8_t) arg));
+                if(next < ADDRESSES) VISIT(next);
+                break;
+            default:
+                if(next < ADDRESSES) VISIT(next);
+                break;
+        }
+    }
+    #undef PEEK
+    #undef VECTOR
+    #undef VISIT
+}
+
+// Analyze an image, mapping it into memory
+static void analyze(Worker *worker, Result *result) {
+    int fd = open(result->path, O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0) {
+        if(fd >= 0) close(fd);
+        result->failed = true;
+        return;
+    }
+    result->size = st.st_size;
+    if(result->size == 0) {
+        close(fd);
+        return;
+    }
+    const uint8_t *data = mmap(NULL, result->size, PROT_READ, MAP_PRIVATE,
+            fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) {
+        result->failed = true;
+        return;
+    }
+    madvise((void *) data, result->size, MADV_SEQUENTIAL);
+    for(size_t i = 0; i < result->size; ++i)
+        result->invalid += decode_table[data[i]].op == ERR;
+    worker->totals.invalid += result->invalid;
+
+    size_t seen = result->size < ADDRESSES ? result->size : ADDRESSES;
+    reach(worker, result, data + result->size - seen, ADDRESSES - seen);
+    munmap((void *) data, result->size);
+}
+
+// Analyze images until there are none left
+static void *run(void *arg) {
+    Worker *worker = arg;
+    Work *work = worker->work;
+    size_t i;
+    while((i = atomic_fetch_add(&work->next, 1)) < work->count)
+        analyze(worker, &work->results[i]);
+    return NULL;
+}
+
+// Paths of the images found so far
+typedef struct {
+    char **path;
+    size_t count, capacity;
+} Paths;
+
+static bool add_path(Paths *paths, const char *path) {
+    if(paths->count == paths->capacity) {
+        size_t capacity = paths->capacity ? 2 * paths->capacity : 256;
+        char **grown = realloc(paths->path, capacity * sizeof(char *));
+        if(grown == NULL) return false;
+        paths->path = grown;
+        paths->capacity = capacity;
+    }
+    paths->path[paths->count] = strdup(path);
+    return paths->path[paths->count++] != NULL;
+}
+
+// Find the regular files under a path. Returns false if it cannot be read
+static bool scan(Paths *paths, const char *path) {
+    struct stat st;
+    if(stat(path, &st) != 0) return false;
+    if(!S_ISDIR(st.st_mode)) return !S_ISREG(st.st_mode) || add_path(paths, path);
+    DIR *dir = opendir(path);
+    if(dir == NULL) return false;
+    bool ok = true;
+    struct dirent *entry;
+    while((entry = readdir(dir)) != NULL) {
+        if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+        size_t size = strlen(path) + strlen(entry->d_name) + 2;
+        char *child = malloc(size);
+        if(child == NULL) {
+            ok = false;
+            break;
+        }
+        snprintf(child, size, "%s/%s", path, entry->d_name);
+        ok = scan(paths, child) && ok;
+        free(child);
+    }
+    closedir(dir);
+    return ok;
+}
+
+static int compare_paths(const void *a, const void *b) {
+    return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+// Write a string as a JSON string, or as a CSV field
+static void quote(FILE *out, const char *text, bool json) {
+    fputc('"', out);
+    for(; *text != '\0'; ++text) {
+        unsigned char c = *text;
+        if(!json && c == '"') fputs("\"\"", out);
+        else if(json && (c == '"' || c == '\\')) fprintf(out, "\\%c", c);
+        else if(json && c < 0x20) fprintf(out, "\\u%04x", c);
+        else fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+// Statistics over the whole corpus
+typedef struct {
+    size_t images, bytes;
+    size_t invalid, reached;
+    size_t opcodes[256];
+    size_t operations[ERR + 1];
+    size_t modes[MODE_INDIRECT_Y + 1];
+} Summary;
+
+static void summarize(Summary *summary, const Totals *totals, int threads,
+        const Result *results, size_t count) {
+    memset(summary, 0, sizeof(Summary));
+    for(int t = 0; t < threads; ++t) {
+        summary->invalid += totals[t].invalid;
+        for(int i = 0; i < 256; ++i)
+            summary->opcodes[i] += totals[t].opcodes[i];
+    }
+    for(int i = 0; i < 256; ++i) {
+        summary->reached += summary->opcodes[i];
+        summary->operations[decode_table[i].op] += summary->opcodes[i];
+        summary->modes[decode_table[i].mode] += summary->opcodes[i];
+    }
+    for(size_t i = 0; i < count; ++i) {
+        if(results[i].failed) continue;
+        ++summary->images;
+        summary->bytes += results[i].size;
+    }
+}
+
+static const char *op_key(int op) {
+    return op == ERR ? "invalid" : operation_name(op);
+}
+
+// Statistics of an image, in the order they are written
+#define IMAGE_KEYS 7
+static const char *image_key[IMAGE_KEYS] = {
+    "size", "nmi", "reset", "irq", "reached", "reached_invalid", "invalid",
+};
+
+static void image_values(const Result *r, size_t values[IMAGE_KEYS]) {
+    size_t v[IMAGE_KEYS] = { r->size, r->nmi, r->reset, r->irq, r->reached,
+        r->reached_invalid, r->invalid };
+    memcpy(values, v, sizeof(v));
+}
+
+static void write_csv(FILE *out, const Summary *summary,
+        const Result *results, size_t count) {
+    fprintf(out, "scope,key,value\n");
+    fprintf(out, "total,images,%zu\ntotal,bytes,%zu\n", summary->images,
+            summary->bytes);
+    fprintf(out, "total,invalid,%zu\ntotal,reached,%zu\n", summary->invalid,
+            summary->reached);
+    for(int i = 0; i < 256; ++i)
+        fprintf(out, "opcode,$%02X,%zu\n", i, summary->opcodes[i]);
+    for(int op = 0; op <= ERR; ++op)
+        fprintf(out, "operation,%s,%zu\n", op_key(op),
+                summary->operations[op]);
+    for(int mode = 0; mode <= MODE_INDIRECT_Y; ++mode) {
+        fprintf(out, "mode,");
+        quote(out, mode_name(mode), false); // the names have commas
+        fprintf(out, ",%zu\n", summary->modes[mode]);
+    }
+    for(size_t i = 0; i < count; ++i) {
+        if(results[i].failed) continue;
+        size_t values[IMAGE_KEYS];
+        image_values(&results[i], values);
+        for(int k = 0; k < IMAGE_KEYS; ++k) {
+            quote(out, results[i].path, false);
+            // Vector targets are addresses, written as such
+            fprintf(out, k >= 1 && k <= 3 ? ",%s,$%04zX\n" : ",%s,%zu\n",
+                    image_key[k], values[k]);
+        }
+    }
+}
+
+static void write_json(FILE *out, const Summary *summary,
+        const Result *results, size_t count) {
+    fprintf(out, "{\n  \"images\": %zu,\n  \"bytes\": %zu,\n",
+            summary->images, summary->bytes);
+    fprintf(out, "  \"invalid\": %zu,\n  \"reached\": %zu,\n",
+            summary->invalid, summary->reached);
+    fprintf(out, "  \"opcodes\": [");
+    for(int i = 0; i < 256; ++i)
+        fprintf(out, "%s%zu", i ? ", " : "", summary->opcodes[i]);
+    fprintf(out, "],\n  \"operations\": {");
+    for(int op = 0; op <= ERR; ++op)
+        fprintf(out, "%s\"%s\": %zu", op ? ", " : "", op_key(op),
+                summary->operations[op]);
+    fprintf(out, "},\n  \"modes\": {");
+    for(int mode = 0; mode <= MODE_INDIRECT_Y; ++mode)
+        fprintf(out, "%s\"%s\": %zu", mode ? ", " : "", mode_name(mode),
+                summary->modes[mode]);
+    fprintf(out, "},\n  \"files\": [");
+    bool first = true;
+    for(size_t i = 0; i < count; ++i) {
+        if(results[i].failed) continue;
+        size_t values[IMAGE_KEYS];
+        image_values(&results[i], values);
+        fprintf(out, "%s\n    {\"path\": ", first ? "" : ",");
+        quote(out, results[i].path, true);
+        for(int k = 0; k < IMAGE_KEYS; ++k)
+            fprintf(out, ", \"%s\": %zu", image_key[k], values[k]);
+        fprintf(out, "}");
+        first = false;
+    }
+    fprintf(out, "%s]\n}\n", first ? "" : "\n  ");
+}
+
+static int threads_available(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n < 1 ? 1 : n > MAX_THREADS ? MAX_THREADS : n;
+}
+
+static int usage(const char *name) {
+    fprintf(stderr, "usage: %s [-j THREADS] [-f csv|json] PATH...\n", name);
+    return EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[]) {
+    if(argc < 2) return usage(argv[0]);
+    int threads = threads_available();
+    bool json = false;
+    bool ok = true;
+    Paths paths = { 0 };
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+            if(threads > MAX_THREADS) threads = MAX_THREADS;
+            continue;
+        }
+        if(strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            json = strcmp(argv[++i], "json") == 0;
+            if(!json && strcmp(argv[i], "csv") != 0) return usage(argv[0]);
+            continue;
+        }
+        if(!scan(&paths, argv[i])) {
+            fprintf(stderr, "could not read %s\n", argv[i]);
+            ok = false;
+        }
+    }
+    qsort(paths.path, paths.count, sizeof(char *), compare_paths);
+
+    decode_tables_init();
+    Work work = { .count = paths.count };
+    work.results = calloc(paths.count ? paths.count : 1, sizeof(Result));
+    static Worker workers[MAX_THREADS];
+    pthread_t thread[MAX_THREADS];
+    bool started[MAX_THREADS];
+    if((size_t) threads > paths.count) threads = paths.count;
+    if(threads < 1) threads = 1;
+    if(work.results == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+    for(size_t i = 0; i < paths.count; ++i) work.results[i].path = paths.path[i];
+    atomic_init(&work.next, 0);
+
+    for(int t = 0; t < threads; ++t) {
+        workers[t].work = &work;
+        workers[t].seen = malloc(ADDRESSES / 8);
+        workers[t].pending = malloc(ADDRESSES * sizeof(uint16_t));
+        if(workers[t].seen == NULL || workers[t].pending == NULL) {
+            fprintf(stderr, "out of memory\n");
+            return EXIT_FAILURE;
+        }
+        started[t] = pthread_create(&thread[t], NULL, run, &workers[t]) == 0;
+        if(!started[t]) run(&workers[t]);
+    }
+    static Totals totals[MAX_THREADS];
+    for(int t = 0; t < threads; ++t) {
+        if(started[t]) pthread_join(thread[t], NULL);
+        totals[t] = workers[t].totals;
+        free(workers[t].seen);
+        free(workers[t].pending);
+    }
+    for(size_t i = 0; i < paths.count; ++i) {
+        if(!work.results[i].failed) continue;
+        fprintf(stderr, "could not read %s\n", paths.path[i]);
+        ok = false;
+    }
+
+    Summary summary;
+    summarize(&summary, totals, threads, work.results, paths.count);
+    if(json) write_json(stdout, &summary, work.results, paths.count);
+    else write_csv(stdout, &summary, work.results, paths.count);
+
+    for(size_t i = 0; i < paths.count; ++i) free(paths.path[i]);
+    free(paths.path);
+    free(work.results);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
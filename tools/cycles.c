@@ -0,0 +1,180 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Static timing analysis of the routines of a 6502 binary (see timing.h):
+//
+//     cycles [-o ORIGIN] [-l ADDRESS=[MIN-]MAX]... [-d] IMAGE ENTRY...
+//
+// The image is loaded at the given origin or, by default, so that it ends at
+// $FFFF along with the interrupt vectors, as ROMs are. Each entry point is an
+// address or the name of a vector (nmi, reset or irq), and each loop bound is
+// given by the address of the loop header, which is where the branch back to
+// it lands. Addresses are hexadecimal, optionally preceded by '$'. For each
+// routine, the best and worst case numbers of cycles are written, followed by
+// the blocks of the critical path (disassembled with -d) with the number of
+// times each of them runs on it and the cycles it takes there.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "debug.h"
+#include "timing.h"
+#include "decoder.h"
+#include "processor.h"
+#include "addressing.h"
+#include "definitions.h"
+
+#define ADDRESSES 0x10000
+
+static uint8_t memory[ADDRESSES];
+
+static uint8_t peek(void *userdata, uint16_t addr) {
+    return ((const uint8_t *) userdata)[addr];
+}
+
+// Parse an address, such as $C000 or FFFA
+static bool parse_address(const char *text, uint16_t *addr) {
+    if(*text == '$') ++text;
+    char *end;
+    unsigned long value = strtoul(text, &end, 16);
+    if(*text == '\0' || *end != '\0' || value >= ADDRESSES) return false;
+    *addr = value;
+    return true;
+}
+
+// Parse an entry point, either an address or the name of a vector
+static bool parse_entry(const char *text, uint16_t *addr) {
+    static const struct { const char *name; uint16_t vector; } vectors[] = {
+        { "nmi", NMI_VECTOR }, { "reset", RESET_VECTOR }, { "irq", IRQ_VECTOR },
+    };
+    for(size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); ++i) {
+        if(strcmp(text, vectors[i].name) != 0) continue;
+        uint16_t v = vectors[i].vector;
+        *addr = memory[v] | memory[(uint16_t) (v + 1)] << 8;
+        return true;
+    }
+    return parse_address(text, addr);
+}
+
+// Parse a loop bound, such as $C010=8 or $C010=1-8
+static bool parse_bound(char *text, TimingBound *bound) {
+    char *equals = strchr(text, '=');
+    if(equals == NULL) return false;
+    *equals = '\0';
+    char *end;
+    unsigned long min = strtoul(equals + 1, &end, 10), max = min;
+    if(*end == '-') max = strtoul(end + 1, &end, 10);
+    if(*end != '\0' || max == 0 || min > max || max > UINT32_MAX) return false;
+    bound->min = min;
+    bound->max = max;
+    return parse_address(text, &bound->address);
+}
+
+// Load an image at the given origin, or so that it ends at $FFFF if negative
+static bool load(const char *path, long origin) {
+    FILE *file = fopen(path, "rb");
+    if(file == NULL || fseek(file, 0, SEEK_END) != 0) {
+        if(file != NULL) fclose(file);
+        return false;
+    }
+    long size = ftell(file);
+    if(size < 0) size = 0;
+    if(origin < 0) {
+        // Of images larger than the address space, only the end is seen
+        origin = size < ADDRESSES ? ADDRESSES - size : 0;
+        fseek(file, size < ADDRESSES ? 0 : size - ADDRESSES, SEEK_SET);
+    } else {
+        rewind(file);
+    }
+    bool ok = fread(&memory[origin], 1, ADDRESSES - origin, file) > 0
+        || size == 0;
+    fclose(file);
+    return ok;
+}
+
+// Write the instructions of a block, one per line
+static void disassemble_block(FILE *out, uint16_t first, uint16_t last) {
+    for(uint16_t pc = first;; pc += 1 + get_inc(decode(memory[pc]).mode)) {
+        fprintf(out, "        $%04X  ", pc);
+        disassemble(out, memory, peek, pc, 1);
+        if(pc == last) break;
+    }
+}
+
+static int usage(const char *name) {
+    fprintf(stderr, "usage: %s [-o ORIGIN] [-l ADDRESS=[MIN-]MAX]... [-d] "
+            "IMAGE ENTRY...\n", name);
+    return EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[]) {
+    TimingBound *bounds = calloc(argc, sizeof(TimingBound));
+    size_t count = 0;
+    if(bounds == NULL) return EXIT_FAILURE;
+    long origin = -1;
+    bool listing = false;
+    int i;
+    for(i = 1; i < argc && argv[i][0] == '-'; ++i) {
+        if(strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            uint16_t addr;
+            if(!parse_address(argv[++i], &addr)) return usage(argv[0]);
+            origin = addr;
+        } else if(strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            if(!parse_bound(argv[++i], &bounds[count++]))
+                return usage(argv[0]);
+        } else if(strcmp(argv[i], "-d") == 0) {
+            listing = true;
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if(argc - i < 2) return usage(argv[0]);
+    if(!load(argv[i], origin)) {
+        fprintf(stderr, "could not read %s\n", argv[i]);
+        return EXIT_FAILURE;
+    }
+
+    bool ok = true;
+    for(++i; i < argc; ++i) {
+        uint16_t entry;
+        if(!parse_entry(argv[i], &entry)) return usage(argv[0]);
+        Timing timing;
+        if(!timing_analyze(&timing, memory, entry, bounds, count)) {
+            fprintf(stderr, "$%04X: %s at $%04X\n", entry,
+                    timing_error_name(timing.error), timing.at);
+            timing_free(&timing);
+            ok = false;
+            continue;
+        }
+        printf("$%04X: %lu to %lu cycles\n", entry,
+                (unsigned long) timing.best, (unsigned long) timing.worst);
+        for(size_t j = 0; j < timing.length; ++j) {
+            TimingStep *step = &timing.path[j];
+            printf("    $%04X-$%04X  %8lux  %10lu cycles\n", step->address,
+                    step->last, (unsigned long) step->count,
+                    (unsigned long) step->cycles);
+            if(listing) disassemble_block(stdout, step->address, step->last);
+        }
+        timing_free(&timing);
+    }
+    free(bounds);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
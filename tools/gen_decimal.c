@@ -0,0 +1,102 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Build-time generator for the decimal mode lookup tables (see decimal.h).
+// It is run by meson and writes a C source file with one table for ADC and
+// one for SBC, so that the processor never has to do any BCD math itself.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "decimal.h"
+
+// Status register bits, mirrored from processor.h to keep this tool free of
+// any dependency on the library itself
+#define CARRY    0x01
+#define ZERO     0x02
+#define OVERFLOW 0x40
+#define NEGATIVE 0x80
+
+// Pack a result and its flags into a table entry. The zero and negative flags
+// are taken from the final, decimal value, to allow 0x80-0x99 to represent a
+// negative range if so desired
+static uint16_t entry(uint8_t result, int carry, int overflow) {
+    uint8_t flags = 0;
+    if(carry) flags |= CARRY;
+    if(overflow) flags |= OVERFLOW;
+    if(result == 0) flags |= ZERO;
+    if(result & 0x80) flags |= NEGATIVE;
+    return flags << 8 | result;
+}
+
+// Decimal addition, as done by the NMOS 6502. This follows the sequence of
+// operations of the original hardware step by step, so that invalid BCD
+// operands (nibbles from A to F) produce the very same strange results
+static uint16_t nmos_add(uint8_t acc, uint8_t data, int carry) {
+    int lo = (acc & 0x0F) + (data & 0x0F) + carry;
+    if(lo >= 0x0A) lo = ((lo + 0x06) & 0x0F) + 0x10;
+    int sum = (acc & 0xF0) + (data & 0xF0) + lo;
+    // The overflow flag is computed from the intermediate result, before the
+    // upper nibble gets adjusted, with both operands taken as signed
+    int ssum = (int8_t) (acc & 0xF0) + (int8_t) (data & 0xF0) + lo;
+    int overflow = ssum < -128 || ssum > 127;
+    if(sum >= 0xA0) sum += 0x60;
+    return entry(sum & 0xFF, sum >= 0x100, overflow);
+}
+
+// Decimal subtraction, as done by the NMOS 6502. Carry and overflow are the
+// same as in binary mode, only the result gets adjusted
+static uint16_t nmos_sub(uint8_t acc, uint8_t data, int carry) {
+    int bin = acc - data - !carry;
+    int overflow = ((acc ^ bin) & (acc ^ data) & 0x80) != 0;
+    int lo = (acc & 0x0F) - (data & 0x0F) + carry - 1;
+    if(lo < 0) lo = ((lo - 0x06) & 0x0F) - 0x10;
+    int diff = (acc & 0xF0) - (data & 0xF0) + lo;
+    if(diff < 0) diff -= 0x60;
+    return entry(diff & 0xFF, bin >= 0, overflow);
+}
+
+// Write a whole table as a C array definition
+static void emit(FILE *out, const char *name,
+        uint16_t (*op)(uint8_t, uint8_t, int)) {
+    fprintf(out, "const uint16_t %s[DECIMAL_TABLE_SIZE] = {\n", name);
+    for(uint32_t i = 0; i < DECIMAL_TABLE_SIZE; ++i) {
+        uint16_t e = op((i >> 8) & 0xFF, i & 0xFF, i >> 16);
+        fprintf(out, "%s0x%04X,%s", i % 8 ? " " : "    ", e,
+                i % 8 == 7 ? "\n" : "");
+    }
+    fprintf(out, "};\n\n");
+}
+
+int main(int argc, char *argv[]) {
+    if(argc != 2) {
+        fprintf(stderr, "usage: %s OUTPUT\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    FILE *out = fopen(argv[1], "w");
+    if(out == NULL) {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+    fprintf(out, "// Generated by tools/gen_decimal.c, do not edit\n\n");
+    fprintf(out, "#include <stdint.h>\n#include \"decimal.h\"\n\n");
+    emit(out, "decimal_add_table", nmos_add);
+    emit(out, "decimal_sub_table", nmos_sub);
+    return fclose(out) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
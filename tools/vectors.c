@@ -0,0 +1,228 @@
+/*
+   Copyright 2024 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-6502.
+
+   libre-6502 is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-6502 is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-6502. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Conformance tool for single-step test vectors (see vectors.h). It can
+// generate vectors for every documented opcode from the reference core, and
+// run files of vectors (made by it or by anything else that writes the same
+// format) sharded across all the cores of the host:
+//
+//     vectors generate OUTPUT [COUNT [SEED]]   COUNT vectors per opcode
+//     vectors run [-j THREADS] [-m] FILE...    -m: registers and memory only
+//     vectors self [COUNT [SEED]]              generate and run in memory
+//
+// By default, running checks cycle counts and bus accesses as well, which is
+// only meaningful for vectors with the same timing model as this library.
+
+#include <time.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "decoder.h"
+#include "vectors.h"
+#include "processor.h"
+#include "definitions.h"
+
+#define COUNT         1000 // default number of vectors per opcode
+#define MAX_THREADS   256
+#define MAX_REPORTED  5    // failures explained, per thread
+
+// Vectors to run, either from a file or generated in memory
+typedef struct {
+    const VectorFile *file;
+    const Vector *vectors;
+    size_t count;
+} Source;
+
+static void get(const Source *source, size_t index, Vector *vector) {
+    if(source->file != NULL) vector_file_get(source->file, index, vector);
+    else *vector = source->vectors[index];
+}
+
+// Share of the vectors run by a thread, and its results
+typedef struct {
+    const Source *source;
+    size_t first, last;
+    uint8_t checks;
+    size_t failures;
+    size_t failed[MAX_REPORTED];
+} Shard;
+
+static uint8_t read_nothing(void *userdata, uint16_t addr) {
+    (void) userdata;
+    (void) addr;
+    return 0;
+}
+
+static void write_nothing(void *userdata, uint16_t addr, uint8_t data) {
+    (void) userdata;
+    (void) addr;
+    (void) data;
+}
+
+static void *run_shard(void *arg) {
+    Shard *shard = arg;
+    Processor proc;
+    processor_init(&proc, read_nothing, write_nothing, NULL);
+    Vector vector;
+    for(size_t i = shard->first; i < shard->last; ++i) {
+        get(shard->source, i, &vector);
+        if(vector_run(&vector, &proc, shard->checks)) continue;
+        if(shard->failures < MAX_REPORTED) shard->failed[shard->failures] = i;
+        ++shard->failures;
+    }
+    return NULL;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Run vectors across the given number of threads. Returns the failure count
+static size_t run_all(const Source *source, const char *name, int threads,
+        uint8_t checks) {
+    static Shard shards[MAX_THREADS];
+    pthread_t thread[MAX_THREADS];
+    bool started[MAX_THREADS];
+    if((size_t) threads > source->count) threads = source->count;
+    if(threads < 1) threads = 1;
+
+    double start = now();
+    for(int t = 0; t < threads; ++t) {
+        shards[t] = (Shard) { .source = source, .checks = checks,
+            .first = source->count * t / threads,
+            .last = source->count * (t + 1) / threads };
+        started[t] = pthread_create(&thread[t], NULL, run_shard,
+                &shards[t]) == 0;
+        if(!started[t]) run_shard(&shards[t]);
+    }
+    size_t failures = 0;
+    for(int t = 0; t < threads; ++t) {
+        if(started[t]) pthread_join(thread[t], NULL);
+        failures += shards[t].failures;
+    }
+    double elapsed = now() - start;
+
+    // Explain some of the failures, on a fresh processor
+    Processor proc;
+    processor_init(&proc, read_nothing, write_nothing, NULL);
+    for(int t = 0; t < threads; ++t) {
+        size_t reported = shards[t].failures < MAX_REPORTED
+            ? shards[t].failures : MAX_REPORTED;
+        for(size_t i = 0; i < reported; ++i) {
+            Vector vector;
+            get(source, shards[t].failed[i], &vector);
+            fprintf(stderr, "%s: vector %zu failed: ", name,
+                    shards[t].failed[i]);
+            vector_explain(stderr, &vector, &proc);
+        }
+    }
+    printf("%s: %zu vectors, %zu failed, %.3f s (%.1f M/s, %d threads)\n",
+            name, source->count, failures, elapsed,
+            source->count / elapsed / 1e6, threads);
+    return failures;
+}
+
+// Generate vectors for every documented opcode. Returns NULL on failure
+static Vector *generate(size_t per_opcode, uint64_t seed, size_t *count) {
+    size_t opcodes = 0;
+    for(int opcode = 0; opcode < 256; ++opcode)
+        if(decode(opcode).op != ERR) ++opcodes;
+    Vector *vectors = malloc(opcodes * per_opcode * sizeof(Vector));
+    if(vectors == NULL) return NULL;
+    *count = 0;
+    for(int opcode = 0; opcode < 256; ++opcode) {
+        if(decode(opcode).op == ERR) continue;
+        for(size_t i = 0; i < per_opcode; ++i)
+            if(vector_generate(&vectors[*count], opcode, &seed)) ++*count;
+    }
+    return vectors;
+}
+
+static int threads_available(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n < 1 ? 1 : n > MAX_THREADS ? MAX_THREADS : n;
+}
+
+static int usage(const char *name) {
+    fprintf(stderr, "usage: %s generate OUTPUT [COUNT [SEED]]\n"
+            "       %s run [-j THREADS] [-m] FILE...\n"
+            "       %s self [COUNT [SEED]]\n", name, name, name);
+    return EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[]) {
+    if(argc < 2) return usage(argv[0]);
+    if(strcmp(argv[1], "generate") == 0 || strcmp(argv[1], "self") == 0) {
+        bool self = argv[1][0] == 's';
+        int arg = self ? 2 : 3;
+        if(!self && argc < 3) return usage(argv[0]);
+        size_t per_opcode = argc > arg ? strtoul(argv[arg], NULL, 0) : COUNT;
+        uint64_t seed = argc > arg + 1 ? strtoull(argv[arg + 1], NULL, 0) : 1;
+        Source source = { 0 };
+        Vector *vectors = generate(per_opcode, seed, &source.count);
+        if(vectors == NULL) {
+            fprintf(stderr, "out of memory\n");
+            return EXIT_FAILURE;
+        }
+        source.vectors = vectors;
+        bool ok;
+        if(self) {
+            ok = run_all(&source, "generated", threads_available(),
+                    CHECK_CYCLES | CHECK_BUS) == 0;
+        } else {
+            ok = vector_file_write(argv[2], vectors, source.count);
+            if(!ok) fprintf(stderr, "could not write %s\n", argv[2]);
+        }
+        free(vectors);
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if(strcmp(argv[1], "run") != 0) return usage(argv[0]);
+
+    int threads = threads_available();
+    uint8_t checks = CHECK_CYCLES | CHECK_BUS;
+    bool ok = true;
+    for(int i = 2; i < argc; ++i) {
+        if(strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+            if(threads > MAX_THREADS) threads = MAX_THREADS;
+            continue;
+        }
+        if(strcmp(argv[i], "-m") == 0) {
+            checks = 0;
+            continue;
+        }
+        VectorFile file;
+        if(!vector_file_open(&file, argv[i])) {
+            fprintf(stderr, "could not open %s as a file of vectors\n",
+                    argv[i]);
+            ok = false;
+            continue;
+        }
+        Source source = { .file = &file, .count = file.count };
+        ok = run_all(&source, argv[i], threads, checks) == 0 && ok;
+        vector_file_close(&file);
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}